@@ -3,6 +3,8 @@
 #include "adls_client.h"
 #include "adls_test_base.h"
 
+#include <set>
+
 TEST_CASE("Create Filesystem", "[adls][filesystem]")
 {
     {
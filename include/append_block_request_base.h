@@ -1,5 +1,6 @@
 #pragma once
 
+#include <limits>
 #include <map>
 #include <string>
 
@@ -19,9 +20,11 @@ namespace azure {  namespace storage_lite {
 
         virtual unsigned int content_length() const = 0;
         virtual std::string content_md5() const { return std::string(); }
+        virtual std::string content_crc64() const { return std::string(); }
 
-        virtual unsigned long long ms_blob_condition_maxsize() const { return 0; }
-        virtual unsigned long long ms_blob_condition_appendpos() const { return 0; }
+        // Conditions are only sent when overridden, the maximum value means unset.
+        virtual unsigned long long ms_blob_condition_maxsize() const { return std::numeric_limits<unsigned long long>::max(); }
+        virtual unsigned long long ms_blob_condition_appendpos() const { return std::numeric_limits<unsigned long long>::max(); }
 
         AZURE_STORAGE_API void build_request(const storage_account &a, http_base &h) const override;
     };
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Limits the rate at which bytes are transferred. Transfers take their bytes from the bucket and wait while it is in debt.
+    /// </summary>
+    class token_bucket final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::token_bucket" /> class.
+        /// </summary>
+        /// <param name="bytes_per_second">The rate, 0 for no limit.</param>
+        /// <param name="burst_bytes">The bytes that can be saved up while the bucket is unused, a tenth of a second's worth by default.</param>
+        AZURE_STORAGE_API explicit token_bucket(uint64_t bytes_per_second = 0, uint64_t burst_bytes = 0);
+
+        /// <summary>
+        /// Changes the rate, transfers in progress follow the new rate from their next chunk.
+        /// </summary>
+        AZURE_STORAGE_API void set_rate(uint64_t bytes_per_second, uint64_t burst_bytes = 0);
+
+        uint64_t rate() const
+        {
+            return m_rate;
+        }
+
+        bool limited() const
+        {
+            return m_rate != 0;
+        }
+
+        /// <summary>
+        /// Takes bytes from the bucket, going into debt if it holds fewer.
+        /// </summary>
+        /// <returns>How long the caller waits before transferring more, for the debt to be repaid.</returns>
+        AZURE_STORAGE_API std::chrono::microseconds take(uint64_t bytes);
+
+        /// <summary>
+        /// Gets the size of the chunks transfers are cut into, a tenth of a second's worth, so they are paced smoothly.
+        /// </summary>
+        AZURE_STORAGE_API size_t chunk_size() const;
+
+    private:
+        std::atomic<uint64_t> m_rate;
+        double m_burst;
+        double m_tokens;
+        std::chrono::steady_clock::time_point m_last_refill;
+        std::mutex m_mutex;
+    };
+
+    /// <summary>
+    /// The upload and download budgets of the clients sharing it, adjustable while transfers are running.
+    /// </summary>
+    class bandwidth_throttle final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::bandwidth_throttle" /> class.
+        /// </summary>
+        /// <param name="upload_bytes_per_second">The rate at which request bodies are sent, 0 for no limit.</param>
+        /// <param name="download_bytes_per_second">The rate at which response bodies are received, 0 for no limit.</param>
+        bandwidth_throttle(uint64_t upload_bytes_per_second = 0, uint64_t download_bytes_per_second = 0)
+            : m_upload(upload_bytes_per_second),
+            m_download(download_bytes_per_second) {}
+
+        token_bucket &upload()
+        {
+            return m_upload;
+        }
+
+        token_bucket &download()
+        {
+            return m_download;
+        }
+
+    private:
+        token_bucket m_upload;
+        token_bucket m_download;
+    };
+
+}}  // azure::storage_lite
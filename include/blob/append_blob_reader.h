@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "storage_EXPORTS.h"
+
+#include "blob_client.h"
+
+namespace azure { namespace storage_lite {
+
+    /// <summary>
+    /// Options controlling how an <see cref="azure::storage_lite::append_blob_reader" /> polls for new data.
+    /// </summary>
+    struct append_blob_reader_options
+    {
+        /// <summary>
+        /// The largest range requested in one read.
+        /// </summary>
+        size_t max_read_size = 4 * 1024 * 1024;
+
+        /// <summary>
+        /// The byte terminating each record.
+        /// </summary>
+        char delimiter = '\n';
+
+        /// <summary>
+        /// The largest record held back waiting for its delimiter. A longer record is handed out in pieces of this size,
+        /// so the data kept between polls stays bounded.
+        /// </summary>
+        size_t max_record_size = 16 * 1024 * 1024;
+
+        /// <summary>
+        /// The poll interval used while new data keeps arriving.
+        /// </summary>
+        std::chrono::milliseconds min_poll_interval = std::chrono::milliseconds(100);
+
+        /// <summary>
+        /// The poll interval the reader backs off to while the blob stays unchanged.
+        /// </summary>
+        std::chrono::milliseconds max_poll_interval = std::chrono::milliseconds(10000);
+    };
+
+    /// <summary>
+    /// Follows an append blob, handing out complete records as they are appended.
+    /// </summary>
+    /// <remarks>
+    /// Each poll is a single ranged GET from the last consumed offset, conditioned on the ETag last seen, so an unchanged blob costs
+    /// one 304 response. The poll interval doubles while no data arrives and resets as soon as it does.
+    /// </remarks>
+    class append_blob_reader final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::append_blob_reader" /> class.
+        /// </summary>
+        /// <param name="client">The client used to access the blob.</param>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="on_record">Called with every complete record, without its delimiter.</param>
+        /// <param name="offset">The offset of the first record to read, in bytes.</param>
+        /// <param name="options">The <see cref="azure::storage_lite::append_blob_reader_options" /> to use.</param>
+        AZURE_STORAGE_API append_blob_reader(std::shared_ptr<blob_client> client, const std::string &container, const std::string &blob, std::function<void(const char*, size_t)> on_record, unsigned long long offset = 0, const append_blob_reader_options &options = append_blob_reader_options());
+
+        /// <summary>
+        /// Stops following the blob.
+        /// </summary>
+        AZURE_STORAGE_API ~append_blob_reader();
+
+        append_blob_reader(const append_blob_reader &) = delete;
+        append_blob_reader &operator=(const append_blob_reader &) = delete;
+
+        /// <summary>
+        /// Reads the data appended since the last poll and hands out the records it completes.
+        /// </summary>
+        /// <returns>The number of bytes read, 0 if the blob is unchanged.</returns>
+        AZURE_STORAGE_API storage_outcome<unsigned long long> poll();
+
+        /// <summary>
+        /// Starts polling the blob on a background thread.
+        /// </summary>
+        /// <param name="on_error">Called with the error of every failed poll, polling continues afterwards.</param>
+        AZURE_STORAGE_API void follow(std::function<void(const storage_error &)> on_error = std::function<void(const storage_error &)>());
+
+        /// <summary>
+        /// Stops the background polling started by <see cref="follow" /> and waits for it to finish.
+        /// </summary>
+        AZURE_STORAGE_API void stop();
+
+        /// <summary>
+        /// Gets the offset just past the last record handed out.
+        /// </summary>
+        unsigned long long offset() const
+        {
+            return m_record_offset.load();
+        }
+
+    private:
+        std::shared_ptr<blob_client> m_client;
+        std::string m_container;
+        std::string m_blob;
+        std::function<void(const char*, size_t)> m_on_record;
+        append_blob_reader_options m_options;
+
+        std::mutex m_poll_mutex;
+        std::string m_etag;
+        std::string m_partial;
+        std::atomic<unsigned long long> m_record_offset;
+
+        std::mutex m_follow_mutex;
+        std::condition_variable m_follow_cv;
+        bool m_stopping;
+        std::thread m_follower;
+    };
+
+}} // azure::storage_lite
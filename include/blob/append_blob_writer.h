@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "storage_EXPORTS.h"
+
+#include "blob_client.h"
+
+namespace azure { namespace storage_lite {
+
+    /// <summary>
+    /// Options controlling how an <see cref="azure::storage_lite::append_blob_writer" /> groups records into blocks.
+    /// </summary>
+    struct append_blob_writer_options
+    {
+        /// <summary>
+        /// The largest block sent in one append operation, no larger than 4MB.
+        /// </summary>
+        size_t max_block_size = 4 * 1024 * 1024;
+
+        /// <summary>
+        /// How long the oldest buffered record may wait before a partial block is flushed.
+        /// </summary>
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds(200);
+
+        /// <summary>
+        /// The amount of buffered data at which <see cref="azure::storage_lite::append_blob_writer::append" /> blocks until earlier records are committed.
+        /// </summary>
+        size_t max_buffered_size = 64 * 1024 * 1024;
+    };
+
+    /// <summary>
+    /// Appends small records to an append blob from many threads, committing them together as large blocks.
+    /// </summary>
+    /// <remarks>
+    /// Records are written in the order <see cref="append" /> is called. Every block is sent with an append position condition,
+    /// so a block whose first attempt succeeded but whose response was lost is detected instead of being appended twice.
+    /// The writer assumes it is the only writer of the blob.
+    /// </remarks>
+    class append_blob_writer final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::append_blob_writer" /> class. The blob is created on the first flush if it does not exist.
+        /// </summary>
+        /// <param name="client">The client used to access the blob.</param>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="options">The <see cref="azure::storage_lite::append_blob_writer_options" /> to use.</param>
+        AZURE_STORAGE_API append_blob_writer(std::shared_ptr<blob_client> client, const std::string &container, const std::string &blob, const append_blob_writer_options &options = append_blob_writer_options());
+
+        /// <summary>
+        /// Flushes all buffered records and stops the background flusher.
+        /// </summary>
+        AZURE_STORAGE_API ~append_blob_writer();
+
+        append_blob_writer(const append_blob_writer &) = delete;
+        append_blob_writer &operator=(const append_blob_writer &) = delete;
+
+        /// <summary>
+        /// Queues a record to be appended to the blob.
+        /// </summary>
+        /// <param name="record">The record content, no larger than the maximum block size.</param>
+        /// <returns>A <see cref="std::future" /> object that becomes ready once the block holding the record is committed or has failed.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> append(std::string record);
+
+        /// <summary>
+        /// Commits all records queued so far without waiting for the flush interval and waits for them to complete.
+        /// </summary>
+        AZURE_STORAGE_API void flush();
+
+        /// <summary>
+        /// Flushes all buffered records and stops the background flusher. Records appended afterwards fail immediately.
+        /// </summary>
+        AZURE_STORAGE_API void close();
+
+    private:
+        struct pending_record
+        {
+            std::string data;
+            std::promise<storage_outcome<void>> promise;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        void run();
+        storage_outcome<void> commit_block(const std::string &block);
+        storage_outcome<void> resolve_append_position(const std::string &block);
+
+        std::shared_ptr<blob_client> m_client;
+        std::string m_container;
+        std::string m_blob;
+        append_blob_writer_options m_options;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::condition_variable m_space_cv;
+        std::deque<pending_record> m_records;
+        size_t m_buffered_size;
+        unsigned long long m_enqueued_count;
+        unsigned long long m_completed_count;
+        unsigned long long m_flush_target;
+        bool m_closed;
+
+        // Only touched by the flusher thread.
+        unsigned long long m_position;
+        bool m_position_known;
+
+        std::thread m_flusher;
+    };
+
+}} // azure::storage_lite
@@ -33,10 +33,46 @@ namespace azure {  namespace storage_lite {
             return *this;
         }
 
+        std::string content_md5() const override
+        {
+            return m_content_md5;
+        }
+
+        append_block_request &set_content_md5(const std::string &content_md5)
+        {
+            m_content_md5 = content_md5;
+            return *this;
+        }
+
+        std::string content_crc64() const override
+        {
+            return m_content_crc64;
+        }
+
+        append_block_request &set_content_crc64(const std::string &content_crc64)
+        {
+            m_content_crc64 = content_crc64;
+            return *this;
+        }
+
+        unsigned long long ms_blob_condition_appendpos() const override
+        {
+            return m_appendpos;
+        }
+
+        append_block_request &set_ms_blob_condition_appendpos(unsigned long long appendpos)
+        {
+            m_appendpos = appendpos;
+            return *this;
+        }
+
     private:
         std::string m_container;
         std::string m_blob;
 
         unsigned int m_content_length;
+        std::string m_content_md5;
+        std::string m_content_crc64;
+        unsigned long long m_appendpos = std::numeric_limits<unsigned long long>::max();
     };
 }} // azure::storage_lite
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "blob_batch_request_base.h"
+
+#include "utility.h"
+
+namespace azure {  namespace storage_lite {
+
+    class blob_batch_request final : public blob_batch_request_base
+    {
+    public:
+        blob_batch_request(std::vector<subrequest> subrequests)
+            : m_subrequests(std::move(subrequests)),
+            m_boundary("batch_" + get_uuid()) {}
+
+        std::vector<subrequest> subrequests() const override
+        {
+            return m_subrequests;
+        }
+
+        std::string boundary() const override
+        {
+            return m_boundary;
+        }
+
+    private:
+        std::vector<subrequest> m_subrequests;
+        std::string m_boundary;
+    };
+
+}}  // azure::storage_lite
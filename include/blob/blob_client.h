@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #ifdef __linux__
@@ -13,11 +14,14 @@
 #include "http/libcurl_http_client.h"
 #include "tinyxml2_parser.h"
 #include "executor.h"
+#include "checksum.h"
+#include "hedging.h"
 #include "put_block_list_request_base.h"
 #include "get_blob_property_request_base.h"
 #include "get_blob_request_base.h"
 #include "get_container_property_request_base.h"
 #include "list_blobs_request_base.h"
+#include "blob_batch_request_base.h"
 
 namespace azure { namespace storage_lite {
 
@@ -86,6 +90,98 @@ namespace azure { namespace storage_lite {
             return m_context;
         }
 
+        /// <summary>
+        /// Gets the transactional checksum sent with uploaded blocks and pages and verified on downloaded ranges.
+        /// </summary>
+        checksum_type transfer_checksum() const
+        {
+            return m_transfer_checksum;
+        }
+
+        /// <summary>
+        /// Sets the transactional checksum sent with uploaded blocks and pages and verified on downloaded ranges.
+        /// </summary>
+        /// <param name="type">The checksum to use, none by default.</param>
+        /// <remarks>Uploads from a buffer send the checksum of each request. Ranged downloads of at most 4MB ask the service for the checksum of the range and compare it to the one computed while the data is written, failing with blob_checksum_mismatch when they differ.</remarks>
+        void set_transfer_checksum(checksum_type type)
+        {
+            m_transfer_checksum = type;
+        }
+
+        /// <summary>
+        /// Gets the token cancelling the operations of this client.
+        /// </summary>
+        const cancellation_token &cancellation() const
+        {
+            return m_cancellation;
+        }
+
+        /// <summary>
+        /// Gets a client sharing the handles and settings of this one whose operations are cancelled by the token.
+        /// </summary>
+        /// <param name="token">The token. Cancelling it, or reaching its deadline, aborts the requests in flight and stops their retries, they fail with operation_cancelled or operation_timed_out.</param>
+        /// <returns>The <see cref="azure::storage_lite::blob_client"> bound to the token.</returns>
+        /// <remarks>As with any client, the returned client must outlive the operations started on it.</remarks>
+        blob_client with_cancellation(cancellation_token token) const
+        {
+            blob_client client(*this);
+            client.m_cancellation = std::move(token);
+            return client;
+        }
+
+        /// <summary>
+        /// Prepares handles and their connections to the blob endpoint in the background, ahead of the first requests.
+        /// </summary>
+        /// <param name="count">The number of handles, at most the concurrency of the client.</param>
+        void prewarm(int count)
+        {
+            m_client->prewarm(count, m_account->get_url(storage_account::service::blob).to_string());
+        }
+
+        /// <summary>
+        /// Limits the bodies this client sends and receives, along with every other client sharing the throttle.
+        /// </summary>
+        /// <param name="throttle">The throttle, nullptr for no limit. The clients obtained from this one with with_cancellation or with_priority share it.</param>
+        void set_bandwidth_throttle(std::shared_ptr<bandwidth_throttle> throttle)
+        {
+            m_client->set_bandwidth_throttle(std::move(throttle));
+        }
+
+        request_priority priority() const
+        {
+            return m_priority;
+        }
+
+        /// <summary>
+        /// Gets a client sharing the handles and settings of this one whose requests wait for handles with the priority.
+        /// </summary>
+        /// <param name="priority">The priority, interactive for small operations a user waits on and bulk for large transfers that can use spare handles.</param>
+        /// <returns>The <see cref="azure::storage_lite::blob_client"> using the priority.</returns>
+        blob_client with_priority(request_priority priority) const
+        {
+            blob_client client(*this);
+            client.m_priority = priority;
+            return client;
+        }
+
+        /// <summary>
+        /// Gets the policy hedging the reads of get_chunk_to_stream_sync, nullptr when reads are not hedged.
+        /// </summary>
+        std::shared_ptr<hedging_policy> read_hedging() const
+        {
+            return m_read_hedging;
+        }
+
+        /// <summary>
+        /// Sets the policy hedging the reads of get_chunk_to_stream_sync.
+        /// </summary>
+        /// <param name="policy">The hedging policy, nullptr to disable hedging, which is the default.</param>
+        /// <remarks>A hedged read that has not received a response within the delay of the policy is sent again on another free handle, the first to complete is used and the other is cancelled.</remarks>
+        void set_read_hedging(std::shared_ptr<hedging_policy> policy)
+        {
+            m_read_hedging = std::move(policy);
+        }
+
         /// <summary>
         /// Synchronously download the contents of a blob to a stream.
         /// </summary>
@@ -97,6 +193,18 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API storage_outcome<chunk_property> get_chunk_to_stream_sync(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os);
 
+        /// <summary>
+        /// Synchronously download the contents of a blob to a stream if the blob no longer has the given ETag.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="size">The size of the data to download from the blob, in bytes.</param>
+        /// <param name="os">The target stream.</param>
+        /// <param name="if_none_match">The ETag the blob was last seen with, the operation fails with 304 if it is unchanged. An empty string downloads unconditionally.</param>
+        /// <returns>The properties of the downloaded chunk.</returns>
+        AZURE_STORAGE_API storage_outcome<chunk_property> get_chunk_to_stream_sync(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os, const std::string &if_none_match);
+
         /// <summary>
         /// Intitiates an asynchronous operation to download the contents of a blob to a stream.
         /// </summary>
@@ -141,6 +249,18 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API std::future<storage_outcome<void>> upload_block_blob_from_stream(const std::string &container, const std::string &blob, std::istream &is, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t streamlen);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation to upload the contents of a blob from a range of an open file.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="fd">The file descriptor, read with positional reads so its file position is not used.</param>
+        /// <param name="offset">The offset of the range in the file.</param>
+        /// <param name="length">The length of the range.</param>
+        /// <param name="metadata">A <see cref="std::vector"> that respresents metadatas.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> upload_block_blob_from_file(const std::string &container, const std::string &blob, int fd, uint64_t offset, uint64_t length, const std::vector<std::pair<std::string, std::string>> &metadata);
+
         /// <summary>
         /// Intitiates an asynchronous operation to upload the contents of a blob from a buffer.
         /// </summary>
@@ -153,6 +273,19 @@ namespace azure { namespace storage_lite {
         /// <param name="parallelism">A int value indicates the maximum parallelism can be used in this request.</param>
         AZURE_STORAGE_API std::future<storage_outcome<void>> upload_block_blob_from_buffer(const std::string &container, const std::string &blob, const char* buffer, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t bufferlen, int parallelism = 1);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation to update a block blob to the contents of a buffer, uploading only the blocks the blob does not already hold.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="buffer">The source buffer.</param>
+        /// <param name="metadata">A <see cref="std::vector"> that respresents metadatas.</param>
+        /// <param name="bufferlen">Length of the buffer.</param>
+        /// <param name="parallelism">A int value indicates the maximum parallelism can be used in this request.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        /// <remarks>The buffer is split at content-defined boundaries and every block is named after the SHA-256 of its content, so blocks unchanged since the last sync are committed again without being uploaded.</remarks>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> sync_block_blob_from_buffer(const std::string &container, const std::string &blob, const char* buffer, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t bufferlen, int parallelism = 1);
+
         /// <summary>
         /// Intitiates an asynchronous operation  to delete a blob.
         /// </summary>
@@ -162,6 +295,43 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API std::future<storage_outcome<void>> delete_blob(const std::string &container, const std::string &blob, bool delete_snapshots = false);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation to send blob deletes and tier changes in a single batch request.
+        /// </summary>
+        /// <param name="subrequests">The operations, at most 256 of them.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        /// <remarks>The outcome fails when the batch as a whole is rejected, otherwise every operation has its own result in the response.</remarks>
+        AZURE_STORAGE_API std::future<storage_outcome<blob_batch_response>> submit_batch(const std::vector<blob_batch_request_base::subrequest> &subrequests);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation to send any number of blob deletes and tier changes, split into batch requests.
+        /// </summary>
+        /// <param name="subrequests">The operations.</param>
+        /// <param name="parallelism">A int value indicates the maximum number of batches in flight.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        /// <remarks>Every operation has its own result in the response, an operation of a rejected batch gets the error of the batch.</remarks>
+        AZURE_STORAGE_API std::future<storage_outcome<blob_batch_response>> submit_batches(const std::vector<blob_batch_request_base::subrequest> &subrequests, int parallelism = 1);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation to delete blobs of a container in batch requests.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blobs">The blob names.</param>
+        /// <param name="delete_snapshots">A bool value, delete snapshots if it is true.</param>
+        /// <param name="parallelism">A int value indicates the maximum number of batches in flight.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<blob_batch_response>> delete_blobs(const std::string &container, const std::vector<std::string> &blobs, bool delete_snapshots = false, int parallelism = 1);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation to set the access tier of blobs of a container in batch requests.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blobs">The blob names.</param>
+        /// <param name="tier">The access tier.</param>
+        /// <param name="parallelism">A int value indicates the maximum number of batches in flight.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<blob_batch_response>> set_blob_tiers(const std::string &container, const std::vector<std::string> &blobs, access_tier tier, int parallelism = 1);
+
         /// <summary>
         /// Intitiates an asynchronous operation  to create a container.
         /// </summary>
@@ -266,6 +436,18 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API std::future<storage_outcome<void>> upload_block_from_buffer(const std::string &container, const std::string &blob, const std::string &blockid, const char* buffer, uint64_t bufferlen);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation to upload a block of a blob from a range of an open file.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="blockid">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="fd">The file descriptor, read with positional reads so its file position is not used.</param>
+        /// <param name="offset">The offset of the block in the file.</param>
+        /// <param name="length">The length of the block.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> upload_block_from_file(const std::string &container, const std::string &blob, const std::string &blockid, int fd, uint64_t offset, uint64_t length);
+
         /// <summary>
         /// Intitiates an asynchronous operation  to create a block blob with existing blocks.
         /// </summary>
@@ -293,6 +475,17 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API std::future<storage_outcome<void>> append_block_from_stream(const std::string &container, const std::string &blob, std::istream &is);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation  to append the content of a char* buffer to an append blob.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="buffer">The input buffer.</param>
+        /// <param name="bufferlen">Length of the buffer, no larger than 4MB.</param>
+        /// <param name="append_position">The blob size the block must be appended at, the operation fails with 412 otherwise. The maximum value leaves the position unchecked.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> append_block_from_buffer(const std::string &container, const std::string &blob, const char* buffer, uint64_t bufferlen, unsigned long long append_position = std::numeric_limits<unsigned long long>::max());
+
         /// <summary>
         /// Intitiates an asynchronous operation  to create an page blob.
         /// </summary>
@@ -333,6 +526,50 @@ namespace azure { namespace storage_lite {
         /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
         AZURE_STORAGE_API std::future<storage_outcome<get_page_ranges_response>> get_page_ranges(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size);
 
+        /// <summary>
+        /// Intitiates an asynchronous operation  to get the page ranges of a page blob that changed since a previous snapshot.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="prev_snapshot">The previous snapshot to compare with, as returned by <see cref="create_snapshot" />.</param>
+        /// <param name="offset">The offset at which to get, in bytes.</param>
+        /// <param name="size">The size of the data to be get from the blob, in bytes.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation. Ranges written since the snapshot are returned in pagelist, ranges cleared since the snapshot in clearlist.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<get_page_ranges_response>> get_page_ranges_diff(const std::string &container, const std::string &blob, const std::string &prev_snapshot, unsigned long long offset = 0, unsigned long long size = 0);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation  to upload a blob range content from a char* buffer.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <param name="offset">The offset at which to begin upload to the blob, in bytes, must be 512-byte aligned.</param>
+        /// <param name="buffer">The input buffer.</param>
+        /// <param name="bufferlen">Length of the buffer, must be a multiple of 512 and no larger than 4MB.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> put_page_from_buffer(const std::string &container, const std::string &blob, unsigned long long offset, const char* buffer, uint64_t bufferlen);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation  to bring a page blob in sync with a local image, transferring only the pages that changed.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name, the page blob must already exist and be at least as large as the image.</param>
+        /// <param name="image">The current content of the local image.</param>
+        /// <param name="base_image">The content of the local image at the time of the previous sync, or nullptr to compare every page.</param>
+        /// <param name="size">Size of the image, must be a multiple of 512.</param>
+        /// <param name="prev_snapshot">The snapshot taken right after the previous sync, or empty. Pages modified in the blob since this snapshot are re-synced from the image as well.</param>
+        /// <param name="parallelism">A int value indicates the maximum parallelism can be used in this request.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation.</returns>
+        /// <remarks>Changed pages that are all zeros are cleared instead of uploaded. Call <see cref="create_snapshot" /> after a successful sync to get the base for the next one.</remarks>
+        AZURE_STORAGE_API std::future<storage_outcome<void>> sync_page_blob_from_buffer(const std::string &container, const std::string &blob, const char* image, const char* base_image, uint64_t size, const std::string &prev_snapshot, int parallelism = 1);
+
+        /// <summary>
+        /// Intitiates an asynchronous operation  to create a read-only snapshot of a blob.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name.</param>
+        /// <returns>A <see cref="std::future" /> object that represents the current operation. The result is the opaque snapshot identifier.</returns>
+        AZURE_STORAGE_API std::future<storage_outcome<std::string>> create_snapshot(const std::string &container, const std::string &blob);
+
         /// <summary>
         /// Intitiates an asynchronous operation  to copy a blob to another.
         /// </summary>
@@ -344,9 +581,20 @@ namespace azure { namespace storage_lite {
         AZURE_STORAGE_API std::future<storage_outcome<void>> start_copy(const std::string &sourceContainer, const std::string &sourceBlob, const std::string &destContainer, const std::string &destBlob);
 
     private:
+        std::shared_ptr<CurlEasyRequest> get_handle() const
+        {
+            auto http = m_client->get_handle(m_priority);
+            http->set_cancellation_token(m_cancellation);
+            return http;
+        }
+
         std::shared_ptr<CurlEasyClient> m_client;
         std::shared_ptr<storage_account> m_account;
         std::shared_ptr<executor_context> m_context;
+        checksum_type m_transfer_checksum = checksum_type::none;
+        std::shared_ptr<hedging_policy> m_read_hedging;
+        cancellation_token m_cancellation = cancellation_token::none();
+        request_priority m_priority = request_priority::normal;
     };
 
     /// <summary>
@@ -388,6 +636,7 @@ namespace azure { namespace storage_lite {
             m_blobClient = other.m_blobClient;
             m_concurrency = other.m_concurrency;
             m_valid = other.m_valid;
+            m_drop_cached_uploads = other.m_drop_cached_uploads;
         }
 
         blob_client_wrapper& operator=(blob_client_wrapper&& other)
@@ -395,6 +644,7 @@ namespace azure { namespace storage_lite {
             m_blobClient = other.m_blobClient;
             m_concurrency = other.m_concurrency;
             m_valid = other.m_valid;
+            m_drop_cached_uploads = other.m_drop_cached_uploads;
             return *this;
         }
 
@@ -403,6 +653,15 @@ namespace azure { namespace storage_lite {
             return m_valid && (m_blobClient != NULL);
         }
 
+        /// <summary>
+        /// Sets whether put_blob and upload_file_to_blob evict the ranges they uploaded from the page cache, which is off by default.
+        /// </summary>
+        /// <param name="drop">True to evict the uploaded ranges, for files that are not read again soon.</param>
+        void set_drop_cached_uploads(bool drop)
+        {
+            m_drop_cached_uploads = drop;
+        }
+
         /// <summary>
         /// Constructs a blob client wrapper from storage account credential.
         /// </summary>
@@ -493,7 +752,8 @@ namespace azure { namespace storage_lite {
         /// <param name="blob">The blob name.</param>
         /// <param name="metadata">A <see cref="std::vector"> that respresents metadatas.</param>
         /// <param name="parallel">A size_t value indicates the maximum parallelism can be used in this request.</param>
-        AZURE_STORAGE_API void upload_file_to_blob(const std::string &sourcePath, const std::string &container, const std::string blob, const std::vector<std::pair<std::string, std::string>> &metadata = std::vector<std::pair<std::string, std::string>>(), size_t parallel = 8);
+        /// <param name="checkpointPath">The path of a journal recording staged blocks. An upload restarted with the same journal only sends the blocks still missing. The journal is removed once the blob is committed.</param>
+        AZURE_STORAGE_API void upload_file_to_blob(const std::string &sourcePath, const std::string &container, const std::string blob, const std::vector<std::pair<std::string, std::string>> &metadata = std::vector<std::pair<std::string, std::string>>(), size_t parallel = 8, const std::string &checkpointPath = std::string());
 
         /// <summary>
         /// Downloads the contents of a blob to a stream.
@@ -554,6 +814,7 @@ namespace azure { namespace storage_lite {
         std::mutex s_mutex;
         unsigned int m_concurrency;
         bool m_valid;
+        bool m_drop_cached_uploads = false;
         static const size_t NOT_USER_DEFINED_STREAMLEN = (std::numeric_limits<size_t>::max)();
     };
 
@@ -38,6 +38,28 @@ namespace azure { namespace storage_lite {
             return *this;
         }
 
+        std::string content_md5() const override
+        {
+            return m_content_md5;
+        }
+
+        create_block_blob_request &set_content_md5(const std::string &content_md5)
+        {
+            m_content_md5 = content_md5;
+            return *this;
+        }
+
+        std::string content_crc64() const override
+        {
+            return m_content_crc64;
+        }
+
+        create_block_blob_request &set_content_crc64(const std::string &content_crc64)
+        {
+            m_content_crc64 = content_crc64;
+            return *this;
+        }
+
         std::vector<std::pair<std::string, std::string>> metadata() const override
         {
             return m_metadata;
@@ -55,6 +77,8 @@ namespace azure { namespace storage_lite {
         std::string m_blob;
 
         unsigned int m_content_length;
+        std::string m_content_md5;
+        std::string m_content_crc64;
         std::vector<std::pair<std::string, std::string>> m_metadata;
     };
 
@@ -45,10 +45,46 @@ namespace azure { namespace storage_lite {
             return *this;
         }
 
+        bool ms_range_get_content_md5() const override
+        {
+            return m_range_get_content_md5;
+        }
+
+        download_blob_request &set_ms_range_get_content_md5(bool range_get_content_md5)
+        {
+            m_range_get_content_md5 = range_get_content_md5;
+            return *this;
+        }
+
+        bool ms_range_get_content_crc64() const override
+        {
+            return m_range_get_content_crc64;
+        }
+
+        download_blob_request &set_ms_range_get_content_crc64(bool range_get_content_crc64)
+        {
+            m_range_get_content_crc64 = range_get_content_crc64;
+            return *this;
+        }
+
+        std::string if_none_match() const override
+        {
+            return m_if_none_match;
+        }
+
+        download_blob_request &set_if_none_match(const std::string &if_none_match)
+        {
+            m_if_none_match = if_none_match;
+            return *this;
+        }
+
     private:
         std::string m_container;
         std::string m_blob;
         unsigned long long m_start_byte;
         unsigned long long m_end_byte;
+        std::string m_if_none_match;
+        bool m_range_get_content_md5 = false;
+        bool m_range_get_content_crc64 = false;
     };
 }}  // azure::storage_lite
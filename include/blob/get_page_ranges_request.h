@@ -45,11 +45,35 @@ namespace azure {  namespace storage_lite {
             return *this;
         }
 
+        std::string snapshot() const override
+        {
+            return m_snapshot;
+        }
+
+        get_page_ranges_request &set_snapshot(const std::string &snapshot)
+        {
+            m_snapshot = snapshot;
+            return *this;
+        }
+
+        std::string prevsnapshot() const override
+        {
+            return m_prevsnapshot;
+        }
+
+        get_page_ranges_request &set_prevsnapshot(const std::string &prevsnapshot)
+        {
+            m_prevsnapshot = prevsnapshot;
+            return *this;
+        }
+
     private:
         std::string m_container;
         std::string m_blob;
         unsigned long long m_start_byte;
         unsigned long long m_end_byte;
+        std::string m_snapshot;
+        std::string m_prevsnapshot;
     };
 
 }}  // azure::storage_lite
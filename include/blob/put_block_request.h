@@ -39,12 +39,36 @@ namespace azure {  namespace storage_lite {
             return *this;
         }
 
+        std::string content_md5() const override
+        {
+            return m_content_md5;
+        }
+
+        put_block_request &set_content_md5(const std::string &content_md5)
+        {
+            m_content_md5 = content_md5;
+            return *this;
+        }
+
+        std::string content_crc64() const override
+        {
+            return m_content_crc64;
+        }
+
+        put_block_request &set_content_crc64(const std::string &content_crc64)
+        {
+            m_content_crc64 = content_crc64;
+            return *this;
+        }
+
     private:
         std::string m_container;
         std::string m_blob;
         std::string m_blockid;
 
         unsigned int m_content_length;
+        std::string m_content_md5;
+        std::string m_content_crc64;
     };
 
 }}  // azure::storage_lite
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "storage_EXPORTS.h"
+
+#include "delete_blob_request_base.h"
+#include "http_base.h"
+#include "storage_account.h"
+#include "storage_outcome.h"
+#include "storage_request_base.h"
+
+namespace azure {  namespace storage_lite {
+
+    enum class access_tier
+    {
+        hot,
+        cool,
+        archive
+    };
+
+    /// <summary>
+    /// Sends several blob operations in a single multipart/mixed request. Every sub-request is signed on its own,
+    /// and the service answers each of them in the same order.
+    /// </summary>
+    class blob_batch_request_base : public blob_request_base
+    {
+    public:
+        enum class operation
+        {
+            del,
+            set_tier
+        };
+
+        struct subrequest
+        {
+            operation type;
+            std::string container;
+            std::string blob;
+            // Only used by delete.
+            delete_blob_request_base::delete_snapshots snapshots;
+            // Only used by set tier.
+            access_tier tier;
+        };
+
+        virtual std::vector<subrequest> subrequests() const = 0;
+
+        /// <summary>
+        /// Gets the boundary between the parts of the request body.
+        /// </summary>
+        virtual std::string boundary() const = 0;
+
+        /// <summary>
+        /// Gets the multipart body holding the signed sub-requests.
+        /// </summary>
+        AZURE_STORAGE_API std::string build_body(const storage_account &a) const;
+
+        AZURE_STORAGE_API void build_request(const storage_account &a, http_base &h) const override;
+    };
+
+    class blob_batch_response
+    {
+    public:
+        // One result per sub-request, in the order they were sent. A failed result holds the status code of the sub-request
+        // in its error code and the service error code in its code name.
+        std::vector<storage_outcome<void>> results;
+    };
+
+    /// <summary>
+    /// Parses the multipart body of a batch response.
+    /// </summary>
+    AZURE_STORAGE_API blob_batch_response parse_blob_batch_response(const std::string &body);
+
+}}  // azure::storage_lite
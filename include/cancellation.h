@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Cancels the requests it is attached to, either on demand or once a deadline passes.
+    /// Copies share their state, so cancelling one copy cancels the requests of all of them.
+    /// </summary>
+    class cancellation_token final
+    {
+    public:
+        cancellation_token() : m_state(std::make_shared<state>()) {}
+
+        /// <summary>
+        /// Gets a token that is never cancelled.
+        /// </summary>
+        static cancellation_token none()
+        {
+            return cancellation_token(nullptr);
+        }
+
+        /// <summary>
+        /// Gets a token cancelled once the deadline passes.
+        /// </summary>
+        static cancellation_token with_deadline(std::chrono::steady_clock::time_point deadline)
+        {
+            cancellation_token token;
+            token.set_deadline(deadline);
+            return token;
+        }
+
+        /// <summary>
+        /// Gets a token cancelled once the timeout elapses from now.
+        /// </summary>
+        static cancellation_token with_timeout(std::chrono::steady_clock::duration timeout)
+        {
+            return with_deadline(std::chrono::steady_clock::now() + timeout);
+        }
+
+        void cancel()
+        {
+            if (m_state)
+            {
+                m_state->cancelled = true;
+            }
+        }
+
+        void set_deadline(std::chrono::steady_clock::time_point deadline)
+        {
+            if (m_state)
+            {
+                m_state->deadline = deadline.time_since_epoch().count();
+            }
+        }
+
+        bool has_deadline() const
+        {
+            return m_state && m_state->deadline != no_deadline;
+        }
+
+        std::chrono::steady_clock::time_point deadline() const
+        {
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_state ? m_state->deadline.load() : no_deadline));
+        }
+
+        /// <summary>
+        /// Gets whether the deadline has passed.
+        /// </summary>
+        bool is_expired() const
+        {
+            return has_deadline() && std::chrono::steady_clock::now() >= deadline();
+        }
+
+        /// <summary>
+        /// Gets whether the token was cancelled or its deadline has passed.
+        /// </summary>
+        bool is_cancelled() const
+        {
+            return m_state && (m_state->cancelled || is_expired());
+        }
+
+    private:
+        static const std::chrono::steady_clock::rep no_deadline = std::chrono::steady_clock::duration::max().count();
+
+        struct state
+        {
+            std::atomic<bool> cancelled{ false };
+            std::atomic<std::chrono::steady_clock::rep> deadline{ no_deadline };
+        };
+
+        explicit cancellation_token(std::shared_ptr<state> state) : m_state(std::move(state)) {}
+
+        std::shared_ptr<state> m_state;
+    };
+
+}}  // azure::storage_lite
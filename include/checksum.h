@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    enum class checksum_type
+    {
+        none,
+        md5,
+        crc64
+    };
+
+    /// <summary>
+    /// Extends a CRC64 with more data, using the polynomial of the x-ms-content-crc64 header. Starting from 0 computes the CRC64 of the data.
+    /// </summary>
+    AZURE_STORAGE_API uint64_t crc64(const char* data, size_t length, uint64_t crc = 0);
+
+    /// <summary>
+    /// Computes the same CRC64 as <see cref="azure::storage_lite::crc64" /> with the portable table implementation, whatever the CPU supports.
+    /// </summary>
+    AZURE_STORAGE_API uint64_t crc64_portable(const char* data, size_t length, uint64_t crc = 0);
+
+    /// <summary>
+    /// Computes a transactional checksum incrementally.
+    /// </summary>
+    class checksum_calculator final
+    {
+    public:
+        AZURE_STORAGE_API explicit checksum_calculator(checksum_type type);
+        AZURE_STORAGE_API ~checksum_calculator();
+
+        checksum_calculator(const checksum_calculator &) = delete;
+        checksum_calculator &operator=(const checksum_calculator &) = delete;
+
+        checksum_type type() const
+        {
+            return m_type;
+        }
+
+        AZURE_STORAGE_API void update(const char* data, size_t length);
+
+        AZURE_STORAGE_API void reset();
+
+        /// <summary>
+        /// Gets the checksum of the data so far, base64 encoded as in the Content-MD5 and x-ms-content-crc64 headers.
+        /// </summary>
+        AZURE_STORAGE_API std::string value() const;
+
+        /// <summary>
+        /// Computes the checksum of a buffer, base64 encoded as in the Content-MD5 and x-ms-content-crc64 headers.
+        /// </summary>
+        AZURE_STORAGE_API static std::string compute(checksum_type type, const char* data, size_t length);
+
+    private:
+        struct md5_context;
+
+        checksum_type m_type;
+        uint64_t m_crc64;
+        std::unique_ptr<md5_context> m_md5;
+    };
+
+    /// <summary>
+    /// An output stream that forwards to another stream and checksums the data written on the way.
+    /// Seeking back to the initial position, as a retried request does, restarts the checksum.
+    /// </summary>
+    class checksum_ostream final : public std::ostream
+    {
+    public:
+        checksum_ostream(std::ostream &target, checksum_type type)
+            : std::ostream(&m_streambuf),
+            m_streambuf(target.rdbuf(), type) {}
+
+        std::string checksum() const
+        {
+            return m_streambuf.checksum();
+        }
+
+    private:
+        class checksum_streambuf final : public std::streambuf
+        {
+        public:
+            checksum_streambuf(std::streambuf *target, checksum_type type)
+                : m_target(target),
+                m_calculator(type),
+                m_initial(target->pubseekoff(0, std::ios_base::cur, std::ios_base::out)) {}
+
+            std::string checksum() const
+            {
+                return m_calculator.value();
+            }
+
+        protected:
+            std::streamsize xsputn(const char *s, std::streamsize n) override
+            {
+                std::streamsize written = m_target->sputn(s, n);
+                m_calculator.update(s, static_cast<size_t>(written));
+                return written;
+            }
+
+            int_type overflow(int_type ch) override
+            {
+                if (traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    return traits_type::not_eof(ch);
+                }
+                char c = traits_type::to_char_type(ch);
+                return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+            }
+
+            pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+            {
+                pos_type pos = m_target->pubseekoff(off, dir, which);
+                if ((off != 0 || dir != std::ios_base::cur) && pos == m_initial)
+                {
+                    m_calculator.reset();
+                }
+                return pos;
+            }
+
+            pos_type seekpos(pos_type sp, std::ios_base::openmode which) override
+            {
+                pos_type pos = m_target->pubseekpos(sp, which);
+                if (pos == m_initial)
+                {
+                    m_calculator.reset();
+                }
+                return pos;
+            }
+
+            int sync() override
+            {
+                return m_target->pubsync();
+            }
+
+        private:
+            std::streambuf *m_target;
+            checksum_calculator m_calculator;
+            pos_type m_initial;
+        };
+
+        checksum_streambuf m_streambuf;
+    };
+
+}}  // azure::storage_lite
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Stops sending requests to an account endpoint that keeps failing, so callers fail fast instead of
+    /// spending retries and connections on it. After a while a few probe requests are let through, and the
+    /// endpoint is used again once they succeed.
+    /// </summary>
+    class circuit_breaker final
+    {
+    public:
+        enum class state
+        {
+            closed,
+            open,
+            half_open
+        };
+
+        enum class result
+        {
+            success,
+            failure,
+            // The request ended without telling anything about the endpoint, e.g. it was cancelled.
+            neutral
+        };
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::circuit_breaker" /> class.
+        /// </summary>
+        /// <param name="failure_ratio">The fraction of failed requests within the window that opens the circuit.</param>
+        /// <param name="min_requests">The circuit is not opened before this many requests have completed within the window.</param>
+        /// <param name="window">The period over which the failure ratio is measured.</param>
+        /// <param name="open_duration">How long requests are rejected before the endpoint is probed.</param>
+        /// <param name="half_open_probes">The number of probe requests allowed at a time, all of them must succeed to close the circuit.</param>
+        AZURE_STORAGE_API explicit circuit_breaker(double failure_ratio = 0.5, int min_requests = 10,
+            std::chrono::milliseconds window = std::chrono::milliseconds(10000),
+            std::chrono::milliseconds open_duration = std::chrono::milliseconds(5000), int half_open_probes = 1);
+
+        /// <summary>
+        /// The answer to <see cref="allow" />, handed back with the result of the request it let through.
+        /// </summary>
+        struct admission
+        {
+            bool allowed = false;
+            // Whether the request is one of the probes of a half-open circuit.
+            bool probe = false;
+            // The state the request was let through in, its result is ignored once the circuit has changed state since.
+            uint64_t generation = 0;
+
+            explicit operator bool() const
+            {
+                return allowed;
+            }
+        };
+
+        /// <summary>
+        /// Gets whether a request may be sent to the endpoint. A request that is allowed must report its result.
+        /// </summary>
+        AZURE_STORAGE_API admission allow(const std::string &endpoint);
+
+        /// <summary>
+        /// Reports the result of a request that was allowed.
+        /// </summary>
+        /// <param name="endpoint">The endpoint the request was sent to.</param>
+        /// <param name="a">The admission of the request.</param>
+        /// <param name="r">The result of the request.</param>
+        AZURE_STORAGE_API void record(const std::string &endpoint, const admission &a, result r);
+
+        AZURE_STORAGE_API state get_state(const std::string &endpoint) const;
+
+        /// <summary>
+        /// Gets the endpoint a request url is sent to, made of its scheme, host and port.
+        /// </summary>
+        AZURE_STORAGE_API static std::string endpoint_of(const std::string &url);
+
+    private:
+        static const int bucket_count = 10;
+
+        struct bucket
+        {
+            int64_t index = -1;
+            int successes = 0;
+            int failures = 0;
+        };
+
+        struct endpoint_state
+        {
+            state current = state::closed;
+            // Counts the state changes, so results of requests let through in an earlier state are told apart.
+            uint64_t generation = 0;
+            std::chrono::steady_clock::time_point opened_at;
+            int probes_in_flight = 0;
+            int probe_successes = 0;
+            bucket buckets[bucket_count];
+        };
+
+        void open(endpoint_state &endpoint, std::chrono::steady_clock::time_point now);
+        void close(endpoint_state &endpoint);
+
+        double m_failure_ratio;
+        int m_min_requests;
+        std::chrono::steady_clock::duration m_bucket_width;
+        std::chrono::steady_clock::duration m_open_duration;
+        int m_half_open_probes;
+
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, endpoint_state> m_endpoints;
+    };
+
+}}  // azure::storage_lite
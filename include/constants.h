@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "storage_EXPORTS.h"
@@ -13,5 +14,6 @@ namespace azure {  namespace storage_lite {  namespace constants {
     const uint64_t default_block_size = 8 * 1024 * 1024;
     const uint64_t max_block_size = 100 * 1024 * 1024;
     const uint64_t max_num_blocks = 50000;
+    const size_t max_batch_subrequests = 256;
 
 }}}  // azure::storage_lite::constants
@@ -9,12 +9,15 @@
 #include "storage_EXPORTS.h"
 
 #include "common.h"
+#include "storage_errno.h"
 #include "storage_outcome.h"
 #include "storage_account.h"
 #include "http_base.h"
 #include "xml_parser_base.h"
 #include "json_parser_base.h"
 #include "retry.h"
+#include "circuit_breaker.h"
+#include "request_governor.h"
 #include "utility.h"
 
 namespace azure {  namespace storage_lite {
@@ -51,10 +54,38 @@ namespace azure {  namespace storage_lite {
                 m_retry_policy = std::move(retry_policy);
             }
 
+            std::shared_ptr<storage_lite::circuit_breaker> circuit_breaker() const
+            {
+                return m_circuit_breaker;
+            }
+
+            /// <summary>
+            /// Sets the breaker every attempt is checked against, a null breaker never rejects a request.
+            /// </summary>
+            void set_circuit_breaker(std::shared_ptr<storage_lite::circuit_breaker> breaker)
+            {
+                m_circuit_breaker = std::move(breaker);
+            }
+
+            std::shared_ptr<storage_lite::request_governor> request_governor() const
+            {
+                return m_request_governor;
+            }
+
+            /// <summary>
+            /// Sets the governor pacing every attempt, retries included, a null governor sends requests at once.
+            /// </summary>
+            void set_request_governor(std::shared_ptr<storage_lite::request_governor> governor)
+            {
+                m_request_governor = std::move(governor);
+            }
+
         private:
             std::shared_ptr<xml_parser_base> m_xml_parser;
             std::shared_ptr<json_parser_base> m_json_parser;
             std::shared_ptr<retry_policy_base> m_retry_policy;
+            std::shared_ptr<storage_lite::circuit_breaker> m_circuit_breaker;
+            std::shared_ptr<storage_lite::request_governor> m_request_governor;
         };
 
         template<typename RESPONSE_TYPE>
@@ -70,6 +101,24 @@ namespace azure {  namespace storage_lite {
                 std::shared_ptr<executor_context> context,
                 std::shared_ptr<retry_context> retry)
             {
+                if (http->is_cancelled())
+                {
+                    storage_error error;
+                    if (http->get_cancellation_token().is_expired())
+                    {
+                        error.code = std::to_string(operation_timed_out);
+                        error.code_name = "OperationTimedOut";
+                    }
+                    else
+                    {
+                        error.code = std::to_string(operation_cancelled);
+                        error.code_name = "OperationCancelled";
+                    }
+                    *outcome = storage_outcome<RESPONSE_TYPE>(error);
+                    promise->set_value(*outcome);
+                    return;
+                }
+
                 http->reset();
                 http->set_error_stream([](http_base::http_code) { return true; }, storage_iostream::create_storage_stream());
                 request->build_request(*account, *http);
@@ -77,8 +126,45 @@ namespace azure {  namespace storage_lite {
                 retry_info info = retry->numbers() == 0 ? retry_info(true, std::chrono::seconds(0)) : context->retry_policy()->evaluate(*retry);
                 if (info.should_retry())
                 {
-                    http->submit([promise, outcome, account, request, http, context, retry](http_base::http_code result, storage_istream s, CURLcode code)
+                    const auto breaker = context->circuit_breaker();
+                    const auto endpoint = breaker ? circuit_breaker::endpoint_of(http->get_url()) : std::string();
+                    const auto admission = breaker ? breaker->allow(endpoint) : circuit_breaker::admission();
+                    if (breaker && !admission)
+                    {
+                        storage_error error;
+                        error.code = std::to_string(circuit_open);
+                        error.code_name = "CircuitOpen";
+                        *outcome = storage_outcome<RESPONSE_TYPE>(error);
+                        promise->set_value(*outcome);
+                        return;
+                    }
+
+                    const auto governor = context->request_governor();
+                    const auto delay = governor ? governor->reserve(request_governor::container_of(*account, http->get_url())) : std::chrono::nanoseconds(0);
+                    if (delay > std::chrono::nanoseconds(0))
+                    {
+                        // The handle goes back to the pool while the request waits for its slot, so paced requests do not hold up the others.
+                        http->suspend();
+                        if (!request_governor::wait_for(delay, [http]() { return http->is_cancelled(); }))
+                        {
+                            if (breaker)
+                            {
+                                breaker->record(endpoint, admission, circuit_breaker::result::neutral);
+                            }
+                            // Reports the cancellation.
+                            async_executor<RESPONSE_TYPE>::submit_helper(promise, outcome, account, request, http, context, retry);
+                            return;
+                        }
+                        http->resume();
+                    }
+
+                    http->submit([promise, outcome, account, request, http, context, retry, breaker, endpoint, admission](http_base::http_code result, storage_istream s, CURLcode code)
                     {
+                        if (breaker)
+                        {
+                            breaker->record(endpoint, admission, code != CURLE_OK ? (http->is_cancelled() ? circuit_breaker::result::neutral : circuit_breaker::result::failure)
+                                : (result >= 500 ? circuit_breaker::result::failure : circuit_breaker::result::success));
+                        }
                         std::string str(std::istreambuf_iterator<char>(s.istream()), std::istreambuf_iterator<char>());
                         if (code != CURLE_OK || unsuccessful(result))
                         {
@@ -144,6 +230,24 @@ namespace azure {  namespace storage_lite {
                 std::shared_ptr<executor_context> context,
                 std::shared_ptr<retry_context> retry)
             {
+                if (http->is_cancelled())
+                {
+                    storage_error error;
+                    if (http->get_cancellation_token().is_expired())
+                    {
+                        error.code = std::to_string(operation_timed_out);
+                        error.code_name = "OperationTimedOut";
+                    }
+                    else
+                    {
+                        error.code = std::to_string(operation_cancelled);
+                        error.code_name = "OperationCancelled";
+                    }
+                    *outcome = storage_outcome<void>(error);
+                    promise->set_value(*outcome);
+                    return;
+                }
+
                 http->reset();
                 http->set_error_stream(unsuccessful, storage_iostream::create_storage_stream());
                 request->build_request(*account, *http);
@@ -151,8 +255,45 @@ namespace azure {  namespace storage_lite {
                 retry_info info = retry->numbers() == 0 ? retry_info(true, std::chrono::seconds(0)) : context->retry_policy()->evaluate(*retry);
                 if (info.should_retry())
                 {
-                    http->submit([promise, outcome, account, request, http, context, retry](http_base::http_code result, storage_istream s, CURLcode code)
+                    const auto breaker = context->circuit_breaker();
+                    const auto endpoint = breaker ? circuit_breaker::endpoint_of(http->get_url()) : std::string();
+                    const auto admission = breaker ? breaker->allow(endpoint) : circuit_breaker::admission();
+                    if (breaker && !admission)
                     {
+                        storage_error error;
+                        error.code = std::to_string(circuit_open);
+                        error.code_name = "CircuitOpen";
+                        *outcome = storage_outcome<void>(error);
+                        promise->set_value(*outcome);
+                        return;
+                    }
+
+                    const auto governor = context->request_governor();
+                    const auto delay = governor ? governor->reserve(request_governor::container_of(*account, http->get_url())) : std::chrono::nanoseconds(0);
+                    if (delay > std::chrono::nanoseconds(0))
+                    {
+                        // The handle goes back to the pool while the request waits for its slot, so paced requests do not hold up the others.
+                        http->suspend();
+                        if (!request_governor::wait_for(delay, [http]() { return http->is_cancelled(); }))
+                        {
+                            if (breaker)
+                            {
+                                breaker->record(endpoint, admission, circuit_breaker::result::neutral);
+                            }
+                            // Reports the cancellation.
+                            async_executor<void>::submit_helper(promise, outcome, account, request, http, context, retry);
+                            return;
+                        }
+                        http->resume();
+                    }
+
+                    http->submit([promise, outcome, account, request, http, context, retry, breaker, endpoint, admission](http_base::http_code result, storage_istream s, CURLcode code)
+                    {
+                        if (breaker)
+                        {
+                            breaker->record(endpoint, admission, code != CURLE_OK ? (http->is_cancelled() ? circuit_breaker::result::neutral : circuit_breaker::result::failure)
+                                : (result >= 500 ? circuit_breaker::result::failure : circuit_breaker::result::success));
+                        }
                         if (code != CURLE_OK || unsuccessful(result))
                         {
                             storage_error error;
@@ -54,6 +54,8 @@ namespace azure {  namespace storage_lite {
         std::vector<std::pair<std::string, std::string>> metadata;
         std::string copy_status;
         time_t last_modified;
+        // The number of blocks committed to an append blob, 0 for other blob types.
+        unsigned long long committed_block_count = 0;
         // TODO: support lease and blob_type
         // blob_type m_type;
         // azure::storage::lease_status m_lease_status;
@@ -21,6 +21,7 @@ namespace azure {  namespace storage_lite {
         virtual unsigned long long end_byte() const { return 0; }
         virtual std::string origin() const { return std::string(); }
         virtual bool ms_range_get_content_md5() const { return false; }
+        virtual bool ms_range_get_content_crc64() const { return false; }
 
         AZURE_STORAGE_API void build_request(const storage_account &a, http_base &h) const override;
     };
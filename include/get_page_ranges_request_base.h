@@ -20,6 +20,8 @@ namespace azure {  namespace storage_lite {
         virtual unsigned long long end_byte() const { return 0; }
 
         virtual std::string snapshot() const { return std::string(); }
+        // When set, only the ranges that changed since this snapshot are returned, and ranges cleared since then are reported in the clear list.
+        virtual std::string prevsnapshot() const { return std::string(); }
 
         AZURE_STORAGE_API void build_request(const storage_account &a, http_base &h) const override;
     };
@@ -35,6 +37,7 @@ namespace azure {  namespace storage_lite {
     {
     public:
         std::vector<get_page_ranges_item> pagelist;
+        std::vector<get_page_ranges_item> clearlist;
     };
 
 }}  // azure::storage_lite
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,4 +10,32 @@
 
 namespace azure {  namespace storage_lite {
     AZURE_STORAGE_API std::string hash(const std::string &to_sign, const std::vector<unsigned char> &key);
+    AZURE_STORAGE_API std::vector<unsigned char> sha256(const char* data, size_t length);
+
+    /// <summary>
+    /// Computes HMAC-SHA256 signatures with a fixed key. The key is processed once, each signature starts from a copy of the keyed state.
+    /// </summary>
+    /// <remarks>
+    /// Signing is thread safe, copies of a signer share the keyed state.
+    /// </remarks>
+    class hmac_sha256_signer final
+    {
+    public:
+        AZURE_STORAGE_API explicit hmac_sha256_signer(const std::vector<unsigned char> &key);
+
+        /// <summary>
+        /// Signs the data and returns the base64 encoded signature.
+        /// </summary>
+        AZURE_STORAGE_API std::string sign(const char* data, size_t length) const;
+
+        std::string sign(const std::string &data) const
+        {
+            return sign(data.data(), data.size());
+        }
+
+    private:
+        struct keyed_state;
+
+        std::shared_ptr<const keyed_state> m_state;
+    };
 }}  // azure::storage_lite
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Decides when a read still waiting for its response is duplicated on another connection.
+    /// The delay follows a percentile of how long recent reads waited for their response, and hedges are limited to a fraction of the reads.
+    /// </summary>
+    class hedging_policy final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::hedging_policy" /> class.
+        /// </summary>
+        /// <param name="percentile">The percentile of recent times to first byte after which a read is hedged.</param>
+        /// <param name="max_hedge_ratio">The largest fraction of reads that are hedged over time.</param>
+        /// <param name="max_read_size">Reads larger than this are never hedged.</param>
+        /// <param name="min_delay">The lower bound of the delay.</param>
+        /// <param name="max_delay">The upper bound of the delay, also used until enough latencies are known.</param>
+        AZURE_STORAGE_API explicit hedging_policy(double percentile = 0.95, double max_hedge_ratio = 0.05, uint64_t max_read_size = 4 * 1024 * 1024,
+            std::chrono::milliseconds min_delay = std::chrono::milliseconds(2), std::chrono::milliseconds max_delay = std::chrono::milliseconds(500));
+
+        uint64_t max_read_size() const
+        {
+            return m_max_read_size;
+        }
+
+        /// <summary>
+        /// Gets how long a read waits for its response before it is hedged.
+        /// </summary>
+        AZURE_STORAGE_API std::chrono::microseconds delay() const;
+
+        /// <summary>
+        /// Records how long a completed read waited for the status line of its response, each read also earns a share of a hedge.
+        /// </summary>
+        AZURE_STORAGE_API void record(std::chrono::microseconds latency);
+
+        /// <summary>
+        /// Takes a hedge from the budget, returning false if the budget is used up.
+        /// </summary>
+        AZURE_STORAGE_API bool try_hedge();
+
+    private:
+        double m_percentile;
+        double m_max_hedge_ratio;
+        uint64_t m_max_read_size;
+        std::chrono::microseconds m_min_delay;
+        std::chrono::microseconds m_max_delay;
+
+        mutable std::mutex m_mutex;
+        std::vector<int64_t> m_latencies;
+        size_t m_next_latency;
+        double m_budget;
+    };
+
+}}  // azure::storage_lite
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <functional>
 #include <future>
 #include <map>
@@ -17,19 +21,34 @@
 
 #include "storage_EXPORTS.h"
 
+#include "bandwidth_throttle.h"
 #include "http_base.h"
+#include "timeout_policy.h"
 
 namespace azure {  namespace storage_lite {
 
     class CurlEasyClient;
 
+    /// <summary>
+    /// The priority of a request waiting for a handle of a <see cref="azure::storage_lite::CurlEasyClient" />.
+    /// </summary>
+    enum class request_priority
+    {
+        // Small operations a user waits on, such as reading properties.
+        interactive,
+        normal,
+        // Large transfers that can make do with spare handles.
+        bulk
+    };
+
     class CurlEasyRequest final : public http_base
     {
 
         using REQUEST_TYPE = CurlEasyRequest;
 
     public:
-        AZURE_STORAGE_API CurlEasyRequest(std::shared_ptr<CurlEasyClient> client, CURL *h);
+        AZURE_STORAGE_API CurlEasyRequest(std::shared_ptr<CurlEasyClient> client, CURL *h, std::chrono::steady_clock::time_point last_used = std::chrono::steady_clock::time_point(),
+            request_priority priority = request_priority::normal);
 
         AZURE_STORAGE_API ~CurlEasyRequest();
 
@@ -56,14 +75,12 @@ namespace azure {  namespace storage_lite {
         void add_header(const std::string &name, const std::string &value) override
         {
             m_request_headers.emplace(name, value);
-            std::string header(name);
-            header.append(": ").append(value);
+            // curl copies the line, so one buffer per thread serves every header.
+            thread_local std::string header;
+            header.assign(name).append(": ").append(value);
             m_slist = curl_slist_append(m_slist, header.data());
-            if (name == "Content-Length") {
-                unsigned int l;
-                std::istringstream iss(value);
-                iss >> l;
-                curl_easy_setopt(m_curl, CURLOPT_INFILESIZE, l);
+            if (m_curl && name == "Content-Length") {
+                curl_easy_setopt(m_curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(std::strtoull(value.data(), nullptr, 10)));
             }
         }
 
@@ -72,19 +89,14 @@ namespace azure {  namespace storage_lite {
             return m_request_headers;
         }
 
-        std::string get_response_header(const std::string &name) const override
-        {
-            auto iter = m_response_headers.find(name);
-            if (iter != m_response_headers.end())
-            {
-                return iter->second;
-            }
-            else
-            {
-                return "";
-            }
-        }
-        const std::map<std::string, std::string, case_insensitive_compare>& get_response_headers() const override
+        AZURE_STORAGE_API const std::string &get_response_header(const std::string &name) const override;
+
+        /// <summary>
+        /// Takes a line of the response head as libcurl hands it over, either a status line or a header.
+        /// </summary>
+        AZURE_STORAGE_API static size_t header_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+
+        const std::vector<std::pair<std::string, std::string>>& get_response_headers() const override
         {
             return m_response_headers;
         }
@@ -93,7 +105,12 @@ namespace azure {  namespace storage_lite {
 
         void submit(std::function<void(http_code, storage_istream, CURLcode)> cb, std::chrono::seconds interval) override
         {
-            std::this_thread::sleep_for(interval);
+            // Wait out the retry interval in slices so a cancelled request does not sleep through it.
+            const auto wake = std::chrono::steady_clock::now() + interval;
+            for (auto now = std::chrono::steady_clock::now(); now < wake && !is_cancelled(); now = std::chrono::steady_clock::now())
+            {
+                std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(wake - now, std::chrono::milliseconds(50)));
+            }
             const auto curlCode = perform();
             cb(m_code, m_error_stream, curlCode);
         }
@@ -102,6 +119,8 @@ namespace azure {  namespace storage_lite {
         {
             m_request_headers.clear();
             m_response_headers.clear();
+            m_known_response_headers.fill(-1);
+            m_response_started = false;
             curl_slist_free_all(m_slist);
             m_slist = NULL;
         }
@@ -114,6 +133,10 @@ namespace azure {  namespace storage_lite {
         void set_output_stream(storage_ostream s) override
         {
             m_output_stream = s;
+            if (!m_curl)
+            {
+                return;
+            }
             check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, write));
             check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this));
         }
@@ -127,10 +150,36 @@ namespace azure {  namespace storage_lite {
         void set_input_stream(storage_istream s) override
         {
             m_input_stream = s;
+            if (!m_curl)
+            {
+                return;
+            }
             check_code(curl_easy_setopt(m_curl, CURLOPT_READFUNCTION, read));
             check_code(curl_easy_setopt(m_curl, CURLOPT_READDATA, this));
         }
 
+        void set_input_buffer(storage_input_buffer b) override
+        {
+            m_input_buffer = std::move(b);
+            if (!m_curl)
+            {
+                return;
+            }
+            check_code(curl_easy_setopt(m_curl, CURLOPT_READFUNCTION, read));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_READDATA, this));
+        }
+
+        void set_output_buffer(storage_output_buffer b) override
+        {
+            m_output_buffer = std::move(b);
+            if (!m_curl)
+            {
+                return;
+            }
+            check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, write));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this));
+        }
+
         void set_input_content_length(uint64_t content_length)
         {
             m_input_content_length = content_length;
@@ -149,12 +198,14 @@ namespace azure {  namespace storage_lite {
         void reset_input_stream() override
         {
             m_input_stream.reset();
+            m_input_buffer.reset();
             m_input_read_pos = 0;
         }
 
         void reset_output_stream() override
         {
             m_output_stream.reset();
+            m_output_buffer.reset();
         }
 
         storage_ostream get_output_stream() const override
@@ -172,8 +223,62 @@ namespace azure {  namespace storage_lite {
             return m_input_stream;
         }
 
+        void cancel() override
+        {
+            m_cancelled = true;
+        }
+
+        bool is_cancelled() const override
+        {
+            return m_cancelled || m_cancellation_token.is_cancelled();
+        }
+
+        void set_cancellation_token(cancellation_token token) override
+        {
+            m_cancellation_token = std::move(token);
+        }
+
+        const cancellation_token &get_cancellation_token() const override
+        {
+            return m_cancellation_token;
+        }
+
+        AZURE_STORAGE_API void suspend() override;
+
+        AZURE_STORAGE_API void resume() override;
+
+        /// <summary>
+        /// Gets when the handle was last returned to the pool, the epoch of the steady clock for a new handle.
+        /// </summary>
+        std::chrono::steady_clock::time_point last_used() const
+        {
+            return m_last_used;
+        }
+
+        /// <summary>
+        /// Gets whether the status line of the response has arrived.
+        /// </summary>
+        bool response_started() const
+        {
+            return m_response_started;
+        }
+
+        /// <summary>
+        /// Gets how long the last attempt waited for the status line of its response, which excludes the transfer of the body.
+        /// </summary>
+        std::chrono::microseconds time_to_first_byte() const
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(m_response_started_at - m_performed_at);
+        }
+
         void set_absolute_timeout(long long timeout) override
         {
+            m_absolute_timeout = timeout;
+            m_data_rate_timeout = false;
+            if (!m_curl)
+            {
+                return;
+            }
             check_code(curl_easy_setopt(m_curl, CURLOPT_TIMEOUT, timeout)); // Absolute timeout
 
             // For the moment, we are only using one type of timeout per operation, so we clear the other one, in case it was set for this handle by a prior operation:
@@ -183,6 +288,13 @@ namespace azure {  namespace storage_lite {
 
         void set_data_rate_timeout() override
         {
+            m_absolute_timeout = 0;
+            m_data_rate_timeout = true;
+            if (!m_curl)
+            {
+                return;
+            }
+
             // If the download speed is less than 17KB/sec for more than a minute, timout. This time was selected because it should ensure that downloading each megabyte take no more than a minute.
             check_code(curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_TIME, 60L)); 
             check_code(curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_LIMIT, 1024L * 17L));
@@ -194,6 +306,9 @@ namespace azure {  namespace storage_lite {
     private:
         std::shared_ptr<CurlEasyClient> m_client;
         CURL *m_curl;
+        std::chrono::steady_clock::time_point m_acquired_at = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point m_last_used;
+        request_priority m_priority;
         curl_slist *m_slist;
         std::map<std::string, std::string, case_insensitive_compare> m_request_headers;
 
@@ -201,21 +316,68 @@ namespace azure {  namespace storage_lite {
         std::string m_url;
         storage_istream m_input_stream;
         storage_ostream m_output_stream;
+        storage_input_buffer m_input_buffer;
+        storage_output_buffer m_output_buffer;
         storage_iostream m_error_stream;
         uint64_t m_input_content_length = 0;
         uint64_t m_input_read_pos = 0;
         bool m_is_input_length_known = false;
         std::function<bool(http_code)> m_switch_error_callback;
+        std::atomic<bool> m_cancelled{ false };
+        cancellation_token m_cancellation_token = cancellation_token::none();
+        long long m_absolute_timeout = 0;
+        bool m_data_rate_timeout = false;
+        // Attempts performed so far, each retry doubles the timeouts up to 16 times.
+        int m_attempts = 0;
+        std::atomic<bool> m_response_started{ false };
+        std::chrono::steady_clock::time_point m_performed_at;
+        std::chrono::steady_clock::time_point m_response_started_at;
+        // The throttle of the client when the attempt started.
+        std::shared_ptr<bandwidth_throttle> m_throttle;
 
         http_code m_code;
-        std::map<std::string, std::string, case_insensitive_compare> m_response_headers;
+        std::vector<std::pair<std::string, std::string>> m_response_headers;
+        // Positions in m_response_headers of the latest value of each well-known header, -1 when absent.
+        std::array<int, 32> m_known_response_headers;
 
-        AZURE_STORAGE_API static size_t header_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+        // Sets up a handle taken from the pool, again with everything already set on the request after a resume.
+        void bind_handle();
+        AZURE_STORAGE_API void apply_timeouts(const std::shared_ptr<timeout_policy> &policy);
+        AZURE_STORAGE_API void record_timings(const std::shared_ptr<timeout_policy> &policy);
+
+        bool throttled() const
+        {
+            return m_throttle && (m_throttle->upload().limited() || m_throttle->download().limited());
+        }
+
+        // Waits for the bytes to fit in the budget of the bucket, returning false if the request is cancelled meanwhile.
+        AZURE_STORAGE_API bool pace(token_bucket &bucket, size_t bytes);
+
+        static int progress(void *userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+        {
+            // A non-zero return aborts the transfer with CURLE_ABORTED_BY_CALLBACK.
+            return static_cast<REQUEST_TYPE *>(userdata)->is_cancelled() ? 1 : 0;
+        }
 
         static size_t write(char *buffer, size_t size, size_t nitems, void *userdata)
         {
             REQUEST_TYPE *p = static_cast<REQUEST_TYPE *>(userdata);
-            p->m_output_stream.ostream().write(buffer, size * nitems);
+            if (p->m_output_buffer.valid())
+            {
+                // A short count makes curl fail the transfer with CURLE_WRITE_ERROR.
+                if (!p->m_output_buffer.write(buffer, size * nitems))
+                {
+                    return 0;
+                }
+            }
+            else
+            {
+                p->m_output_stream.ostream().write(buffer, size * nitems);
+            }
+            if (p->m_throttle && !p->pace(p->m_throttle->download(), size * nitems))
+            {
+                return 0;
+            }
             return size * nitems;
         }
 
@@ -229,23 +391,33 @@ namespace azure {  namespace storage_lite {
         static size_t read(char *buffer, size_t size, size_t nitems, void *userdata)
         {
             REQUEST_TYPE *p = static_cast<REQUEST_TYPE *>(userdata);
+            if (p->m_throttle && p->m_throttle->upload().limited())
+            {
+                nitems = std::min(nitems, std::max<size_t>(p->m_throttle->upload().chunk_size() / size, 1));
+            }
 
             size_t actual_size = 0;
-            if (p->m_input_stream.valid())
+            if (p->m_input_buffer.valid())
             {
-                auto &s = p->m_input_stream.istream();
-                if (p->get_is_input_length_known())
+                if (!p->m_input_buffer.read(buffer, size * nitems, actual_size))
                 {
-                    actual_size = size_t(std::min(uint64_t(size * nitems), p->m_input_content_length - p->m_input_read_pos));
+                    return CURL_READFUNC_ABORT;
                 }
-                else
+            }
+            else if (p->m_input_stream.valid())
+            {
+                auto &s = p->m_input_stream.istream();
+                if (!p->get_is_input_length_known())
                 {
+                    // Measure what is left once instead of seeking to the end on every callback.
                     std::streampos cur_pos = s.tellg();
                     s.seekg(0, std::ios_base::end);
                     std::streampos end_pos = s.tellg();
                     s.seekg(cur_pos, std::ios_base::beg);
-                    actual_size = size_t(std::min(uint64_t(size * nitems), uint64_t(end_pos - cur_pos)));
+                    p->set_input_content_length(p->m_input_read_pos + uint64_t(end_pos - cur_pos));
+                    p->set_is_input_length_known();
                 }
+                actual_size = size_t(std::min(uint64_t(size * nitems), p->m_input_content_length - p->m_input_read_pos));
                 s.read(buffer, actual_size);
                 if (s.fail())
                 {
@@ -255,6 +427,10 @@ namespace azure {  namespace storage_lite {
                 p->m_input_read_pos += actual_size;
             }
 
+            if (p->m_throttle && !p->pace(p->m_throttle->upload(), actual_size))
+            {
+                return CURL_READFUNC_ABORT;
+            }
             return actual_size;
         }
 
@@ -267,62 +443,119 @@ namespace azure {  namespace storage_lite {
         }
     };
 
+    /// <summary>
+    /// A snapshot of how the handles of a <see cref="azure::storage_lite::CurlEasyClient" /> are used.
+    /// </summary>
+    struct handle_pool_metrics
+    {
+        static const int wait_buckets = 24;
+
+        int size = 0;
+        // Handles are created on first use, so a pool may hold fewer than its size.
+        int created = 0;
+        int in_use = 0;
+        int peak_in_use = 0;
+        int waiting = 0;
+        uint64_t acquisitions = 0;
+        // Acquisitions that found no handle they could take and queued for one.
+        uint64_t waits = 0;
+        // Acquisitions served from the free list of another shard.
+        uint64_t steals = 0;
+        // Bucket 0 counts acquisitions that took less than a microsecond, bucket i those that took [2^(i-1), 2^i) microseconds, the last bucket also counts longer ones.
+        std::array<uint64_t, wait_buckets> wait_histogram{};
+        // The fraction of the handle time since the pool was created that completed requests held handles for.
+        double utilization = 0.0;
+
+        /// <summary>
+        /// Gets an upper bound of the percentile of the acquisition times.
+        /// </summary>
+        AZURE_STORAGE_API std::chrono::microseconds wait_percentile(double percentile) const;
+    };
+
     class CurlEasyClient : public std::enable_shared_from_this<CurlEasyClient>
     {
+        friend class CurlEasyRequest;
+
     public:
+        // Handles are created on first use, up to size.
         CurlEasyClient(int size) : m_size(size)
         {
-            curl_global_init(CURL_GLOBAL_DEFAULT);
-            for (int i = 0; i < m_size; i++) {
-                CURL *h = curl_easy_init();
-                m_handles.push(h);
-            }
+            global_init();
+            init_handles();
         }
 
         //Sets CURL CA BUNDLE location for all the curl handlers.
         CurlEasyClient(int size, const std::string& ca_path) : m_size(size), m_capath(ca_path)
         {
-            curl_global_init(CURL_GLOBAL_DEFAULT);
-            for (int i = 0; i < m_size; i++) {
-                CURL *h = curl_easy_init();
-                m_handles.push(h);
-            }
+            global_init();
+            init_handles();
         }
 
         ~CurlEasyClient() {
-            while (!m_handles.empty())
+            for (auto &shard : m_shards)
             {
-                curl_easy_cleanup(m_handles.front());
-                m_handles.pop();
+                for (const auto &h : shard->handles)
+                {
+                    curl_easy_cleanup(h.handle);
+                }
             }
-            curl_global_cleanup();
         }
 
+        /// <summary>
+        /// Initializes libcurl for the process, once however many clients are created. The library is not cleaned up before the process exits.
+        /// </summary>
+        AZURE_STORAGE_API static void global_init();
+
         int size()
         {
             return m_size;
         }
 
-        std::shared_ptr<CurlEasyRequest> get_handle()
-        {
-            std::unique_lock<std::mutex> lk(m_handles_mutex);
-            m_cv.wait(lk, [this]() { return !m_handles.empty(); });
-            auto res = std::make_shared<CurlEasyRequest>(shared_from_this(), m_handles.front());
-            m_handles.pop();
-            return res;
-        }
+        /// <summary>
+        /// Gets a handle, waiting until one is free.
+        /// </summary>
+        /// <param name="priority">The priority of the request. Freed handles go to waiting requests by weight, interactive ones first, and requests never take the handles reserved for higher priorities.</param>
+        AZURE_STORAGE_API std::shared_ptr<CurlEasyRequest> get_handle(request_priority priority = request_priority::normal);
+
+        /// <summary>
+        /// Gets a handle if one is free for the priority and no request of the same or a higher priority is waiting, nullptr otherwise.
+        /// </summary>
+        AZURE_STORAGE_API std::shared_ptr<CurlEasyRequest> try_get_handle(request_priority priority = request_priority::normal);
+
+        /// <summary>
+        /// Keeps handles free for requests of the priority or higher, lower priorities only use the handles beyond the reserves.
+        /// </summary>
+        /// <param name="priority">The priority the handles are reserved for, reserving for bulk requests has no effect.</param>
+        /// <param name="count">The number of handles, the reserves together always leave one handle to bulk requests. Nothing is reserved by default.</param>
+        AZURE_STORAGE_API void set_reserved_handles(request_priority priority, int count);
 
         const std::string& get_capath()
         {
             return m_capath;
         }
 
-        void release_handle(CURL *h)
-        {
-            std::lock_guard<std::mutex> lg(m_handles_mutex);
-            m_handles.push(h);
-            m_cv.notify_one();
-        }
+        /// <summary>
+        /// Returns a handle to the pool.
+        /// </summary>
+        /// <param name="h">The handle.</param>
+        /// <param name="held">How long the handle was in use, counted in the utilization.</param>
+        AZURE_STORAGE_API void release_handle(CURL *h, std::chrono::steady_clock::duration held = std::chrono::steady_clock::duration::zero());
+
+        AZURE_STORAGE_API handle_pool_metrics metrics() const;
+
+        /// <summary>
+        /// Creates handles in the background and, given an endpoint, connects them to it with a HEAD request, so the first requests skip handle creation and the TCP and TLS handshakes.
+        /// </summary>
+        /// <param name="count">The number of handles to prepare, at most the size of the pool.</param>
+        /// <param name="url">A url on the endpoint, nothing is sent when empty. The response of the HEAD request is ignored.</param>
+        /// <remarks>Handles being prepared are taken as bulk requests, and prewarming stops early when none is free.</remarks>
+        AZURE_STORAGE_API void prewarm(int count, const std::string &url = std::string());
+
+        /// <summary>
+        /// Destroys the free handles unused for longer than the idle time, along with their connections. They are created again when needed.
+        /// </summary>
+        /// <returns>The number of handles destroyed.</returns>
+        AZURE_STORAGE_API int reap_idle(std::chrono::steady_clock::duration idle);
 
         void set_proxy(std::string proxy)
         {
@@ -334,13 +567,94 @@ namespace azure {  namespace storage_lite {
             return m_proxy;
         }
 
+        /// <summary>
+        /// Gets the policy deriving request timeouts from observed latency and throughput, nullptr when requests use fixed timeouts.
+        /// </summary>
+        std::shared_ptr<timeout_policy> get_timeout_policy() const
+        {
+            return std::atomic_load(&m_timeout_policy);
+        }
+
+        /// <summary>
+        /// Sets the policy, which several clients can share. Requests use their fixed timeouts until a policy is set.
+        /// </summary>
+        void set_timeout_policy(std::shared_ptr<timeout_policy> policy)
+        {
+            std::atomic_store(&m_timeout_policy, std::move(policy));
+        }
+
+        /// <summary>
+        /// Gets the throttle limiting the bodies sent and received through the handles, nullptr when transfers are not limited.
+        /// </summary>
+        std::shared_ptr<bandwidth_throttle> get_bandwidth_throttle() const
+        {
+            return std::atomic_load(&m_bandwidth_throttle);
+        }
+
+        /// <summary>
+        /// Sets the throttle, which several clients can share. Requests started before keep the throttle they started with.
+        /// </summary>
+        void set_bandwidth_throttle(std::shared_ptr<bandwidth_throttle> throttle)
+        {
+            std::atomic_store(&m_bandwidth_throttle, std::move(throttle));
+        }
+
     private:
         int m_size;
         std::string m_capath;
         std::string m_proxy;
-        std::queue<CURL *> m_handles;
-        std::mutex m_handles_mutex;
-        std::condition_variable m_cv;
+        std::shared_ptr<timeout_policy> m_timeout_policy;
+        std::shared_ptr<bandwidth_throttle> m_bandwidth_throttle;
+
+        struct free_handle
+        {
+            CURL *handle;
+            std::chrono::steady_clock::time_point released;
+        };
+
+        // Free handles are spread over one list per core, so requests on different cores rarely meet on a lock.
+        // Each list is a stack, the most recently used handles are taken first and the others age at the bottom.
+        struct shard
+        {
+            std::mutex mutex;
+            std::vector<free_handle> handles;
+            std::atomic<uint64_t> acquisitions{ 0 };
+            std::atomic<uint64_t> waits{ 0 };
+            std::atomic<uint64_t> steals{ 0 };
+            std::atomic<uint64_t> busy_microseconds{ 0 };
+            std::array<std::atomic<uint64_t>, handle_pool_metrics::wait_buckets> wait_histogram;
+        };
+        std::vector<std::unique_ptr<shard>> m_shards;
+        // Free handles not yet claimed, a request claims one here before taking it from any of the lists.
+        std::atomic<int> m_free{ 0 };
+        std::atomic<int> m_created_handles{ 0 };
+        std::atomic<int> m_peak_in_use{ 0 };
+        std::chrono::steady_clock::time_point m_created;
+
+        struct waiter
+        {
+            free_handle handle = { nullptr, std::chrono::steady_clock::time_point() };
+            bool stolen = false;
+            std::condition_variable cv;
+        };
+
+        static const int priority_count = 3;
+        // Requests waiting for a handle, one queue per priority, guarded by m_waiters_mutex.
+        std::mutex m_waiters_mutex;
+        std::array<std::deque<waiter *>, priority_count> m_waiters;
+        std::array<std::atomic<int>, priority_count> m_queued;
+        std::array<std::atomic<int>, priority_count> m_reserved_handles;
+        // Running credits of the smooth weighted round robin between the queues.
+        std::array<int, priority_count> m_credits;
+
+        AZURE_STORAGE_API void init_handles();
+        int home_shard() const;
+        bool queued_at_or_above(int priority) const;
+        bool claim(int priority);
+        free_handle pop_free(int home, bool &stolen);
+        free_handle acquire(request_priority priority);
+        void record_acquisition(bool stolen, bool waited, std::chrono::steady_clock::time_point start);
+        void dispatch();
     };
 
 }}   // azure::storage_lite
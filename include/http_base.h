@@ -4,8 +4,11 @@
 #include <functional>
 #include <string>
 #include <map>
+#include <utility>
+#include <vector>
 #include <curl/curl.h>
 
+#include "cancellation.h"
 #include "storage_stream.h"
 #include "compare.h"
 
@@ -40,8 +43,8 @@ namespace azure {  namespace storage_lite {
 
         virtual const std::map<std::string, std::string, case_insensitive_compare>& get_request_headers() const = 0;
 
-        virtual std::string get_response_header(const std::string &name) const = 0;
-        virtual const std::map<std::string, std::string, case_insensitive_compare>& get_response_headers() const = 0;
+        virtual const std::string &get_response_header(const std::string &name) const = 0;
+        virtual const std::vector<std::pair<std::string, std::string>>& get_response_headers() const = 0;
 
         virtual CURLcode perform() = 0;
 
@@ -61,12 +64,49 @@ namespace azure {  namespace storage_lite {
 
         virtual void set_error_stream(std::function<bool(http_code)> f, storage_iostream s) = 0;
 
+        /// <summary>
+        /// Sends the request body from the buffer, in place of an input stream.
+        /// </summary>
+        virtual void set_input_buffer(storage_input_buffer b) = 0;
+
+        /// <summary>
+        /// Receives the response body into the buffer, in place of an output stream.
+        /// </summary>
+        virtual void set_output_buffer(storage_output_buffer b) = 0;
+
         virtual storage_istream get_input_stream() const = 0;
 
         virtual storage_ostream get_output_stream() const = 0;
 
         virtual storage_iostream get_error_stream() const = 0;
 
+        /// <summary>
+        /// Aborts the transfer in progress, the request is not retried afterwards.
+        /// </summary>
+        virtual void cancel() = 0;
+
+        /// <summary>
+        /// Gets whether the request was cancelled, directly or through its cancellation token.
+        /// </summary>
+        virtual bool is_cancelled() const = 0;
+
+        /// <summary>
+        /// Attaches a token that cancels the request, a deadline on the token also bounds each attempt.
+        /// </summary>
+        virtual void set_cancellation_token(cancellation_token token) = 0;
+
+        virtual const cancellation_token &get_cancellation_token() const = 0;
+
+        /// <summary>
+        /// Gives the connection back while the request waits before an attempt, e.g. for its rate limit. Nothing may be set on the request until it is resumed.
+        /// </summary>
+        virtual void suspend() {}
+
+        /// <summary>
+        /// Takes a connection again for a suspended request, keeping everything set on it.
+        /// </summary>
+        virtual void resume() {}
+
         virtual void set_absolute_timeout(long long timeout) = 0;
 
         virtual void set_data_rate_timeout() = 0;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "storage_EXPORTS.h"
+
+#include "http/libcurl_http_client.h"
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Looks after the connections of a <see cref="azure::storage_lite::CurlEasyClient" /> from a background thread.
+    /// It keeps a minimum of handles connected to an endpoint with HEAD requests while the pool is quiet, and destroys
+    /// handles idle for so long that the service would have closed their connections.
+    /// </summary>
+    class pool_manager final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::pool_manager" /> class and starts its thread.
+        /// </summary>
+        /// <param name="client">The pool.</param>
+        /// <param name="url">A url on the endpoint the connections are kept to, the responses of the HEAD requests are ignored.</param>
+        /// <param name="min_warm">The number of handles kept connected.</param>
+        /// <param name="keepalive_interval">How long a handle kept connected may stay unused before it is sent a HEAD request.</param>
+        /// <param name="idle_timeout">How long other free handles are kept, it should stay below the idle timeout of the service and of any proxy in between.</param>
+        AZURE_STORAGE_API pool_manager(std::shared_ptr<CurlEasyClient> client, std::string url, int min_warm = 2,
+            std::chrono::seconds keepalive_interval = std::chrono::seconds(30), std::chrono::seconds idle_timeout = std::chrono::seconds(100));
+
+        /// <summary>
+        /// Stops the thread, the pool keeps its handles.
+        /// </summary>
+        AZURE_STORAGE_API ~pool_manager();
+
+        pool_manager(const pool_manager &) = delete;
+        pool_manager &operator=(const pool_manager &) = delete;
+
+        /// <summary>
+        /// Connects handles ahead of a burst of requests, so the burst does not pay for the handshakes.
+        /// </summary>
+        /// <param name="count">The number of requests expected at once.</param>
+        AZURE_STORAGE_API void announce_burst(int count);
+
+        /// <summary>
+        /// Sends HEAD requests on the handles kept connected that have been unused for the keepalive interval, then destroys the handles idle beyond the idle timeout.
+        /// The thread does this every half keepalive interval.
+        /// </summary>
+        AZURE_STORAGE_API void maintain();
+
+    private:
+        void run();
+
+        std::shared_ptr<CurlEasyClient> m_client;
+        std::string m_url;
+        int m_min_warm;
+        std::chrono::seconds m_keepalive_interval;
+        std::chrono::seconds m_idle_timeout;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stopped;
+        std::thread m_thread;
+    };
+
+}}  // azure::storage_lite
@@ -29,6 +29,7 @@ namespace azure {  namespace storage_lite {
         virtual std::string content_language() const { return std::string(); }
         virtual unsigned int content_length() const = 0;
         virtual std::string content_md5() const { return std::string(); }
+        virtual std::string content_crc64() const { return std::string(); }
         virtual std::string content_type() const { return std::string(); }
 
         virtual std::string origin() const { return std::string(); }
@@ -32,6 +32,7 @@ namespace azure {  namespace storage_lite {
 
         virtual unsigned int content_length() const = 0;
         virtual std::string content_md5() const { return std::string(); }
+        virtual std::string content_crc64() const { return std::string(); }
 
         AZURE_STORAGE_API void build_request(const storage_account &a, http_base &h) const override;
     };
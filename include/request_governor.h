@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    class storage_account;
+
+    /// <summary>
+    /// Paces requests to stay under a rate for the whole account and another for each container, so sustained bulk
+    /// operations run just below the throttling limits of the service instead of bouncing off them.
+    /// Requests are spaced evenly with the generic cell rate algorithm, a short burst is allowed after a quiet period.
+    /// </summary>
+    class request_governor final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::request_governor" /> class.
+        /// </summary>
+        /// <param name="requests_per_second">The rate of all requests, 0 for no limit.</param>
+        /// <param name="container_requests_per_second">The rate of the requests to each container, 0 for no limit.</param>
+        /// <param name="burst">How far ahead of their even spacing requests may run after a quiet period.</param>
+        AZURE_STORAGE_API explicit request_governor(double requests_per_second = 0, double container_requests_per_second = 0,
+            std::chrono::milliseconds burst = std::chrono::milliseconds(100));
+
+        /// <summary>
+        /// Changes the rate of all requests, 0 for no limit.
+        /// </summary>
+        AZURE_STORAGE_API void set_rate(double requests_per_second);
+
+        /// <summary>
+        /// Changes the rate of the requests to each container, 0 for no limit.
+        /// </summary>
+        AZURE_STORAGE_API void set_container_rate(double requests_per_second);
+
+        /// <summary>
+        /// Reserves the next slot of a request.
+        /// </summary>
+        /// <param name="container">The container the request is sent to, empty for account-level requests.</param>
+        /// <returns>How long the request waits for its slot.</returns>
+        AZURE_STORAGE_API std::chrono::nanoseconds reserve(const std::string &container);
+
+        /// <summary>
+        /// Reserves the next slot of a request and waits for it.
+        /// </summary>
+        /// <param name="container">The container the request is sent to, empty for account-level requests.</param>
+        /// <param name="cancelled">Polled while waiting, the wait ends when it returns true.</param>
+        /// <returns>false if the wait was cancelled.</returns>
+        AZURE_STORAGE_API bool wait(const std::string &container, const std::function<bool()> &cancelled);
+
+        /// <summary>
+        /// Waits out the delay of a slot reserved earlier.
+        /// </summary>
+        /// <param name="delay">The delay returned by reserve.</param>
+        /// <param name="cancelled">Polled while waiting, the wait ends when it returns true.</param>
+        /// <returns>false if the wait was cancelled.</returns>
+        AZURE_STORAGE_API static bool wait_for(std::chrono::nanoseconds delay, const std::function<bool()> &cancelled);
+
+        /// <summary>
+        /// Gets the container a request url of the account points to, empty for account-level requests.
+        /// </summary>
+        AZURE_STORAGE_API static std::string container_of(const storage_account &account, const std::string &url);
+
+    private:
+        class limiter
+        {
+        public:
+            limiter() : m_tat(0) {}
+
+            // Takes the next slot, returning when it starts in nanoseconds of the steady clock.
+            int64_t reserve(int64_t now, int64_t interval, int64_t tolerance);
+
+            bool idle(int64_t now) const
+            {
+                return m_tat <= now;
+            }
+
+        private:
+            // The theoretical arrival time of the next request.
+            std::atomic<int64_t> m_tat;
+        };
+
+        std::atomic<int64_t> m_interval;
+        std::atomic<int64_t> m_container_interval;
+        int64_t m_tolerance;
+
+        limiter m_account;
+        std::mutex m_containers_mutex;
+        std::unordered_map<std::string, std::unique_ptr<limiter>> m_containers;
+    };
+
+}}  // azure::storage_lite
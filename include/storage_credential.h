@@ -1,11 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <mutex>
 
 #include "storage_EXPORTS.h"
 
+#include "hash.h"
 #include "http_base.h"
 #include "storage_request_base.h"
 #include "storage_url.h"
@@ -23,6 +30,42 @@ namespace azure {  namespace storage_lite {
         }
     };
 
+    /// <summary>
+    /// The common fields of a shared access signature.
+    /// </summary>
+    struct shared_access_signature_parameters
+    {
+        /// <summary>
+        /// The permissions granted, such as "racwdl", in the order the service expects.
+        /// </summary>
+        std::string permissions;
+
+        /// <summary>
+        /// The time the signature becomes valid, the epoch leaves it valid immediately.
+        /// </summary>
+        std::chrono::system_clock::time_point starts_on;
+
+        /// <summary>
+        /// The time the signature expires.
+        /// </summary>
+        std::chrono::system_clock::time_point expires_on;
+
+        /// <summary>
+        /// An optional IP address or range allowed to use the signature.
+        /// </summary>
+        std::string ip_range;
+
+        /// <summary>
+        /// The optional protocols allowed, "https" or "https,http".
+        /// </summary>
+        std::string protocol;
+
+        /// <summary>
+        /// An optional stored access policy on the container.
+        /// </summary>
+        std::string identifier;
+    };
+
     class shared_key_credential final : public storage_credential
     {
     public:
@@ -34,6 +77,24 @@ namespace azure {  namespace storage_lite {
 
         AZURE_STORAGE_API void sign_request(const table_request_base &r, http_base &h, const storage_url &url, const storage_headers &headers) const;
 
+        /// <summary>
+        /// Generates a service shared access signature for a container or a blob in it.
+        /// </summary>
+        /// <param name="container">The container name.</param>
+        /// <param name="blob">The blob name, empty for a signature covering the whole container.</param>
+        /// <param name="parameters">The permissions, validity and restrictions of the signature.</param>
+        /// <returns>The SAS token, without a leading question mark.</returns>
+        AZURE_STORAGE_API std::string generate_blob_sas(const std::string &container, const std::string &blob, const shared_access_signature_parameters &parameters) const;
+
+        /// <summary>
+        /// Generates an account shared access signature.
+        /// </summary>
+        /// <param name="services">The services covered, "b" for the blob service.</param>
+        /// <param name="resource_types">The resource types covered, any of "s" for the service, "c" for containers and "o" for objects.</param>
+        /// <param name="parameters">The permissions, validity and restrictions of the signature.</param>
+        /// <returns>The SAS token, without a leading question mark.</returns>
+        AZURE_STORAGE_API std::string generate_account_sas(const std::string &services, const std::string &resource_types, const shared_access_signature_parameters &parameters) const;
+
         const std::string &account_name() const
         {
             return m_account_name;
@@ -47,6 +108,7 @@ namespace azure {  namespace storage_lite {
     private:
         std::string m_account_name;
         std::vector<unsigned char> m_account_key;
+        hmac_sha256_signer m_signer;
     };
 
     class shared_access_signature_credential final : public storage_credential
@@ -69,22 +131,122 @@ namespace azure {  namespace storage_lite {
         std::string m_sas_token;
     };
 
+    /// <summary>
+    /// Options controlling the signatures minted by a <see cref="azure::storage_lite::rotating_sas_credential" />.
+    /// </summary>
+    struct rotating_sas_credential_options
+    {
+        /// <summary>
+        /// The permissions of the signatures scoped to a container, used for requests on blobs.
+        /// </summary>
+        std::string container_permissions = "racwdl";
+
+        /// <summary>
+        /// The permissions of the account signature, used for requests on containers and the service.
+        /// </summary>
+        std::string account_permissions = "rwdlac";
+
+        /// <summary>
+        /// How long each signature is valid.
+        /// </summary>
+        std::chrono::seconds validity = std::chrono::hours(1);
+
+        /// <summary>
+        /// How long before its expiry a signature is replaced.
+        /// </summary>
+        std::chrono::seconds refresh_margin = std::chrono::minutes(5);
+
+        /// <summary>
+        /// How far the start of each signature is backdated, to tolerate clock differences with the service.
+        /// </summary>
+        std::chrono::seconds clock_skew = std::chrono::minutes(5);
+    };
+
+    /// <summary>
+    /// Authorizes requests with shared access signatures minted locally from an account key.
+    /// </summary>
+    /// <remarks>
+    /// Requests on blobs use a signature scoped to their container, requests on containers and the service use an account signature.
+    /// Each signature is computed once and reused until it nears its expiry, so a request costs a cache lookup instead of an HMAC.
+    /// </remarks>
+    class rotating_sas_credential final : public storage_credential
+    {
+    public:
+        AZURE_STORAGE_API explicit rotating_sas_credential(std::shared_ptr<shared_key_credential> key, const rotating_sas_credential_options &options = rotating_sas_credential_options());
+
+        AZURE_STORAGE_API void sign_request(const storage_request_base &r, http_base &h, const storage_url &url, const storage_headers &headers) const override;
+        AZURE_STORAGE_API std::string transform_url(std::string url) const override;
+
+    private:
+        struct cached_token
+        {
+            std::string token;
+            std::chrono::system_clock::time_point refresh_on;
+        };
+
+        // Gets the signature for a container, an empty container stands for the account signature.
+        std::string get_token(const std::string &container) const;
+
+        std::shared_ptr<shared_key_credential> m_key;
+        rotating_sas_credential_options m_options;
+        mutable std::mutex m_tokens_mutex;
+        mutable std::map<std::string, cached_token> m_tokens;
+    };
+
     class anonymous_credential final : public storage_credential
     {
     public:
         void sign_request(const storage_request_base &, http_base &, const storage_url &, const storage_headers &) const override {}
     };
 
+    /// <summary>
+    /// A bearer token and the time it expires.
+    /// </summary>
+    struct access_token
+    {
+        std::string token;
+        std::chrono::system_clock::time_point expires_on;
+    };
+
     class token_credential : public storage_credential {
     public:
         AZURE_STORAGE_API token_credential(const std::string &token);
 
+        /// <summary>
+        /// Initializes a token credential that renews its token on a background thread ahead of expiry.
+        /// </summary>
+        /// <param name="provider">Gets a new token, called once here and then before each token expires. Failures are signalled by throwing or returning an empty token and are retried.</param>
+        /// <param name="refresh_margin">How long before expiry a token is renewed.</param>
+        AZURE_STORAGE_API token_credential(std::function<access_token()> provider, std::chrono::seconds refresh_margin = std::chrono::minutes(5));
+
+        AZURE_STORAGE_API ~token_credential();
+
         void sign_request(const storage_request_base &, http_base &, const storage_url &, const storage_headers &) const override;
 
         void set_token(const std::string& token);
 
+        /// <summary>
+        /// Renews the token from the provider on the calling thread instead of waiting for the scheduled renewal.
+        /// </summary>
+        /// <returns>True if a new token is in use, false if there is no provider or it failed, in which case the current token is kept and the renewal is retried.</returns>
+        AZURE_STORAGE_API bool refresh_now();
+
     private:
-        std::string m_token;
-        mutable std::mutex m_token_mutex;
+        void refresh();
+        std::chrono::system_clock::time_point next_refresh(std::chrono::system_clock::time_point expires_on) const;
+
+        // Replaced as a whole, so signing only loads a pointer and never waits for a writer.
+        std::shared_ptr<const std::string> m_token;
+
+        std::function<access_token()> m_provider;
+        std::chrono::seconds m_refresh_margin;
+        std::mutex m_provider_mutex;
+        std::mutex m_refresh_mutex;
+        std::condition_variable m_refresh_cv;
+        // Guarded by m_refresh_mutex.
+        std::chrono::system_clock::time_point m_expires_on;
+        std::chrono::system_clock::time_point m_refresh_on;
+        bool m_stopping;
+        std::thread m_refresher;
     };
 }}
@@ -1,6 +1,9 @@
 #pragma once
 /* common errors*/
 const int invalid_parameters = 1200;
+const int operation_cancelled = 1201;
+const int operation_timed_out = 1202;
+const int circuit_open = 1203;
 /* client level*/
 const int client_init_fail = 1300;
 const int client_already_init = 1301;
@@ -20,5 +23,9 @@ const int blob_list_fail = 1504;
 const int blob_copy_fail = 1505;
 const int blob_no_content_range = 1506;
 const int blob_too_big = 1507;
+const int blob_append_position_mismatch = 1508;
+const int blob_writer_closed = 1509;
+const int blob_checksum_mismatch = 1510;
+const int blob_checksum_missing = 1511;
 /* unknown error*/
 const int unknown_error = 1600;
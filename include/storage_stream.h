@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "storage_EXPORTS.h"
 
@@ -90,4 +93,120 @@ namespace azure {  namespace storage_lite {
         std::shared_ptr<std::iostream> m_stream;
     };
 
+    /// <summary>
+    /// A request body taken directly from memory or from a range of a file, without going through an iostream.
+    /// The memory must stay valid and unchanged until the request completes.
+    /// </summary>
+    class storage_input_buffer
+    {
+    public:
+        storage_input_buffer() {}
+
+        storage_input_buffer(const char *data, size_t length) : m_segments{ { data, length } }, m_size(length), m_valid(true) {}
+
+        /// <summary>
+        /// Sends the segments one after another, as a scatter/gather list.
+        /// </summary>
+        AZURE_STORAGE_API explicit storage_input_buffer(std::vector<std::pair<const char *, size_t>> segments);
+
+        /// <summary>
+        /// Reads length bytes of the open file descriptor starting at offset. The file position is left untouched, so one descriptor can feed concurrent requests.
+        /// </summary>
+        AZURE_STORAGE_API static storage_input_buffer from_file(int fd, uint64_t offset, uint64_t length);
+
+        /// <summary>
+        /// Copies the next bytes into buffer and returns how many were copied, 0 at the end of the body. Returns false if the file could not be read.
+        /// </summary>
+        AZURE_STORAGE_API bool read(char *buffer, size_t capacity, size_t &copied);
+
+        void reset()
+        {
+            m_position = 0;
+            m_segment = 0;
+            m_segment_offset = 0;
+        }
+
+        uint64_t size() const
+        {
+            return m_size;
+        }
+
+        bool valid() const
+        {
+            return m_valid;
+        }
+
+    private:
+        std::vector<std::pair<const char *, size_t>> m_segments;
+        int m_fd = -1;
+        uint64_t m_file_offset = 0;
+        uint64_t m_size = 0;
+        uint64_t m_position = 0;
+        size_t m_segment = 0;
+        size_t m_segment_offset = 0;
+        bool m_valid = false;
+    };
+
+    /// <summary>
+    /// A response body written directly into memory or into a range of a file, without going through an iostream.
+    /// Writing more than the buffer holds fails the transfer.
+    /// </summary>
+    class storage_output_buffer
+    {
+    public:
+        storage_output_buffer() {}
+
+        storage_output_buffer(char *data, size_t length) : m_segments{ { data, length } }, m_size(length), m_valid(true) {}
+
+        /// <summary>
+        /// Fills the segments one after another, as a scatter/gather list.
+        /// </summary>
+        AZURE_STORAGE_API explicit storage_output_buffer(std::vector<std::pair<char *, size_t>> segments);
+
+        /// <summary>
+        /// Writes at most length bytes to the open file descriptor starting at offset. The file position is left untouched.
+        /// </summary>
+        AZURE_STORAGE_API static storage_output_buffer from_file(int fd, uint64_t offset, uint64_t length);
+
+        /// <summary>
+        /// Appends the data, returning false if it does not fit or the file could not be written.
+        /// </summary>
+        AZURE_STORAGE_API bool write(const char *data, size_t length);
+
+        void reset()
+        {
+            m_position = 0;
+            m_segment = 0;
+            m_segment_offset = 0;
+        }
+
+        uint64_t size() const
+        {
+            return m_size;
+        }
+
+        /// <summary>
+        /// Gets the number of bytes written since the last reset.
+        /// </summary>
+        uint64_t written() const
+        {
+            return m_position;
+        }
+
+        bool valid() const
+        {
+            return m_valid;
+        }
+
+    private:
+        std::vector<std::pair<char *, size_t>> m_segments;
+        int m_fd = -1;
+        uint64_t m_file_offset = 0;
+        uint64_t m_size = 0;
+        uint64_t m_position = 0;
+        size_t m_segment = 0;
+        size_t m_segment_offset = 0;
+        bool m_valid = false;
+    };
+
 }}  // azure::storage_lite
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <map>
-#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "storage_EXPORTS.h"
 
@@ -37,11 +39,20 @@ namespace azure {  namespace storage_lite {
 
         storage_url &add_query(const std::string &name, const std::string &value)
         {
-            m_query[name].insert(value);
+            // The query stays sorted by name and value, without duplicates.
+            auto entry = std::make_pair(name, value);
+            auto iter = std::lower_bound(m_query.begin(), m_query.end(), entry);
+            if (iter == m_query.end() || *iter != entry)
+            {
+                m_query.insert(iter, std::move(entry));
+            }
             return *this;
         }
 
-        const std::map<std::string, std::set<std::string>> &get_query() const
+        /// <summary>
+        /// Gets the query parameters ordered by name and value, a name with several values appears once per value.
+        /// </summary>
+        const std::vector<std::pair<std::string, std::string>> &get_query() const
         {
             return m_query;
         }
@@ -51,7 +62,7 @@ namespace azure {  namespace storage_lite {
     private:
         std::string m_domain;
         std::string m_path;
-        std::map<std::string, std::set<std::string>> m_query;
+        std::vector<std::pair<std::string, std::string>> m_query;
     };
 
     class storage_headers
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage_EXPORTS.h"
+
+namespace azure {  namespace storage_lite {
+
+    /// <summary>
+    /// Derives the timeouts of requests from the latency and throughput observed on the requests that completed before them.
+    /// Until enough requests completed, the fixed timeouts the requests ask for are used. A client only uses a policy it is given.
+    /// </summary>
+    class timeout_policy final
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="azure::storage_lite::timeout_policy" /> class.
+        /// </summary>
+        /// <param name="latency_multiplier">How many times the 99th percentile latency a request may take.</param>
+        /// <param name="throughput_fraction">The fraction of the 10th percentile throughput a transfer must sustain.</param>
+        /// <param name="min_timeout">The shortest timeout given to a request.</param>
+        /// <param name="max_timeout">The longest timeout given to a request that does not transfer a body.</param>
+        AZURE_STORAGE_API explicit timeout_policy(double latency_multiplier = 4.0, double throughput_fraction = 0.25,
+            std::chrono::milliseconds min_timeout = std::chrono::milliseconds(1000), std::chrono::milliseconds max_timeout = std::chrono::milliseconds(300000));
+
+        /// <summary>
+        /// Gets the timeout of a request bounded by a fixed timeout.
+        /// </summary>
+        /// <param name="operation">The kind of request, such as the method and the comp query parameter. Requests of the same kind share their latency statistics.</param>
+        /// <param name="hint">The fixed timeout the request asks for, in seconds.</param>
+        /// <param name="bytes">The size of the body the request sends or asks for, its transfer time at the observed throughput is added to the timeout.</param>
+        AZURE_STORAGE_API std::chrono::milliseconds request_timeout(const std::string &operation, long long hint, uint64_t bytes = 0) const;
+
+        /// <summary>
+        /// Gets how long a transfer may go without progress before it is considered stuck.
+        /// </summary>
+        AZURE_STORAGE_API std::chrono::seconds stall_timeout() const;
+
+        /// <summary>
+        /// Gets the timeout of a transfer of the given size, zero when the transfer is only bounded by the stall timeout.
+        /// </summary>
+        AZURE_STORAGE_API std::chrono::milliseconds transfer_timeout(uint64_t bytes) const;
+
+        AZURE_STORAGE_API void record_request(const std::string &operation, std::chrono::microseconds latency);
+
+        /// <summary>
+        /// Records a completed transfer, first_byte is zero when it is not known.
+        /// </summary>
+        AZURE_STORAGE_API void record_transfer(uint64_t bytes, std::chrono::microseconds first_byte, std::chrono::microseconds total);
+
+    private:
+        class window
+        {
+        public:
+            void add(int64_t sample);
+            size_t size() const
+            {
+                return m_samples.size();
+            }
+            int64_t percentile(double p) const;
+
+        private:
+            std::vector<int64_t> m_samples;
+            size_t m_next = 0;
+        };
+
+        double m_latency_multiplier;
+        double m_throughput_fraction;
+        std::chrono::milliseconds m_min_timeout;
+        std::chrono::milliseconds m_max_timeout;
+
+        // Bytes per second a healthy transfer is expected to sustain, 0 until enough transfers completed. Called with m_mutex held.
+        double expected_throughput() const;
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, window> m_latencies;
+        window m_first_byte;
+        window m_throughput;
+    };
+
+}}  // azure::storage_lite
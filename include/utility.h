@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <ctime>
 #include <limits>
 
 #include "storage_EXPORTS.h"
@@ -21,6 +22,8 @@ namespace azure {  namespace storage_lite {
 
     AZURE_STORAGE_API std::string get_ms_date(date_format format);
 
+    AZURE_STORAGE_API std::string get_ms_date(date_format format, std::time_t time);
+
     AZURE_STORAGE_API std::string get_ms_range(unsigned long long start_byte, unsigned long long end_byte);
 
     AZURE_STORAGE_API std::string get_http_verb(http_base::http_method method);
@@ -125,6 +128,9 @@ namespace azure {  namespace storage_lite {
     AZURE_STORAGE_API std::string encode_url_path(const std::string& path);
     AZURE_STORAGE_API std::string encode_url_query(const std::string& query);
 
+    AZURE_STORAGE_API void append_encoded_url_path(std::string &result, const std::string &path);
+    AZURE_STORAGE_API void append_encoded_url_query(std::string &result, const std::string &query);
+
     AZURE_STORAGE_API std::string to_lowercase(std::string str);
 
     AZURE_STORAGE_API std::string get_uuid();
@@ -8,6 +8,7 @@
 #include "list_blobs_request_base.h"
 #include "get_block_list_request_base.h"
 #include "get_page_ranges_request_base.h"
+#include "blob_batch_request_base.h"
 
 namespace azure {  namespace storage_lite {
 
@@ -62,4 +63,11 @@ namespace azure {  namespace storage_lite {
         return parse_get_page_ranges_response(xml);
     }
 
+    // A batch response is multipart rather than xml, it comes through the same parser as the other response bodies.
+    template<>
+    inline blob_batch_response xml_parser_base::parse_response<blob_batch_response>(const std::string &body) const
+    {
+        return parse_blob_batch_response(body);
+    }
+
 }}   // azure::storage_lite
@@ -27,6 +27,7 @@ namespace azure {  namespace storage_lite {
 
         add_ms_header(h, headers, constants::header_ms_client_request_id, r.ms_client_request_id(), true);
         add_ms_header(h, headers, constants::header_ms_lease_id, r.ms_lease_id(), true);
+        add_ms_header(h, headers, constants::header_ms_content_crc64, r.content_crc64(), true);
 
         add_ms_header(h, headers, constants::header_ms_blob_condition_maxsize, r.ms_blob_condition_maxsize(), true);
         add_ms_header(h, headers, constants::header_ms_blob_condition_appendpos, r.ms_blob_condition_appendpos(), true);
@@ -0,0 +1,57 @@
+#include "bandwidth_throttle.h"
+
+#include <algorithm>
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    const size_t min_chunk_size = 4 * 1024;
+    const size_t max_chunk_size = 512 * 1024;
+
+} // noname namespace
+
+    token_bucket::token_bucket(uint64_t bytes_per_second, uint64_t burst_bytes)
+        : m_rate(0),
+        m_burst(0.0),
+        m_tokens(0.0),
+        m_last_refill(std::chrono::steady_clock::now())
+    {
+        set_rate(bytes_per_second, burst_bytes);
+    }
+
+    void token_bucket::set_rate(uint64_t bytes_per_second, uint64_t burst_bytes)
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        m_rate = bytes_per_second;
+        m_burst = static_cast<double>(burst_bytes > 0 ? burst_bytes : bytes_per_second / 10);
+        // A new budget starts full, any debt from the old one is kept.
+        m_tokens = m_tokens < 0.0 ? m_tokens : m_burst;
+        m_last_refill = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::microseconds token_bucket::take(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        const uint64_t rate = m_rate;
+        if (rate == 0)
+        {
+            return std::chrono::microseconds(0);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(now - m_last_refill).count();
+        m_last_refill = now;
+        m_tokens = std::min(m_burst, m_tokens + elapsed * rate) - static_cast<double>(bytes);
+        if (m_tokens >= 0.0)
+        {
+            return std::chrono::microseconds(0);
+        }
+        return std::chrono::microseconds(static_cast<int64_t>(-m_tokens * 1000000.0 / rate));
+    }
+
+    size_t token_bucket::chunk_size() const
+    {
+        return static_cast<size_t>(std::min<uint64_t>(std::max<uint64_t>(m_rate / 10, min_chunk_size), max_chunk_size));
+    }
+
+}}  // azure::storage_lite
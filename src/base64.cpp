@@ -4,233 +4,376 @@
 
 #include "base64.h"
 
-namespace {
-    bool is_ascii(char c)
-    {
-        return static_cast<signed char>(c) >= 0;
-    }
-}
+#if defined(__x86_64__) || defined(_M_X64)
+#define AZURE_STORAGE_BASE64_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 namespace azure {  namespace storage_lite {
 
-    static const char* _base64_enctbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+namespace {
 
-    const std::array<unsigned char, 128> _base64_dectbl =
-    { { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
-    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
-    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63,
-    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 254, 255, 255,
-    255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
-    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,
-    255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255 } };
+    const char* _base64_enctbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-    struct _triple_byte
+    // 255 marks an invalid character, 254 the padding character.
+    const std::array<unsigned char, 256> _base64_dectbl = []()
     {
-        unsigned char _1_1 : 2;
-        unsigned char _0 : 6;
-        unsigned char _2_1 : 4;
-        unsigned char _1_2 : 4;
-        unsigned char _3 : 6;
-        unsigned char _2_2 : 2;
-    };
+        std::array<unsigned char, 256> table;
+        table.fill(255);
+        for (unsigned char i = 0; i < 64; ++i)
+        {
+            table[static_cast<unsigned char>(_base64_enctbl[i])] = i;
+        }
+        table[static_cast<unsigned char>('=')] = 254;
+        return table;
+    }();
 
-    std::string to_base64(const std::vector<unsigned char> &input)
+    // Encodes as many whole groups as the vector path handles, returns the number of input bytes consumed.
+    using encode_function = size_t(*)(const unsigned char* input, size_t size, char* output);
+    // Decodes whole groups while they are valid, stopping short of the last 4 characters. Returns the number of characters consumed.
+    using decode_function = size_t(*)(const char* input, size_t size, unsigned char* output, size_t output_size);
+
+    size_t encode_none(const unsigned char*, size_t, char*)
     {
-        return to_base64(input.data(), input.size());
+        return 0;
     }
 
-    std::string to_base64(const unsigned char* input, size_t size)
+    size_t decode_none(const char*, size_t, unsigned char*, size_t)
     {
-        auto ptr = input;
+        return 0;
+    }
+
+#ifdef AZURE_STORAGE_BASE64_SIMD
+#if defined(__GNUC__) || defined(__clang__)
+#define AZURE_STORAGE_TARGET_SSE4 __attribute__((target("ssse3,sse4.1")))
+#define AZURE_STORAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AZURE_STORAGE_TARGET_SSE4
+#define AZURE_STORAGE_TARGET_AVX2
+#endif
 
-        std::string result;
-        result.reserve((size / 3 + 1) * 4);
+    // The vector code follows the pshufb based base64 algorithms of Wojciech Mula and Daniel Lemire.
 
-        for (; size >= 3;)
+    AZURE_STORAGE_TARGET_SSE4 inline __m128i encode_lookup(__m128i indices)
+    {
+        const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+        return _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+    }
+
+    AZURE_STORAGE_TARGET_SSE4 size_t encode_sse4(const unsigned char* input, size_t size, char* output)
+    {
+        const __m128i reshuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        size_t consumed = 0;
+        // Each step reads 16 bytes and encodes the first 12.
+        while (size - consumed >= 16)
         {
-            const _triple_byte* record = reinterpret_cast<const _triple_byte*>(ptr);
-            unsigned char idx0 = record->_0;
-            unsigned char idx1 = (record->_1_1 << 4) | record->_1_2;
-            unsigned char idx2 = (record->_2_1 << 2) | record->_2_2;
-            unsigned char idx3 = record->_3;
-            result.push_back(char(_base64_enctbl[idx0]));
-            result.push_back(char(_base64_enctbl[idx1]));
-            result.push_back(char(_base64_enctbl[idx2]));
-            result.push_back(char(_base64_enctbl[idx3]));
-            size -= 3;
-            ptr += 3;
+            __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + consumed)), reshuffle);
+            const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+            const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output), encode_lookup(_mm_or_si128(t0, t1)));
+            consumed += 12;
+            output += 16;
         }
+        return consumed;
+    }
 
-        switch (size)
+    AZURE_STORAGE_TARGET_SSE4 size_t decode_sse4(const char* input, size_t size, unsigned char* output, size_t output_size)
+    {
+        const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i mask_2f = _mm_set1_epi8(0x2f);
+        const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+        size_t consumed = 0;
+        size_t produced = 0;
+        // The last 4 characters may hold padding and are left to the scalar code, stores write 16 bytes for 12.
+        while (consumed + 16 + 4 <= size && produced + 16 <= output_size)
         {
-        case 1: {
-            const _triple_byte* record = reinterpret_cast<const _triple_byte*>(ptr);
-            unsigned char idx0 = record->_0;
-            unsigned char idx1 = (record->_1_1 << 4);
-            result.push_back(char(_base64_enctbl[idx0]));
-            result.push_back(char(_base64_enctbl[idx1]));
-            result.push_back('=');
-            result.push_back('=');
-            break;
+            const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + consumed));
+            const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+            const __m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(in, mask_2f));
+            const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+            if (!_mm_testz_si128(lo, hi))
+            {
+                break;
+            }
+            const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles));
+            const __m128i values = _mm_add_epi8(in, roll);
+            const __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + produced), _mm_shuffle_epi8(merged, pack));
+            consumed += 16;
+            produced += 12;
         }
-        case 2:
+        return consumed;
+    }
+
+    AZURE_STORAGE_TARGET_AVX2 size_t encode_avx2(const unsigned char* input, size_t size, char* output)
+    {
+        const __m256i reshuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        size_t consumed = 0;
+        // Each step encodes 24 bytes, 12 per lane, reading up to 28.
+        while (size - consumed >= 28)
         {
-            const _triple_byte* record = reinterpret_cast<const _triple_byte*>(ptr);
-            unsigned char idx0 = record->_0;
-            unsigned char idx1 = (record->_1_1 << 4) | record->_1_2;
-            unsigned char idx2 = (record->_2_1 << 2);
-            result.push_back(char(_base64_enctbl[idx0]));
-            result.push_back(char(_base64_enctbl[idx1]));
-            result.push_back(char(_base64_enctbl[idx2]));
-            result.push_back('=');
-            break;
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + consumed));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + consumed + 12));
+            __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), reshuffle);
+            const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+            const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+            const __m256i indices = _mm256_or_si256(t0, t1);
+
+            __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+            result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+            result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result), indices);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), result);
+            consumed += 24;
+            output += 32;
         }
+        return consumed + encode_sse4(input + consumed, size - consumed, output);
+    }
+
+    AZURE_STORAGE_TARGET_AVX2 size_t decode_avx2(const char* input, size_t size, unsigned char* output, size_t output_size)
+    {
+        const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+        const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+        size_t consumed = 0;
+        size_t produced = 0;
+        while (consumed + 32 + 4 <= size && produced + 32 <= output_size)
+        {
+            const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + consumed));
+            const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+            const __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(in, mask_2f));
+            const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+            if (!_mm256_testz_si256(lo, hi))
+            {
+                break;
+            }
+            const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask_2f), hi_nibbles));
+            const __m256i values = _mm256_add_epi8(in, roll);
+            const __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack), compact);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + produced), packed);
+            consumed += 32;
+            produced += 24;
         }
+        return consumed + decode_sse4(input + consumed, size - consumed, output + produced, output_size - produced);
+    }
 
-        return result;
+    bool cpu_supports(bool avx2)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return avx2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+#else
+        int info[4];
+        if (avx2)
+        {
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0 && (info[2] & (1 << 19)) != 0;
+#endif
     }
+#endif
 
-    std::vector<unsigned char> from_base64(const std::string &input)
+    encode_function select_encode()
     {
-        std::vector<unsigned char> result;
+#ifdef AZURE_STORAGE_BASE64_SIMD
+        if (cpu_supports(true))
+        {
+            return encode_avx2;
+        }
+        if (cpu_supports(false))
+        {
+            return encode_sse4;
+        }
+#endif
+        return encode_none;
+    }
 
-        if (input.empty())
-            return result;
+    decode_function select_decode()
+    {
+#ifdef AZURE_STORAGE_BASE64_SIMD
+        if (cpu_supports(true))
+        {
+            return decode_avx2;
+        }
+        if (cpu_supports(false))
+        {
+            return decode_sse4;
+        }
+#endif
+        return decode_none;
+    }
 
-        size_t padding = 0;
+    unsigned char decode_char(char c)
+    {
+        return _base64_dectbl[static_cast<unsigned char>(c)];
+    }
 
-        // Validation
+    // Checks a group of four characters in order, so the first offending character decides the error.
+    void validate_group(const char* ptr, size_t remaining)
+    {
+        for (size_t i = 0; i < 4; ++i, --remaining)
         {
-            auto size = input.size();
-
-            if ((size % 4) != 0)
+            const unsigned char val = decode_char(ptr[i]);
+            if (val == 255)
             {
-                throw std::runtime_error("length of base64 string is not an even multiple of 4");
+                throw std::runtime_error("invalid character found in base64 string");
             }
-
-            for (auto iter = input.begin(); iter != input.end(); ++iter, --size)
+            // padding only at the end
+            if (val == 254 && (remaining > 2 || (remaining == 2 && decode_char(ptr[i + 1]) != 254)))
             {
-                const auto ch = *iter;
-                if (!is_ascii(ch))
-                {
-                    throw std::runtime_error("invalid character found in base64 string");
-                }
-                const size_t ch_sz = static_cast<size_t>(ch);
-                if (ch_sz >= _base64_dectbl.size() || _base64_dectbl[ch_sz] == 255)
-                {
-                    throw std::runtime_error("invalid character found in base64 string");
-                }
-                if (_base64_dectbl[ch_sz] == 254)
-                {
-                    padding++;
-                    // padding only at the end
-                    if (size > 2)
-                    {
-                        throw std::runtime_error("invalid padding character found in base64 string");
-                    }
-                    if (size == 2)
-                    {
-                        const auto ch2 = *(iter + 1);
-                        if (!is_ascii(ch2))
-                        {
-                            throw std::runtime_error("invalid padding character found in base64 string");
-                        }
-                        const size_t ch2_sz = static_cast<size_t>(ch2);
-                        if (ch2_sz >= _base64_dectbl.size() || _base64_dectbl[ch2_sz] != 254)
-                        {
-                            throw std::runtime_error("invalid padding character found in base64 string");
-                        }
-                    }
-                }
+                throw std::runtime_error("invalid padding character found in base64 string");
             }
         }
+    }
+
+} // noname namespace
 
+    std::string to_base64(const std::vector<unsigned char> &input)
+    {
+        return to_base64(input.data(), input.size());
+    }
+
+    std::string to_base64(const unsigned char* input, size_t size)
+    {
+        static const encode_function encode_simd = select_encode();
 
-        auto size = input.size();
-        const char* ptr = &input[0];
+        std::string result(((size + 2) / 3) * 4, '\0');
+        char* out = &result[0];
 
-        auto outsz = (size / 4) * 3;
-        outsz -= padding;
+        size_t consumed = encode_simd(input, size, out);
+        out += consumed / 3 * 4;
+        const unsigned char* ptr = input + consumed;
+        size -= consumed;
 
-        result.resize(outsz);
+        for (; size >= 3; size -= 3, ptr += 3)
+        {
+            out[0] = _base64_enctbl[ptr[0] >> 2];
+            out[1] = _base64_enctbl[((ptr[0] & 0x3) << 4) | (ptr[1] >> 4)];
+            out[2] = _base64_enctbl[((ptr[1] & 0xF) << 2) | (ptr[2] >> 6)];
+            out[3] = _base64_enctbl[ptr[2] & 0x3F];
+            out += 4;
+        }
 
-        size_t idx = 0;
-        for (; size > 4; ++idx)
+        switch (size)
         {
-            unsigned char target[3];
-            std::memset(target, 0, sizeof(target));
-            _triple_byte* record = reinterpret_cast<_triple_byte*>(target);
+        case 1:
+            out[0] = _base64_enctbl[ptr[0] >> 2];
+            out[1] = _base64_enctbl[(ptr[0] & 0x3) << 4];
+            out[2] = '=';
+            out[3] = '=';
+            break;
+        case 2:
+            out[0] = _base64_enctbl[ptr[0] >> 2];
+            out[1] = _base64_enctbl[((ptr[0] & 0x3) << 4) | (ptr[1] >> 4)];
+            out[2] = _base64_enctbl[(ptr[1] & 0xF) << 2];
+            out[3] = '=';
+            break;
+        }
 
-            unsigned char val0 = _base64_dectbl[ptr[0]];
-            unsigned char val1 = _base64_dectbl[ptr[1]];
-            unsigned char val2 = _base64_dectbl[ptr[2]];
-            unsigned char val3 = _base64_dectbl[ptr[3]];
+        return result;
+    }
 
-            record->_0 = val0;
-            record->_1_1 = val1 >> 4;
-            result[idx] = target[0];
+    std::vector<unsigned char> from_base64(const std::string &input)
+    {
+        static const decode_function decode_simd = select_decode();
 
-            record->_1_2 = val1 & 0xF;
-            record->_2_1 = val2 >> 2;
-            result[++idx] = target[1];
+        std::vector<unsigned char> result;
 
-            record->_2_2 = val2 & 0x3;
-            record->_3 = val3 & 0x3F;
-            result[++idx] = target[2];
+        if (input.empty())
+            return result;
 
-            ptr += 4;
-            size -= 4;
+        const auto size = input.size();
+        if ((size % 4) != 0)
+        {
+            throw std::runtime_error("length of base64 string is not an even multiple of 4");
         }
 
-        // Handle the last four bytes separately, to avoid having the conditional statements
-        // in all the iterations (a performance issue).
+        size_t padding = 0;
+        if (input[size - 1] == '=')
         {
-            unsigned char target[3];
-            std::memset(target, 0, sizeof(target));
-            _triple_byte* record = reinterpret_cast<_triple_byte*>(target);
+            ++padding;
+            if (input[size - 2] == '=')
+            {
+                ++padding;
+            }
+        }
+        result.resize(size / 4 * 3 - padding);
 
-            unsigned char val0 = _base64_dectbl[ptr[0]];
-            unsigned char val1 = _base64_dectbl[ptr[1]];
-            unsigned char val2 = _base64_dectbl[ptr[2]];
-            unsigned char val3 = _base64_dectbl[ptr[3]];
+        const char* ptr = input.data();
+        unsigned char* out = result.data();
 
-            record->_0 = val0;
-            record->_1_1 = val1 >> 4;
-            result[idx] = target[0];
+        size_t consumed = decode_simd(ptr, size, out, result.size());
+        out += consumed / 4 * 3;
 
-            record->_1_2 = val1 & 0xF;
-            if (val2 != 254)
-            {
-                record->_2_1 = val2 >> 2;
-                result[++idx] = target[1];
-            }
-            else
+        // Groups the vector path left over, and any group with an invalid character, go through the checks below.
+        for (; consumed + 4 < size; consumed += 4, out += 3)
+        {
+            const unsigned char val0 = decode_char(ptr[consumed]);
+            const unsigned char val1 = decode_char(ptr[consumed + 1]);
+            const unsigned char val2 = decode_char(ptr[consumed + 2]);
+            const unsigned char val3 = decode_char(ptr[consumed + 3]);
+            if ((val0 | val1 | val2 | val3) >= 254)
             {
-                // There shouldn't be any information (ones) in the unused bits,
-                if (record->_1_2 != 0)
-                {
-                    throw std::runtime_error("Invalid end of base64 string");
-                }
-                return result;
+                validate_group(ptr + consumed, size - consumed);
             }
+            out[0] = static_cast<unsigned char>((val0 << 2) | (val1 >> 4));
+            out[1] = static_cast<unsigned char>((val1 << 4) | (val2 >> 2));
+            out[2] = static_cast<unsigned char>((val2 << 6) | val3);
+        }
 
-            record->_2_2 = val2 & 0x3;
-            if (val3 != 254)
+        // Handle the last four characters separately, they are the only ones that may be padding.
+        validate_group(ptr + consumed, 4);
+        const unsigned char val0 = decode_char(ptr[consumed]);
+        const unsigned char val1 = decode_char(ptr[consumed + 1]);
+        const unsigned char val2 = decode_char(ptr[consumed + 2]);
+        const unsigned char val3 = decode_char(ptr[consumed + 3]);
+
+        out[0] = static_cast<unsigned char>((val0 << 2) | (val1 >> 4));
+        if (val2 == 254)
+        {
+            // There shouldn't be any information (ones) in the unused bits.
+            if ((val1 & 0xF) != 0)
             {
-                record->_3 = val3 & 0x3F;
-                result[++idx] = target[2];
+                throw std::runtime_error("Invalid end of base64 string");
             }
-            else
+            return result;
+        }
+        out[1] = static_cast<unsigned char>((val1 << 4) | (val2 >> 2));
+        if (val3 == 254)
+        {
+            if ((val2 & 0x3) != 0)
             {
-                // There shouldn't be any information (ones) in the unused bits.
-                if (record->_2_2 != 0)
-                {
-                    throw std::runtime_error("Invalid end of base64 string");
-                }
-                return result;
+                throw std::runtime_error("Invalid end of base64 string");
             }
+            return result;
         }
+        out[2] = static_cast<unsigned char>((val2 << 6) | val3);
 
         return result;
     }
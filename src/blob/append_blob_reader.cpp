@@ -0,0 +1,166 @@
+#include "blob/append_blob_reader.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace azure { namespace storage_lite {
+
+append_blob_reader::append_blob_reader(std::shared_ptr<blob_client> client, const std::string &container, const std::string &blob, std::function<void(const char*, size_t)> on_record, unsigned long long offset, const append_blob_reader_options &options)
+    : m_client(std::move(client)),
+    m_container(container),
+    m_blob(blob),
+    m_on_record(std::move(on_record)),
+    m_options(options),
+    m_record_offset(offset),
+    m_stopping(false)
+{
+    m_options.max_read_size = std::max<size_t>(m_options.max_read_size, 1);
+    m_options.max_record_size = std::max<size_t>(m_options.max_record_size, 1);
+    m_options.max_poll_interval = std::max(m_options.max_poll_interval, m_options.min_poll_interval);
+}
+
+append_blob_reader::~append_blob_reader()
+{
+    stop();
+}
+
+storage_outcome<unsigned long long> append_blob_reader::poll()
+{
+    std::lock_guard<std::mutex> lock(m_poll_mutex);
+
+    unsigned long long read_offset = m_record_offset.load() + m_partial.size();
+    std::ostringstream os;
+    auto outcome = m_client->get_chunk_to_stream_sync(m_container, m_blob, read_offset, m_options.max_read_size, os, m_etag);
+    if (!outcome.success())
+    {
+        if (outcome.error().code == "304")
+        {
+            return storage_outcome<unsigned long long>(0);
+        }
+        if (outcome.error().code == "416")
+        {
+            // The blob changed without growing, remember its new ETag so the next polls are conditional again.
+            auto properties = m_client->get_blob_properties(m_container, m_blob).get();
+            if (!properties.success())
+            {
+                return storage_outcome<unsigned long long>(properties.error());
+            }
+            if (properties.response().size == read_offset)
+            {
+                m_etag = properties.response().etag;
+            }
+            return storage_outcome<unsigned long long>(0);
+        }
+        return storage_outcome<unsigned long long>(outcome.error());
+    }
+
+    const std::string data = os.str();
+    // The ETag only proves there is nothing new once the read reached the end of the blob.
+    if (outcome.response().totalSize >= 0 && static_cast<unsigned long long>(outcome.response().totalSize) == read_offset + data.size())
+    {
+        m_etag = outcome.response().etag;
+    }
+    else
+    {
+        m_etag.clear();
+    }
+
+    // Hands out the given range of the data as a record, after the start of it kept from earlier polls.
+    auto hand_out = [this, &data](size_t start, size_t length, size_t delimiter_length)
+    {
+        if (m_partial.empty())
+        {
+            m_on_record(data.data() + start, length);
+            m_record_offset += length + delimiter_length;
+        }
+        else
+        {
+            m_partial.append(data, start, length);
+            m_on_record(m_partial.data(), m_partial.size());
+            m_record_offset += m_partial.size() + delimiter_length;
+            m_partial.clear();
+        }
+    };
+
+    size_t start = 0;
+    while (true)
+    {
+        const size_t pos = data.find(m_options.delimiter, start);
+        const size_t end = pos == std::string::npos ? data.size() : pos;
+        if (m_partial.size() + (end - start) > m_options.max_record_size)
+        {
+            // The record outgrew the largest size kept, hand out what fits and carry on with the rest as a new record.
+            const size_t length = m_options.max_record_size - m_partial.size();
+            hand_out(start, length, 0);
+            start += length;
+            continue;
+        }
+        if (pos == std::string::npos)
+        {
+            break;
+        }
+        hand_out(start, pos - start, 1);
+        start = pos + 1;
+    }
+    m_partial.append(data, start, std::string::npos);
+
+    return storage_outcome<unsigned long long>(data.size());
+}
+
+void append_blob_reader::follow(std::function<void(const storage_error &)> on_error)
+{
+    std::lock_guard<std::mutex> lock(m_follow_mutex);
+    if (m_follower.joinable())
+    {
+        return;
+    }
+    m_stopping = false;
+
+    m_follower = std::thread([this, on_error]()
+    {
+        auto interval = m_options.min_poll_interval;
+        std::unique_lock<std::mutex> lock(m_follow_mutex);
+        while (!m_stopping)
+        {
+            lock.unlock();
+            auto outcome = poll();
+            bool more = false;
+            if (outcome.success() && outcome.response() > 0)
+            {
+                interval = m_options.min_poll_interval;
+                more = outcome.response() >= m_options.max_read_size;
+            }
+            else
+            {
+                if (!outcome.success() && on_error)
+                {
+                    on_error(outcome.error());
+                }
+                interval = std::min(interval * 2, m_options.max_poll_interval);
+            }
+            lock.lock();
+
+            if (!more)
+            {
+                m_follow_cv.wait_for(lock, interval, [this]() { return m_stopping; });
+            }
+        }
+    });
+}
+
+void append_blob_reader::stop()
+{
+    std::thread follower;
+    {
+        std::lock_guard<std::mutex> lock(m_follow_mutex);
+        m_stopping = true;
+        follower = std::move(m_follower);
+    }
+    m_follow_cv.notify_all();
+    if (follower.joinable())
+    {
+        follower.join();
+    }
+}
+
+}} // azure::storage_lite
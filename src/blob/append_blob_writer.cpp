@@ -0,0 +1,219 @@
+#include "blob/append_blob_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "storage_errno.h"
+
+namespace azure { namespace storage_lite {
+
+namespace {
+
+storage_outcome<void> make_error(int code)
+{
+    storage_error error;
+    error.code = std::to_string(code);
+    return storage_outcome<void>(error);
+}
+
+}
+
+append_blob_writer::append_blob_writer(std::shared_ptr<blob_client> client, const std::string &container, const std::string &blob, const append_blob_writer_options &options)
+    : m_client(std::move(client)),
+    m_container(container),
+    m_blob(blob),
+    m_options(options),
+    m_buffered_size(0),
+    m_enqueued_count(0),
+    m_completed_count(0),
+    m_flush_target(0),
+    m_closed(false),
+    m_position(0),
+    m_position_known(false)
+{
+    m_options.max_block_size = std::min<size_t>(std::max<size_t>(m_options.max_block_size, 1), 4 * 1024 * 1024);
+    m_options.max_buffered_size = std::max(m_options.max_buffered_size, m_options.max_block_size);
+    m_flusher = std::thread([this]() { run(); });
+}
+
+append_blob_writer::~append_blob_writer()
+{
+    close();
+}
+
+std::future<storage_outcome<void>> append_blob_writer::append(std::string record)
+{
+    pending_record pending;
+    auto future = pending.promise.get_future();
+
+    if (record.empty() || record.size() > m_options.max_block_size)
+    {
+        pending.promise.set_value(make_error(invalid_parameters));
+        return future;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_space_cv.wait(lock, [this, &record]() { return m_closed || m_buffered_size == 0 || m_buffered_size + record.size() <= m_options.max_buffered_size; });
+    if (m_closed)
+    {
+        pending.promise.set_value(make_error(blob_writer_closed));
+        return future;
+    }
+
+    bool was_empty = m_records.empty();
+    m_buffered_size += record.size();
+    ++m_enqueued_count;
+    pending.data = std::move(record);
+    pending.enqueued = std::chrono::steady_clock::now();
+    m_records.push_back(std::move(pending));
+
+    // The flusher only needs waking to arm the interval timer or when a full block is ready.
+    if (was_empty || m_buffered_size >= m_options.max_block_size)
+    {
+        m_cv.notify_one();
+    }
+    return future;
+}
+
+void append_blob_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    unsigned long long target = m_enqueued_count;
+    m_flush_target = std::max(m_flush_target, target);
+    m_cv.notify_one();
+    m_space_cv.wait(lock, [this, target]() { return m_completed_count >= target; });
+}
+
+void append_blob_writer::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_cv.notify_one();
+    m_space_cv.notify_all();
+    if (m_flusher.joinable())
+    {
+        m_flusher.join();
+    }
+}
+
+void append_blob_writer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        if (m_records.empty())
+        {
+            if (m_closed)
+            {
+                break;
+            }
+            m_cv.wait(lock);
+            continue;
+        }
+
+        bool full = m_buffered_size >= m_options.max_block_size;
+        bool forced = m_closed || m_flush_target > m_completed_count;
+        auto deadline = m_records.front().enqueued + m_options.flush_interval;
+        if (!full && !forced && std::chrono::steady_clock::now() < deadline)
+        {
+            m_cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::vector<pending_record> batch;
+        std::string block;
+        block.reserve(std::min(m_buffered_size, m_options.max_block_size));
+        while (!m_records.empty() && block.size() + m_records.front().data.size() <= m_options.max_block_size)
+        {
+            block.append(m_records.front().data);
+            batch.push_back(std::move(m_records.front()));
+            m_records.pop_front();
+        }
+
+        lock.unlock();
+        auto outcome = commit_block(block);
+        for (auto &record : batch)
+        {
+            record.promise.set_value(outcome);
+        }
+        lock.lock();
+
+        m_buffered_size -= block.size();
+        m_completed_count += batch.size();
+        m_space_cv.notify_all();
+    }
+}
+
+storage_outcome<void> append_blob_writer::commit_block(const std::string &block)
+{
+    if (!m_position_known)
+    {
+        auto properties = m_client->get_blob_properties(m_container, m_blob).get();
+        if (properties.success())
+        {
+            m_position = properties.response().size;
+        }
+        else if (properties.error().code == "404")
+        {
+            auto created = m_client->create_append_blob(m_container, m_blob).get();
+            if (!created.success())
+            {
+                return created;
+            }
+            m_position = 0;
+        }
+        else
+        {
+            return storage_outcome<void>(properties.error());
+        }
+        m_position_known = true;
+    }
+
+    auto outcome = m_client->append_block_from_buffer(m_container, m_blob, block.data(), block.size(), m_position).get();
+    if (outcome.success())
+    {
+        m_position += block.size();
+        return outcome;
+    }
+    if (outcome.error().code == "412")
+    {
+        return resolve_append_position(block);
+    }
+    // The outcome of a failed request is unknown, so the next block re-reads the blob size.
+    m_position_known = false;
+    return outcome;
+}
+
+storage_outcome<void> append_blob_writer::resolve_append_position(const std::string &block)
+{
+    // A retried append fails the position check when an earlier attempt was committed but its response was lost.
+    // The block is taken as committed only if the blob holds exactly its content at the expected position.
+    m_position_known = false;
+    auto properties = m_client->get_blob_properties(m_container, m_blob).get();
+    if (!properties.success())
+    {
+        return storage_outcome<void>(properties.error());
+    }
+
+    unsigned long long size = properties.response().size;
+    if (size >= m_position + block.size())
+    {
+        std::vector<char> committed(block.size());
+        auto download = m_client->download_blob_to_buffer(m_container, m_blob, m_position, block.size(), committed.data(), 1).get();
+        if (download.success() && std::memcmp(committed.data(), block.data(), block.size()) == 0)
+        {
+            m_position += block.size();
+            m_position_known = size == m_position;
+            return storage_outcome<void>();
+        }
+    }
+
+    m_position = size;
+    m_position_known = true;
+    return make_error(blob_append_position_mismatch);
+}
+
+}} // azure::storage_lite
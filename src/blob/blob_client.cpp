@@ -1,10 +1,18 @@
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <future>
+#include <limits>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #ifdef _WIN32
 #include <BaseTsd.h>
 typedef SSIZE_T ssize_t;
+#else
+#include <fcntl.h>
 #endif
 
 #include "blob/blob_client.h"
@@ -27,14 +35,16 @@ typedef SSIZE_T ssize_t;
 #include "blob/get_page_ranges_request.h"
 #include "blob/set_container_metadata_request.h"
 #include "blob/set_blob_metadata_request.h"
+#include "blob/snapshot_blob_request.h"
+#include "blob/blob_batch_request.h"
 
 #include "constants.h"
 #include "storage_errno.h"
 #include "executor.h"
 #include "utility.h"
 #include "base64.h"
+#include "hash.h"
 #include "tinyxml2_parser.h"
-#include "mstream.h"
 
 #include <curl/curl.h>
 
@@ -57,11 +67,181 @@ ssize_t get_length_from_content_range(const std::string &header)
    return result;
 }
 
-} // noname namespace
+// Split a buffer at content-defined boundaries found with a gear rolling hash, so an insertion or deletion only changes the blocks around it.
+// Returns the end offset of every chunk.
+std::vector<uint64_t> get_content_defined_chunks(const char* buffer, uint64_t size)
+{
+    static const std::vector<uint64_t> gear = []()
+    {
+        std::vector<uint64_t> table(256);
+        uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        for (auto &value : table)
+        {
+            // splitmix64
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            value = z ^ (z >> 31);
+        }
+        return table;
+    }();
 
-storage_outcome<chunk_property> blob_client::get_chunk_to_stream_sync(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os)
+    // Chunks average twice the minimum size, and the minimum size keeps the chunk count within the block limit.
+    uint64_t average_size = 4 * 1024 * 1024;
+    while (average_size < 4 * size / azure::storage_lite::constants::max_num_blocks)
+    {
+        average_size *= 2;
+    }
+    const uint64_t min_size = average_size / 2;
+    const uint64_t max_size = std::min(average_size * 4, azure::storage_lite::constants::max_block_size);
+    // A boundary follows each byte with probability 1 / (average_size - min_size). The mask uses the high bits,
+    // the low bits of a gear hash only depend on the last few bytes.
+    int mask_bits = 0;
+    while ((uint64_t(1) << mask_bits) < average_size - min_size)
+    {
+        ++mask_bits;
+    }
+    const uint64_t mask = ((uint64_t(1) << mask_bits) - 1) << (64 - mask_bits);
+
+    std::vector<uint64_t> chunks;
+    uint64_t start = 0;
+    while (start < size)
+    {
+        uint64_t end = std::min(start + max_size, size);
+        if (start + min_size < end)
+        {
+            uint64_t h = 0;
+            for (uint64_t i = start + min_size; i < end; ++i)
+            {
+                h = (h << 1) + gear[static_cast<unsigned char>(buffer[i])];
+                if ((h & mask) == 0)
+                {
+                    end = i + 1;
+                    break;
+                }
+            }
+        }
+        chunks.push_back(end);
+        start = end;
+    }
+    return chunks;
+}
+
+const uint64_t max_transactional_checksum_range = 4 * 1024 * 1024;
+
+// The requests carry the length of their body as an unsigned int.
+template<typename RESPONSE_TYPE>
+bool check_content_length(uint64_t length, std::future<storage_outcome<RESPONSE_TYPE>> &failure)
+{
+    if (length <= std::numeric_limits<unsigned int>::max())
+    {
+        return true;
+    }
+    storage_error error;
+    error.code = std::to_string(blob_too_big);
+    error.message = "The body of a single request is limited to " + std::to_string(std::numeric_limits<unsigned int>::max()) + " bytes";
+    std::promise<storage_outcome<RESPONSE_TYPE>> promise;
+    promise.set_value(storage_outcome<RESPONSE_TYPE>(error));
+    failure = promise.get_future();
+    return false;
+}
+
+template<typename REQUEST_TYPE>
+void set_checksum_header(REQUEST_TYPE &request, checksum_type type, const std::string &checksum)
+{
+    if (type == checksum_type::md5)
+    {
+        request.set_content_md5(checksum);
+    }
+    else if (type == checksum_type::crc64)
+    {
+        request.set_content_crc64(checksum);
+    }
+}
+
+template<typename REQUEST_TYPE>
+void set_transactional_checksum(REQUEST_TYPE &request, checksum_type type, const char* buffer, uint64_t bufferlen)
+{
+    if (type != checksum_type::none)
+    {
+        set_checksum_header(request, type, checksum_calculator::compute(type, buffer, static_cast<size_t>(bufferlen)));
+    }
+}
+
+template<typename REQUEST_TYPE>
+bool set_transactional_checksum(REQUEST_TYPE &request, checksum_type type, int fd, uint64_t offset, uint64_t length)
+{
+    if (type == checksum_type::none)
+    {
+        return true;
+    }
+    checksum_calculator calculator(type);
+    auto source = storage_input_buffer::from_file(fd, offset, length);
+    std::vector<char> chunk(static_cast<size_t>(std::min<uint64_t>(length, 1024 * 1024)));
+    size_t copied = 0;
+    do
+    {
+        if (!source.read(chunk.data(), chunk.size(), copied))
+        {
+            return false;
+        }
+        calculator.update(chunk.data(), copied);
+    } while (copied > 0);
+    set_checksum_header(request, type, calculator.value());
+    return true;
+}
+
+// Starts reading a file range ahead of the transfer, which then consumes it front to back.
+void advise_sequential_read(int fd, uint64_t offset, uint64_t length)
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+// The service only returns the checksum of ranges up to 4MB.
+bool request_range_checksum(download_blob_request &request, checksum_type type, uint64_t size)
+{
+    if (type == checksum_type::none || size == 0 || size > max_transactional_checksum_range)
+    {
+        return false;
+    }
+    request.set_ms_range_get_content_md5(type == checksum_type::md5);
+    request.set_ms_range_get_content_crc64(type == checksum_type::crc64);
+    return true;
+}
+
+storage_outcome<void> verify_range_checksum(const http_base &http, checksum_type type, const std::string &computed)
+{
+    const char *header = type == checksum_type::md5 ? constants::header_content_md5 : constants::header_ms_content_crc64;
+    const std::string &expected = http.get_response_header(header);
+    // The checksum was asked for, a response without it cannot be verified.
+    if (expected.empty())
+    {
+        storage_error error;
+        error.code = std::to_string(blob_checksum_missing);
+        error.code_name = "ChecksumMissing";
+        error.message = std::string("The response has no ") + header + " header";
+        return storage_outcome<void>(error);
+    }
+    if (expected != computed)
+    {
+        storage_error error;
+        error.code = std::to_string(blob_checksum_mismatch);
+        error.code_name = "ChecksumMismatch";
+        error.message = "Expected " + expected + ", computed " + computed;
+        return storage_outcome<void>(error);
+    }
+    return storage_outcome<void>();
+}
+
+std::shared_ptr<download_blob_request> make_chunk_request(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, const std::string &if_none_match)
 {
-    auto http = m_client->get_handle();
     auto request = std::make_shared<download_blob_request>(container, blob);
     if (size > 0) {
         request->set_start_byte(offset);
@@ -70,26 +250,176 @@ storage_outcome<chunk_property> blob_client::get_chunk_to_stream_sync(const std:
     else {
         request->set_start_byte(offset);
     }
+    request->set_if_none_match(if_none_match);
+    return request;
+}
 
-    http->set_output_stream(storage_ostream(os));
+chunk_property get_chunk_property(const http_base &http)
+{
+    chunk_property property{};
+    property.etag = http.get_response_header(constants::header_etag);
+    property.totalSize = get_length_from_content_range(http.get_response_header(constants::header_content_range));
+    std::istringstream(http.get_response_header(constants::header_content_length)) >> property.size;
+    property.last_modified = curl_getdate(http.get_response_header(constants::header_last_modified).c_str(), NULL);
+    return property;
+}
+
+storage_outcome<chunk_property> download_chunk(std::shared_ptr<storage_account> account, std::shared_ptr<executor_context> context, checksum_type checksum, std::shared_ptr<http_base> http, const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os, const std::string &if_none_match)
+{
+    auto request = make_chunk_request(container, blob, offset, size, if_none_match);
+
+    std::shared_ptr<checksum_ostream> checksum_os;
+    if (request_range_checksum(*request, checksum, size))
+    {
+        checksum_os = std::make_shared<checksum_ostream>(os, checksum);
+        http->set_output_stream(storage_ostream(*checksum_os));
+    }
+    else
+    {
+        http->set_output_stream(storage_ostream(os));
+    }
 
     // TODO: async submit transfered to sync operation. This can be utilized.
-    const auto response = async_executor<void>::submit(m_account, request, http, m_context).get();
+    auto response = async_executor<void>::submit(account, request, http, context).get();
+    if (response.success() && checksum_os)
+    {
+        response = verify_range_checksum(*http, checksum, checksum_os->checksum());
+    }
     if (response.success())
     {
-        chunk_property property{};
-        property.etag = http->get_response_header(constants::header_etag);
-        property.totalSize = get_length_from_content_range(http->get_response_header(constants::header_content_range));
-        std::istringstream(http->get_response_header(constants::header_content_length)) >> property.size;
-        property.last_modified = curl_getdate(http->get_response_header(constants::header_last_modified).c_str(), NULL);
-        return storage_outcome<chunk_property>(property);
+        return storage_outcome<chunk_property>(get_chunk_property(*http));
     }
     return storage_outcome<chunk_property>(storage_error(response.error()));
 }
 
+// Downloads a range of at most size bytes into the buffer, a larger response fails the transfer.
+storage_outcome<chunk_property> download_chunk_to_buffer(std::shared_ptr<storage_account> account, std::shared_ptr<executor_context> context, checksum_type checksum, std::shared_ptr<http_base> http, const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, char *buffer, const std::string &if_none_match)
+{
+    auto request = make_chunk_request(container, blob, offset, size, if_none_match);
+    const bool verify = request_range_checksum(*request, checksum, size);
+    http->set_output_buffer(storage_output_buffer(buffer, static_cast<size_t>(size)));
+
+    auto response = async_executor<void>::submit(account, request, http, context).get();
+    if (!response.success())
+    {
+        return storage_outcome<chunk_property>(storage_error(response.error()));
+    }
+    auto property = get_chunk_property(*http);
+    if (verify)
+    {
+        response = verify_range_checksum(*http, checksum, checksum_calculator::compute(checksum, buffer, static_cast<size_t>(std::min<unsigned long long>(property.size, size))));
+        if (!response.success())
+        {
+            return storage_outcome<chunk_property>(storage_error(response.error()));
+        }
+    }
+    return storage_outcome<chunk_property>(property);
+}
+
+} // noname namespace
+
+storage_outcome<chunk_property> blob_client::get_chunk_to_stream_sync(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os)
+{
+    return get_chunk_to_stream_sync(container, blob, offset, size, os, std::string());
+}
+
+storage_outcome<chunk_property> blob_client::get_chunk_to_stream_sync(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os, const std::string &if_none_match)
+{
+    const auto hedging = m_read_hedging;
+    if (!hedging || size == 0 || size > hedging->max_read_size())
+    {
+        return download_chunk(m_account, m_context, m_transfer_checksum, get_handle(), container, blob, offset, size, os, if_none_match);
+    }
+
+    // Each attempt downloads into its own buffer of the size of the range, the one that wins is copied to the caller's stream.
+    // The losing attempt is cancelled and only writes to its own buffer until libcurl notices, it is not joined since
+    // a stalled transfer can take up to a second to call back, which would give away what the hedge saved.
+    struct hedged_read
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int running = 0;
+        int winner = -1;
+        std::shared_ptr<CurlEasyRequest> http[2];
+        std::vector<char> data[2];
+        storage_outcome<chunk_property> outcome[2];
+    };
+    auto read = std::make_shared<hedged_read>();
+    std::thread attempts[2];
+    auto account = m_account;
+    auto context = m_context;
+    auto checksum = m_transfer_checksum;
+    const std::string container_name = container;
+    const std::string blob_name = blob;
+    const std::string etag = if_none_match;
+
+    // Called with the mutex held.
+    auto start_attempt = [&](int i, std::shared_ptr<CurlEasyRequest> http)
+    {
+        read->http[i] = http;
+        read->data[i].resize(static_cast<size_t>(size));
+        ++read->running;
+        attempts[i] = std::thread([read, i, http, account, context, checksum, container_name, blob_name, offset, size, etag, hedging]()
+        {
+            auto outcome = download_chunk_to_buffer(account, context, checksum, http, container_name, blob_name, offset, size, read->data[i].data(), etag);
+            if (outcome.success())
+            {
+                // The delay is compared with the wait for the status line, so the body transfer is left out.
+                hedging->record(http->time_to_first_byte());
+            }
+
+            std::lock_guard<std::mutex> lock(read->mutex);
+            read->outcome[i] = std::move(outcome);
+            read->http[i].reset();
+            --read->running;
+            // A failed attempt only settles the read once no other attempt can still succeed.
+            if (read->winner < 0 && (read->outcome[i].success() || read->running == 0))
+            {
+                read->winner = i;
+                read->cv.notify_all();
+            }
+        });
+    };
+
+    std::unique_lock<std::mutex> lock(read->mutex);
+    start_attempt(0, get_handle());
+    if (!read->cv.wait_for(lock, hedging->delay(), [&read]() { return read->winner >= 0; }) && !read->http[0]->response_started() && hedging->try_hedge())
+    {
+        auto http = m_client->try_get_handle(m_priority);
+        if (http)
+        {
+            http->set_cancellation_token(m_cancellation);
+            start_attempt(1, std::move(http));
+        }
+    }
+    read->cv.wait(lock, [&read]() { return read->winner >= 0; });
+
+    const int winner = read->winner;
+    for (int i = 0; i < 2; ++i)
+    {
+        if (i != winner && read->http[i])
+        {
+            read->http[i]->cancel();
+        }
+    }
+    lock.unlock();
+    attempts[winner].join();
+    if (attempts[1 - winner].joinable())
+    {
+        attempts[1 - winner].detach();
+    }
+
+    if (read->outcome[winner].success())
+    {
+        const auto &data = read->data[winner];
+        os.write(data.data(), static_cast<std::streamsize>(std::min<unsigned long long>(read->outcome[winner].response().size, data.size())));
+    }
+    return read->outcome[winner];
+}
+
 std::future<storage_outcome<void>> blob_client::download_blob_to_stream(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<download_blob_request>(container, blob);
 
@@ -101,6 +431,23 @@ std::future<storage_outcome<void>> blob_client::download_blob_to_stream(const st
         request->set_start_byte(offset);
     }
 
+    if (request_range_checksum(*request, m_transfer_checksum, size))
+    {
+        auto checksum_os = std::make_shared<checksum_ostream>(os, m_transfer_checksum);
+        http->set_output_stream(storage_ostream(checksum_os));
+
+        std::shared_future<storage_outcome<void>> response = async_executor<void>::submit(m_account, request, http, m_context);
+        checksum_type type = m_transfer_checksum;
+        return std::async(std::launch::deferred, [http, response, checksum_os, type]()
+        {
+            if (!response.get().success())
+            {
+                return response.get();
+            }
+            return verify_range_checksum(*http, type, checksum_os->checksum());
+        });
+    }
+
     http->set_output_stream(storage_ostream(os));
 
     return async_executor<void>::submit(m_account, request, http, m_context);
@@ -114,6 +461,10 @@ std::future<storage_outcome<void>> blob_client::download_blob_to_buffer(const st
     uint64_t block_size = size / parallelism;
     block_size = (block_size + grain_size - 1) / grain_size * grain_size;
     block_size = std::min(block_size, constants::default_block_size);
+    if (m_transfer_checksum != checksum_type::none)
+    {
+        block_size = std::min(block_size, max_transactional_checksum_range);
+    }
 
     int num_blocks = int((size + block_size - 1) / block_size);
 
@@ -154,15 +505,19 @@ std::future<storage_outcome<void>> blob_client::download_blob_to_buffer(const st
             char* block_buffer = info->buffer + info->block_size * i;
             uint64_t block_size = std::min(info->block_size, info->download_size - info->block_size * i);
 
-            auto http = m_client->get_handle();
+            auto http = get_handle();
             auto request = std::make_shared<download_blob_request>(info->container, info->blob);
             request->set_start_byte(info->download_offset + info->block_size * i);
             request->set_end_byte(request->start_byte() + block_size - 1);
 
-            auto os = std::make_shared<omstream>(block_buffer, block_size);
-            http->set_output_stream(storage_ostream(os));
+            http->set_output_buffer(storage_output_buffer(block_buffer, static_cast<size_t>(block_size)));
+            const bool verify_checksum = request_range_checksum(*request, m_transfer_checksum, block_size);
 
             auto result = async_executor<void>::submit(m_account, request, http, m_context).get();
+            if (result.success() && verify_checksum)
+            {
+                result = verify_range_checksum(*http, m_transfer_checksum, checksum_calculator::compute(m_transfer_checksum, block_buffer, static_cast<size_t>(block_size)));
+            }
 
             if (!result.success() && !context->failed.exchange(true))
             {
@@ -186,7 +541,7 @@ std::future<storage_outcome<void>> blob_client::download_blob_to_buffer(const st
 
 std::future<storage_outcome<void>> blob_client::upload_block_blob_from_stream(const std::string &container, const std::string &blob, std::istream &is, const std::vector<std::pair<std::string, std::string>> &metadata)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<create_block_blob_request>(container, blob);
 
@@ -207,7 +562,7 @@ std::future<storage_outcome<void>> blob_client::upload_block_blob_from_stream(co
 
 std::future<storage_outcome<void>> blob_client::upload_block_blob_from_stream(const std::string &container, const std::string &blob, std::istream &is, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t streamlen)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<create_block_blob_request>(container, blob);
 
@@ -224,6 +579,39 @@ std::future<storage_outcome<void>> blob_client::upload_block_blob_from_stream(co
     return async_executor<void>::submit(m_account, request, http, m_context);
 }
 
+std::future<storage_outcome<void>> blob_client::upload_block_blob_from_file(const std::string &container, const std::string &blob, int fd, uint64_t offset, uint64_t length, const std::vector<std::pair<std::string, std::string>> &metadata)
+{
+    std::future<storage_outcome<void>> failure;
+    if (!check_content_length(length, failure))
+    {
+        return failure;
+    }
+
+    auto request = std::make_shared<create_block_blob_request>(container, blob);
+
+    request->set_content_length(static_cast<unsigned int>(length));
+    if (metadata.size() > 0)
+    {
+        request->set_metadata(metadata);
+    }
+
+    advise_sequential_read(fd, offset, length);
+    if (!set_transactional_checksum(*request, m_transfer_checksum, fd, offset, length))
+    {
+        storage_error error;
+        error.code = std::to_string(unknown_error);
+        error.message = "Failed to read the source file";
+        std::promise<storage_outcome<void>> promise;
+        promise.set_value(storage_outcome<void>(error));
+        return promise.get_future();
+    }
+
+    auto http = get_handle();
+    http->set_input_buffer(storage_input_buffer::from_file(fd, offset, length));
+
+    return async_executor<void>::submit(m_account, request, http, m_context);
+}
+
 std::future<storage_outcome<void>> blob_client::upload_block_blob_from_buffer(const std::string &container, const std::string &blob, const char* buffer, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t bufferlen, int parallelism)
 {
     if (bufferlen > constants::max_num_blocks * constants::max_block_size)
@@ -323,33 +711,318 @@ std::future<storage_outcome<void>> blob_client::upload_block_blob_from_buffer(co
     return context->task_promise.get_future();
 }
 
+std::future<storage_outcome<void>> blob_client::sync_block_blob_from_buffer(const std::string &container, const std::string &blob, const char* buffer, const std::vector<std::pair<std::string, std::string>> &metadata, uint64_t bufferlen, int parallelism)
+{
+    if (bufferlen > constants::max_num_blocks * constants::max_block_size)
+    {
+        storage_error error;
+        error.code = std::to_string(blob_too_big);
+        std::promise<storage_outcome<void>> promise;
+        promise.set_value(storage_outcome<void>(error));
+        return promise.get_future();
+    }
+
+    parallelism = std::max(std::min(parallelism, int(concurrency())), 1);
+
+    // Blocks the blob already holds are found by their committed IDs, there is no need to store the hashes separately.
+    std::set<std::string> committed_blocks;
+    auto committed = get_block_list(container, blob).get();
+    if (committed.success())
+    {
+        for (const auto &item : committed.response().committed)
+        {
+            committed_blocks.insert(item.name);
+        }
+    }
+    else if (committed.error().code != "404")
+    {
+        std::promise<storage_outcome<void>> promise;
+        promise.set_value(storage_outcome<void>(committed.error()));
+        return promise.get_future();
+    }
+
+    struct concurrent_task_info
+    {
+        std::string container;
+        std::string blob;
+        const char* buffer;
+        std::vector<put_block_list_request_base::block_item> block_list;
+        std::vector<std::pair<uint64_t, uint64_t>> block_ranges;
+        std::vector<size_t> uploads;
+        std::vector<std::pair<std::string, std::string>> metadata;
+    };
+    struct concurrent_task_context
+    {
+        std::atomic<int> num_workers{ 0 };
+        std::atomic<size_t> upload_index{ 0 };
+        std::atomic<bool> failed{ false };
+        storage_error failed_reason;
+
+        std::promise<storage_outcome<void>> task_promise;
+        std::vector<std::future<void>> task_futures;
+    };
+    auto info = std::make_shared<concurrent_task_info>();
+    info->container = container;
+    info->blob = blob;
+    info->buffer = buffer;
+    info->metadata = metadata;
+
+    // Block IDs are the SHA-256 of the block content, so unchanged blocks keep their ID and are committed again as they are.
+    std::set<std::string> staged_blocks;
+    uint64_t start = 0;
+    for (auto end : get_content_defined_chunks(buffer, bufferlen))
+    {
+        std::string block_id = to_base64(sha256(buffer + start, end - start));
+        if (committed_blocks.count(block_id) != 0)
+        {
+            info->block_list.emplace_back(put_block_list_request_base::block_item{ std::move(block_id), put_block_list_request_base::block_type::committed });
+        }
+        else
+        {
+            if (staged_blocks.insert(block_id).second)
+            {
+                info->uploads.push_back(info->block_list.size());
+            }
+            info->block_list.emplace_back(put_block_list_request_base::block_item{ std::move(block_id), put_block_list_request_base::block_type::uncommitted });
+        }
+        info->block_ranges.emplace_back(start, end - start);
+        start = end;
+    }
+
+    auto context = std::make_shared<concurrent_task_context>();
+    parallelism = std::max(std::min(parallelism, int(info->uploads.size())), 1);
+    context->num_workers = parallelism;
+
+    auto thread_upload_func = [this, info, context]()
+    {
+        while (true)
+        {
+            size_t i = context->upload_index.fetch_add(1);
+            if (i >= info->uploads.size() || context->failed)
+            {
+                break;
+            }
+            size_t block = info->uploads[i];
+            auto result = upload_block_from_buffer(info->container, info->blob, info->block_list[block].id, info->buffer + info->block_ranges[block].first, info->block_ranges[block].second).get();
+
+            if (!result.success() && !context->failed.exchange(true))
+            {
+                context->failed_reason = result.error();
+            }
+        }
+        if (context->num_workers.fetch_sub(1) == 1)
+        {
+            // I'm the last worker thread
+            if (!context->failed)
+            {
+                auto result = put_block_list(info->container, info->blob, info->block_list, info->metadata).get();
+                if (!result.success())
+                {
+                    context->failed.store(true);
+                    context->failed_reason = result.error();
+                }
+            }
+            context->task_promise.set_value(context->failed ? storage_outcome<void>(context->failed_reason) : storage_outcome<void>());
+        }
+    };
+
+    for (int i = 0; i < parallelism; ++i)
+    {
+        context->task_futures.emplace_back(std::async(std::launch::async, thread_upload_func));
+    }
+
+    return context->task_promise.get_future();
+}
+
 std::future<storage_outcome<void>> blob_client::upload_block_from_buffer(const std::string &container, const std::string &blob, const std::string &blockid, const char* buff, uint64_t bufferlen)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_block_request>(container, blob, blockid);
     request->set_content_length(static_cast<unsigned int>(bufferlen));
+    set_transactional_checksum(*request, m_transfer_checksum, buff, bufferlen);
 
-    auto is = std::make_shared<imstream>(buff, bufferlen);
-    http->set_input_stream(storage_istream(is));
-    http->set_is_input_length_known();
-    http->set_input_content_length(bufferlen);
+    http->set_input_buffer(storage_input_buffer(buff, static_cast<size_t>(bufferlen)));
+
+    return async_executor<void>::submit(m_account, request, http, m_context);
+}
+
+std::future<storage_outcome<void>> blob_client::upload_block_from_file(const std::string &container, const std::string &blob, const std::string &blockid, int fd, uint64_t offset, uint64_t length)
+{
+    std::future<storage_outcome<void>> failure;
+    if (!check_content_length(length, failure))
+    {
+        return failure;
+    }
+
+    auto request = std::make_shared<put_block_request>(container, blob, blockid);
+    request->set_content_length(static_cast<unsigned int>(length));
+    advise_sequential_read(fd, offset, length);
+    if (!set_transactional_checksum(*request, m_transfer_checksum, fd, offset, length))
+    {
+        storage_error error;
+        error.code = std::to_string(unknown_error);
+        error.message = "Failed to read the source file";
+        std::promise<storage_outcome<void>> promise;
+        promise.set_value(storage_outcome<void>(error));
+        return promise.get_future();
+    }
+
+    auto http = get_handle();
+    http->set_input_buffer(storage_input_buffer::from_file(fd, offset, length));
 
     return async_executor<void>::submit(m_account, request, http, m_context);
 }
 
 std::future<storage_outcome<void>> blob_client::delete_blob(const std::string &container, const std::string &blob, bool delete_snapshots)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<delete_blob_request>(container, blob, delete_snapshots);
 
     return async_executor<void>::submit(m_account, request, http, m_context);
 }
 
+std::future<storage_outcome<blob_batch_response>> blob_client::submit_batch(const std::vector<blob_batch_request_base::subrequest> &subrequests)
+{
+    if (subrequests.empty() || subrequests.size() > constants::max_batch_subrequests)
+    {
+        storage_error error;
+        error.code = std::to_string(invalid_parameters);
+        std::promise<storage_outcome<blob_batch_response>> promise;
+        promise.set_value(storage_outcome<blob_batch_response>(error));
+        return promise.get_future();
+    }
+
+    auto http = get_handle();
+
+    auto request = std::make_shared<blob_batch_request>(subrequests);
+
+    std::shared_future<storage_outcome<blob_batch_response>> response = async_executor<blob_batch_response>::submit(m_account, request, http, m_context);
+
+    const size_t count = subrequests.size();
+    return std::async(std::launch::deferred, [response, count]()
+    {
+        auto outcome = response.get();
+        if (!outcome.success() || outcome.response().results.size() == count)
+        {
+            return outcome;
+        }
+        auto results = outcome.response().results;
+        if (results.size() == 1 && !results[0].success())
+        {
+            // The service answers a batch it rejects, e.g. for a bad signature, with a single part.
+            return storage_outcome<blob_batch_response>(results[0].error());
+        }
+        storage_error missing;
+        missing.code = std::to_string(unknown_error);
+        missing.code_name = "BatchResponseMissing";
+        results.resize(count, storage_outcome<void>(missing));
+        blob_batch_response batch;
+        batch.results = std::move(results);
+        return storage_outcome<blob_batch_response>(std::move(batch));
+    });
+}
+
+std::future<storage_outcome<blob_batch_response>> blob_client::submit_batches(const std::vector<blob_batch_request_base::subrequest> &subrequests, int parallelism)
+{
+    const size_t batch_size = constants::max_batch_subrequests;
+    const int num_batches = int((subrequests.size() + batch_size - 1) / batch_size);
+    if (num_batches == 0)
+    {
+        std::promise<storage_outcome<blob_batch_response>> promise;
+        promise.set_value(storage_outcome<blob_batch_response>(blob_batch_response()));
+        return promise.get_future();
+    }
+
+    parallelism = std::max(1, std::min({ parallelism, int(concurrency()), num_batches }));
+
+    struct concurrent_task_info
+    {
+        std::vector<blob_batch_request_base::subrequest> subrequests;
+        int num_batches;
+    };
+    struct concurrent_task_context
+    {
+        std::atomic<int> num_workers{ 0 };
+        std::atomic<int> batch_index{ 0 };
+        blob_batch_response response;
+
+        std::promise<storage_outcome<blob_batch_response>> task_promise;
+        std::vector<std::future<void>> task_futures;
+    };
+    auto info = std::make_shared<concurrent_task_info>(concurrent_task_info{ subrequests, num_batches });
+    auto context = std::make_shared<concurrent_task_context>();
+    context->num_workers = parallelism;
+    context->response.results.resize(subrequests.size());
+
+    // Each worker holds a handle only while its batch is in flight, so the batches are pipelined over the handle pool.
+    auto thread_batch_func = [this, info, context]()
+    {
+        while (true)
+        {
+            int i = context->batch_index.fetch_add(1);
+            if (i >= info->num_batches)
+            {
+                break;
+            }
+            const auto first = info->subrequests.begin() + i * batch_size;
+            const auto last = info->subrequests.begin() + std::min((i + 1) * batch_size, info->subrequests.size());
+            auto result = submit_batch(std::vector<blob_batch_request_base::subrequest>(first, last)).get();
+
+            auto target = context->response.results.begin() + i * batch_size;
+            if (result.success())
+            {
+                std::copy(result.response().results.begin(), result.response().results.end(), target);
+            }
+            else
+            {
+                std::fill(target, target + (last - first), storage_outcome<void>(result.error()));
+            }
+        }
+        if (context->num_workers.fetch_sub(1) == 1)
+        {
+            // I'm the last worker thread
+            context->task_promise.set_value(storage_outcome<blob_batch_response>(std::move(context->response)));
+        }
+    };
+
+    for (int i = 0; i < parallelism; ++i)
+    {
+        context->task_futures.emplace_back(std::async(std::launch::async, thread_batch_func));
+    }
+
+    return context->task_promise.get_future();
+}
+
+std::future<storage_outcome<blob_batch_response>> blob_client::delete_blobs(const std::string &container, const std::vector<std::string> &blobs, bool delete_snapshots, int parallelism)
+{
+    std::vector<blob_batch_request_base::subrequest> subrequests;
+    subrequests.reserve(blobs.size());
+    for (const auto &blob : blobs)
+    {
+        // The same snapshot handling as delete_blob.
+        subrequests.emplace_back(blob_batch_request_base::subrequest{ blob_batch_request_base::operation::del, container, blob,
+            delete_snapshots ? delete_blob_request_base::delete_snapshots::only : delete_blob_request_base::delete_snapshots::include, access_tier::hot });
+    }
+    return submit_batches(subrequests, parallelism);
+}
+
+std::future<storage_outcome<blob_batch_response>> blob_client::set_blob_tiers(const std::string &container, const std::vector<std::string> &blobs, access_tier tier, int parallelism)
+{
+    std::vector<blob_batch_request_base::subrequest> subrequests;
+    subrequests.reserve(blobs.size());
+    for (const auto &blob : blobs)
+    {
+        subrequests.emplace_back(blob_batch_request_base::subrequest{ blob_batch_request_base::operation::set_tier, container, blob,
+            delete_blob_request_base::delete_snapshots::unspecified, tier });
+    }
+    return submit_batches(subrequests, parallelism);
+}
+
 std::future<storage_outcome<void>> blob_client::create_container(const std::string &container)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<create_container_request>(container);
 
@@ -358,7 +1031,7 @@ std::future<storage_outcome<void>> blob_client::create_container(const std::stri
 
 std::future<storage_outcome<void>> blob_client::delete_container(const std::string &container)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<delete_container_request>(container);
 
@@ -367,7 +1040,7 @@ std::future<storage_outcome<void>> blob_client::delete_container(const std::stri
 
 std::future<storage_outcome<container_property>> blob_client::get_container_properties(const std::string &container)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<get_container_property_request>(container);
 
@@ -400,7 +1073,7 @@ std::future<storage_outcome<container_property>> blob_client::get_container_prop
 
 std::future<storage_outcome<void>> blob_client::set_container_metadata(const std::string &container, const std::vector<std::pair<std::string, std::string>>& metadata)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<set_container_metadata_request>(container, metadata);
 
@@ -409,7 +1082,7 @@ std::future<storage_outcome<void>> blob_client::set_container_metadata(const std
 
 std::future<storage_outcome<list_containers_segmented_response>> blob_client::list_containers_segmented(const std::string &prefix, const std::string& continuation_token, const int max_result, bool include_metadata)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<list_containers_request>(prefix, include_metadata);
     request->set_maxresults(max_result);
@@ -420,7 +1093,7 @@ std::future<storage_outcome<list_containers_segmented_response>> blob_client::li
 
 std::future<storage_outcome<list_blobs_segmented_response>> blob_client::list_blobs_segmented(const std::string &container, const std::string &delimiter, const std::string &continuation_token, const std::string &prefix, int max_results)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<list_blobs_segmented_request>(container, delimiter, continuation_token, prefix);
     request->set_maxresults(max_results);
@@ -431,7 +1104,7 @@ std::future<storage_outcome<list_blobs_segmented_response>> blob_client::list_bl
 
 std::future<storage_outcome<get_block_list_response>> blob_client::get_block_list(const std::string &container, const std::string &blob)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<get_block_list_request>(container, blob);
 
@@ -440,7 +1113,7 @@ std::future<storage_outcome<get_block_list_response>> blob_client::get_block_lis
 
 std::future<storage_outcome<blob_property>> blob_client::get_blob_properties(const std::string &container, const std::string &blob)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<get_blob_property_request>(container, blob);
 
@@ -466,6 +1139,11 @@ std::future<storage_outcome<blob_property>> blob_client::get_blob_properties(con
             {
                 properties.size = std::stoull(contentLength, &sz, 0);
             }
+            const std::string &committedBlockCount = http->get_response_header(constants::header_ms_blob_committed_block_count);
+            if (committedBlockCount.length() > 0)
+            {
+                properties.committed_block_count = std::stoull(committedBlockCount, &sz, 0);
+            }
 
             auto& headers = http->get_response_headers();
             for (auto iter = headers.begin(); iter != headers.end(); ++iter)
@@ -488,7 +1166,7 @@ std::future<storage_outcome<blob_property>> blob_client::get_blob_properties(con
 
 std::future<storage_outcome<void>> blob_client::set_blob_metadata(const std::string &container, const std::string& blob, const std::vector<std::pair<std::string, std::string>>& metadata)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<set_blob_metadata_request>(container, blob, metadata);
 
@@ -497,7 +1175,7 @@ std::future<storage_outcome<void>> blob_client::set_blob_metadata(const std::str
 
 std::future<storage_outcome<void>> blob_client::upload_block_from_stream(const std::string &container, const std::string &blob, const std::string &blockid, std::istream &is)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_block_request>(container, blob, blockid);
 
@@ -514,7 +1192,7 @@ std::future<storage_outcome<void>> blob_client::upload_block_from_stream(const s
 
 std::future<storage_outcome<void>> blob_client::upload_block_from_stream(const std::string &container, const std::string &blob, const std::string &blockid, std::istream &is, uint64_t streamlen)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_block_request>(container, blob, blockid);
     request->set_content_length(static_cast<unsigned int>(streamlen));
@@ -528,7 +1206,7 @@ std::future<storage_outcome<void>> blob_client::upload_block_from_stream(const s
 
 std::future<storage_outcome<void>> blob_client::put_block_list(const std::string &container, const std::string &blob, const std::vector<put_block_list_request_base::block_item> &block_list, const std::vector<std::pair<std::string, std::string>> &metadata)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_block_list_request>(container, blob);
     request->set_block_list(block_list);
@@ -542,7 +1220,7 @@ std::future<storage_outcome<void>> blob_client::put_block_list(const std::string
 
 std::future<storage_outcome<void>> blob_client::create_append_blob(const std::string &container, const std::string &blob)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<create_append_blob_request>(container, blob);
 
@@ -551,7 +1229,7 @@ std::future<storage_outcome<void>> blob_client::create_append_blob(const std::st
 
 std::future<storage_outcome<void>> blob_client::append_block_from_stream(const std::string &container, const std::string &blob, std::istream &is)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<append_block_request>(container, blob);
 
@@ -566,9 +1244,23 @@ std::future<storage_outcome<void>> blob_client::append_block_from_stream(const s
     return async_executor<void>::submit(m_account, request, http, m_context);
 }
 
+std::future<storage_outcome<void>> blob_client::append_block_from_buffer(const std::string &container, const std::string &blob, const char* buffer, uint64_t bufferlen, unsigned long long append_position)
+{
+    auto http = get_handle();
+
+    auto request = std::make_shared<append_block_request>(container, blob);
+    request->set_content_length(static_cast<unsigned int>(bufferlen));
+    request->set_ms_blob_condition_appendpos(append_position);
+    set_transactional_checksum(*request, m_transfer_checksum, buffer, bufferlen);
+
+    http->set_input_buffer(storage_input_buffer(buffer, static_cast<size_t>(bufferlen)));
+
+    return async_executor<void>::submit(m_account, request, http, m_context);
+}
+
 std::future<storage_outcome<void>> blob_client::create_page_blob(const std::string &container, const std::string &blob, unsigned long long size)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<create_page_blob_request>(container, blob, size);
 
@@ -577,7 +1269,7 @@ std::future<storage_outcome<void>> blob_client::create_page_blob(const std::stri
 
 std::future<storage_outcome<void>> blob_client::put_page_from_stream(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::istream &is)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_page_request>(container, blob);
     if (size > 0)
@@ -604,7 +1296,7 @@ std::future<storage_outcome<void>> blob_client::put_page_from_stream(const std::
 
 std::future<storage_outcome<void>> blob_client::clear_page(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<put_page_request>(container, blob, true);
     if (size > 0)
@@ -622,9 +1314,28 @@ std::future<storage_outcome<void>> blob_client::clear_page(const std::string &co
 
 std::future<storage_outcome<get_page_ranges_response>> blob_client::get_page_ranges(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
+
+    auto request = std::make_shared<get_page_ranges_request>(container, blob);
+    if (size > 0)
+    {
+        request->set_start_byte(offset);
+        request->set_end_byte(offset + size - 1);
+    }
+    else
+    {
+        request->set_start_byte(offset);
+    }
+
+    return async_executor<get_page_ranges_response>::submit(m_account, request, http, m_context);
+}
+
+std::future<storage_outcome<get_page_ranges_response>> blob_client::get_page_ranges_diff(const std::string &container, const std::string &blob, const std::string &prev_snapshot, unsigned long long offset, unsigned long long size)
+{
+    auto http = get_handle();
 
     auto request = std::make_shared<get_page_ranges_request>(container, blob);
+    request->set_prevsnapshot(prev_snapshot);
     if (size > 0)
     {
         request->set_start_byte(offset);
@@ -638,9 +1349,195 @@ std::future<storage_outcome<get_page_ranges_response>> blob_client::get_page_ran
     return async_executor<get_page_ranges_response>::submit(m_account, request, http, m_context);
 }
 
+std::future<storage_outcome<void>> blob_client::put_page_from_buffer(const std::string &container, const std::string &blob, unsigned long long offset, const char* buffer, uint64_t bufferlen)
+{
+    auto http = get_handle();
+
+    auto request = std::make_shared<put_page_request>(container, blob);
+    request->set_start_byte(offset);
+    request->set_end_byte(offset + bufferlen - 1);
+    request->set_content_length(static_cast<unsigned int>(bufferlen));
+    set_transactional_checksum(*request, m_transfer_checksum, buffer, bufferlen);
+
+    http->set_input_buffer(storage_input_buffer(buffer, static_cast<size_t>(bufferlen)));
+
+    return async_executor<void>::submit(m_account, request, http, m_context);
+}
+
+std::future<storage_outcome<void>> blob_client::sync_page_blob_from_buffer(const std::string &container, const std::string &blob, const char* image, const char* base_image, uint64_t size, const std::string &prev_snapshot, int parallelism)
+{
+    const uint64_t page_size = 512;
+    const uint64_t segment_size = 4 * 1024 * 1024;
+
+    if (size % page_size != 0)
+    {
+        storage_error error;
+        error.code = std::to_string(invalid_parameters);
+        std::promise<storage_outcome<void>> promise;
+        promise.set_value(storage_outcome<void>(error));
+        return promise.get_future();
+    }
+
+    // Pages written or cleared in the blob since the previous snapshot no longer match the base image, so they are always re-synced.
+    std::vector<get_page_ranges_item> remote_changes;
+    if (!prev_snapshot.empty() && size > 0)
+    {
+        auto diff = get_page_ranges_diff(container, blob, prev_snapshot, 0, size).get();
+        if (!diff.success())
+        {
+            std::promise<storage_outcome<void>> promise;
+            promise.set_value(storage_outcome<void>(diff.error()));
+            return promise.get_future();
+        }
+        remote_changes = diff.response().pagelist;
+        remote_changes.insert(remote_changes.end(), diff.response().clearlist.begin(), diff.response().clearlist.end());
+        std::sort(remote_changes.begin(), remote_changes.end(), [](const get_page_ranges_item& a, const get_page_ranges_item& b) { return a.start < b.start; });
+    }
+
+    parallelism = std::max(1, std::min(parallelism, int(concurrency())));
+
+    struct concurrent_task_info
+    {
+        std::string container;
+        std::string blob;
+        const char* image;
+        const char* base_image;
+        uint64_t size;
+        uint64_t num_segments;
+        std::vector<get_page_ranges_item> remote_changes;
+    };
+    struct concurrent_task_context
+    {
+        std::atomic<int> num_workers{ 0 };
+        std::atomic<uint64_t> segment_index{ 0 };
+        std::atomic<bool> failed{ false };
+        storage_error failed_reason;
+
+        std::promise<storage_outcome<void>> task_promise;
+        std::vector<std::future<void>> task_futures;
+    };
+
+    auto info = std::make_shared<concurrent_task_info>(concurrent_task_info{ container, blob, image, base_image, size, (size + segment_size - 1) / segment_size, std::move(remote_changes) });
+    auto context = std::make_shared<concurrent_task_context>();
+    context->num_workers = parallelism;
+
+    auto thread_sync_func = [this, info, context, page_size, segment_size]()
+    {
+        static const char zero_page[512] = { 0 };
+
+        enum class page_action
+        {
+            skip,
+            update,
+            clear
+        };
+
+        std::vector<page_action> actions;
+        while (true)
+        {
+            uint64_t i = context->segment_index.fetch_add(1);
+            if (i >= info->num_segments || context->failed)
+            {
+                break;
+            }
+            const uint64_t segment_start = segment_size * i;
+            const uint64_t segment_end = std::min(segment_start + segment_size, info->size);
+            const size_t num_pages = size_t((segment_end - segment_start) / page_size);
+
+            // Mark the pages of this segment touched by remote changes.
+            std::vector<bool> forced(num_pages, false);
+            // Ranges never overlap, so both bounds of the sorted list are sorted as well.
+            auto range_begin = std::lower_bound(info->remote_changes.begin(), info->remote_changes.end(), segment_start, [](const get_page_ranges_item& item, uint64_t offset) { return item.end < offset; });
+            auto range_end = std::upper_bound(range_begin, info->remote_changes.end(), segment_end, [](uint64_t offset, const get_page_ranges_item& item) { return offset <= item.start; });
+            for (auto iter = range_begin; iter != range_end; ++iter)
+            {
+                uint64_t first = std::max<uint64_t>(iter->start, segment_start);
+                uint64_t last = std::min<uint64_t>(iter->end + 1, segment_end);
+                for (uint64_t offset = first - first % page_size; offset < last; offset += page_size)
+                {
+                    forced[size_t((offset - segment_start) / page_size)] = true;
+                }
+            }
+
+            actions.assign(num_pages, page_action::skip);
+            for (size_t p = 0; p < num_pages; ++p)
+            {
+                const uint64_t offset = segment_start + p * page_size;
+                const char* page = info->image + offset;
+                if (info->base_image == nullptr || forced[p] || std::memcmp(page, info->base_image + offset, page_size) != 0)
+                {
+                    actions[p] = std::memcmp(page, zero_page, page_size) == 0 ? page_action::clear : page_action::update;
+                }
+            }
+
+            // Coalesce runs of pages with the same action into single requests.
+            for (size_t p = 0; p < num_pages && !context->failed;)
+            {
+                size_t run_end = p + 1;
+                while (run_end < num_pages && actions[run_end] == actions[p])
+                {
+                    ++run_end;
+                }
+
+                const uint64_t offset = segment_start + p * page_size;
+                const uint64_t length = (run_end - p) * page_size;
+                storage_outcome<void> result;
+                if (actions[p] == page_action::update)
+                {
+                    result = put_page_from_buffer(info->container, info->blob, offset, info->image + offset, length).get();
+                }
+                else if (actions[p] == page_action::clear)
+                {
+                    result = clear_page(info->container, info->blob, offset, length).get();
+                }
+
+                if (!result.success() && !context->failed.exchange(true))
+                {
+                    context->failed_reason = result.error();
+                }
+                p = run_end;
+            }
+        }
+        if (context->num_workers.fetch_sub(1) == 1)
+        {
+            // I'm the last worker thread
+            context->task_promise.set_value(context->failed ? storage_outcome<void>(context->failed_reason) : storage_outcome<void>());
+        }
+    };
+
+    for (int i = 0; i < parallelism; ++i)
+    {
+        context->task_futures.emplace_back(std::async(std::launch::async, thread_sync_func));
+    }
+
+    return context->task_promise.get_future();
+}
+
+std::future<storage_outcome<std::string>> blob_client::create_snapshot(const std::string &container, const std::string &blob)
+{
+    auto http = get_handle();
+
+    auto request = std::make_shared<snapshot_blob_request>(container, blob);
+
+    std::shared_future<storage_outcome<void>> response = async_executor<void>::submit(m_account, request, http, m_context);
+
+    std::future<storage_outcome<std::string>> snapshot = std::async(std::launch::deferred, [http, response]()
+    {
+        if (response.get().success())
+        {
+            return storage_outcome<std::string>(http->get_response_header(constants::header_ms_snapshot));
+        }
+        else
+        {
+            return storage_outcome<std::string>(response.get().error());
+        }
+    });
+    return snapshot;
+}
+
 std::future<storage_outcome<void>> blob_client::start_copy(const std::string &sourceContainer, const std::string &sourceBlob, const std::string &destContainer, const std::string &destBlob)
 {
-    auto http = m_client->get_handle();
+    auto http = get_handle();
 
     auto request = std::make_shared<copy_blob_request>(sourceContainer, sourceBlob, destContainer, destBlob);
 
@@ -2,11 +2,18 @@
  * No exceptions will throw.
  */
 
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <set>
 
-#ifndef _WIN32
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "blob/blob_client.h"
@@ -60,6 +67,12 @@ namespace azure {  namespace storage_lite {
         };
         static mempool mpool;
         off_t get_file_size(const char* path);
+        std::string get_file_fingerprint(const char* path, long long block_size);
+        int open_file_for_read(const char* path);
+        void close_file(int fd);
+        void drop_cached_range(int fd, long long offset, long long length);
+
+        const char* const UPLOAD_CHECKPOINT_HEADER = "azure-storage-cpplite upload checkpoint v1";
 
         blob_client_wrapper blob_client_wrapper::blob_client_wrapper_init(const std::string &account_name, const std::string &account_key, const std::string &sas_token, const unsigned int concurrency)
         {
@@ -298,15 +311,11 @@ namespace azure {  namespace storage_lite {
                 return;
             }
 
-            std::ifstream ifs;
-            try
-            {
-                ifs.open(sourcePath, std::ifstream::in);
-            }
-            catch(std::exception& ex)
+            off_t fileSize = get_file_size(sourcePath.c_str());
+            const int fd = fileSize < 0 ? -1 : open_file_for_read(sourcePath.c_str());
+            if(fd < 0)
             {
-                // TODO open failed
-                logger::log(log_level::error, "Failure to open the input stream in put_blob.  ex.what() = %s, sourcePath = %s.", ex.what(), sourcePath.c_str());
+                logger::log(log_level::error, "Failure to open the source file in put_blob.  errno = %d, sourcePath = %s.", errno, sourcePath.c_str());
                 errno = unknown_error;
                 return;
             }
@@ -314,7 +323,7 @@ namespace azure {  namespace storage_lite {
             int error_code = 0;
             try
             {
-                auto task = m_blobClient->upload_block_blob_from_stream(container, blob, ifs, metadata);
+                auto task = m_blobClient->upload_block_blob_from_file(container, blob, fd, 0, static_cast<uint64_t>(fileSize), metadata);
                 auto result = task.get();
                 if(!result.success())
                 {
@@ -327,18 +336,11 @@ namespace azure {  namespace storage_lite {
                 error_code = unknown_error;
             }
 
-            try
-            {
-                ifs.close();
-            }
-            catch(std::exception& ex)
+            if (m_drop_cached_uploads)
             {
-                logger::log(log_level::error, "Failure to close the input stream in put_blob.  ex.what() = %s, container = %s, blob = %s, sourcePath = %s.", ex.what(), container.c_str(), blob.c_str(), sourcePath.c_str());
-                if (error_code == 0)
-                {
-                    error_code = unknown_error;
-                }
+                drop_cached_range(fd, 0, fileSize);
             }
+            close_file(fd);
             errno = error_code;
         }
 
@@ -382,7 +384,7 @@ namespace azure {  namespace storage_lite {
             }
         }
 
-        void blob_client_wrapper::upload_file_to_blob(const std::string &sourcePath, const std::string &container, const std::string blob, const std::vector<std::pair<std::string, std::string>> &metadata, size_t parallel)
+        void blob_client_wrapper::upload_file_to_blob(const std::string &sourcePath, const std::string &container, const std::string blob, const std::vector<std::pair<std::string, std::string>> &metadata, size_t parallel, const std::string &checkpointPath)
         {
             if(!is_valid())
             {
@@ -429,22 +431,98 @@ namespace azure {  namespace storage_lite {
                 block_size = min_block < MIN_UPLOAD_CHUNK_SIZE ? MIN_UPLOAD_CHUNK_SIZE : min_block;
             }
 
-            std::ifstream ifs(sourcePath, std::ios::in | std::ios::binary);
-            if(!ifs)
+            const int fd = open_file_for_read(sourcePath.c_str());
+            if(fd < 0)
             {
-                logger::log(log_level::error, "Failed to open the input stream in upload_file_to_blob.  errno = %d, sourcePath = %s.", errno, sourcePath.c_str());
+                logger::log(log_level::error, "Failed to open the source file in upload_file_to_blob.  errno = %d, sourcePath = %s.", errno, sourcePath.c_str());
                 errno = unknown_error;
                 return;
             }
 
+            // Block IDs only depend on the block index and the file, so a restarted upload stages the same IDs again.
+            const std::string fingerprint = get_file_fingerprint(sourcePath.c_str(), block_size);
+
+            // Blocks recorded in the checkpoint journal and still uncommitted on the service are not sent again.
+            std::set<long long> staged_blocks;
+            std::ofstream journal;
+            if(!checkpointPath.empty())
+            {
+                std::set<long long> journaled_blocks;
+                std::ifstream previous(checkpointPath);
+                std::string line;
+                if(previous && std::getline(previous, line) && line == UPLOAD_CHECKPOINT_HEADER && std::getline(previous, line) && line == container + "/" + blob + " " + fingerprint)
+                {
+                    long long staged_idx;
+                    while(previous >> staged_idx)
+                    {
+                        journaled_blocks.insert(staged_idx);
+                    }
+                }
+                previous.close();
+
+                if(!journaled_blocks.empty())
+                {
+                    const auto uncommitted = m_blobClient->get_block_list(container, blob).get();
+                    if(uncommitted.success())
+                    {
+                        for(const auto &item : uncommitted.response().uncommitted)
+                        {
+                            const auto decoded_block_id = from_base64(item.name);
+                            const std::string raw_block_id(decoded_block_id.begin(), decoded_block_id.end());
+                            const auto separator = raw_block_id.find('-');
+                            if(separator == std::string::npos || raw_block_id.substr(separator + 1) != fingerprint)
+                            {
+                                continue;
+                            }
+                            const long long staged_idx = std::stoll(raw_block_id.substr(0, separator));
+                            if(journaled_blocks.count(staged_idx) != 0 && static_cast<long long>(item.size) == std::min(block_size, fileSize - staged_idx * block_size))
+                            {
+                                staged_blocks.insert(staged_idx);
+                            }
+                        }
+                    }
+                }
+
+                journal.open(checkpointPath, std::ios::out | std::ios::trunc);
+                if(!journal)
+                {
+                    logger::log(log_level::error, "Failed to open the checkpoint journal in upload_file_to_blob.  checkpointPath = %s.", checkpointPath.c_str());
+                    close_file(fd);
+                    errno = unknown_error;
+                    return;
+                }
+                journal << UPLOAD_CHECKPOINT_HEADER << '\n' << container << "/" << blob << " " << fingerprint << '\n';
+                for(auto staged_idx : staged_blocks)
+                {
+                    journal << staged_idx << '\n';
+                }
+                journal.flush();
+            }
+
             std::vector<put_block_list_request_base::block_item> block_list;
             std::deque<std::future<int>> task_list;
             std::mutex mutex;
             std::condition_variable cv;
             std::mutex cv_mutex;
+            std::mutex journal_mutex;
 
             for(long long offset = 0, idx = 0; offset < fileSize; offset += block_size, ++idx)
             {
+                std::string raw_block_id = std::to_string(idx);
+                //pad the string to length of 12.
+                raw_block_id.insert(raw_block_id.begin(), 12 - raw_block_id.length(), '0');
+                const std::string block_id_un_base64 = raw_block_id + "-" + fingerprint;
+                const std::string block_id(to_base64(reinterpret_cast<const unsigned char*>(block_id_un_base64.c_str()), block_id_un_base64.size()));
+                put_block_list_request_base::block_item block;
+                block.id = block_id;
+                block.type = put_block_list_request_base::block_type::uncommitted;
+                block_list.push_back(block);
+
+                if(staged_blocks.count(idx) != 0)
+                {
+                    continue;
+                }
+
                 // control the number of submitted jobs.
                 while(task_list.size() > m_concurrency)
                 {
@@ -457,29 +535,9 @@ namespace azure {  namespace storage_lite {
                 if (0 != result) {
                     break;
                 }
-                size_t length = static_cast<size_t>(std::min(block_size, fileSize - offset));
-
-                char* buffer = (char*)malloc(static_cast<size_t>(block_size)); // This cast is save because block size should always be lower than 4GB
-                if (!buffer) {
-                    result = 12;
-                    break;
-                }
-                if(!ifs.read(buffer, length))
-                {
-                    logger::log(log_level::error, "Failed to read from input stream in upload_file_to_blob.  sourcePath = %s, container = %s, blob = %s, offset = %lld, length = %d.", sourcePath.c_str(), container.c_str(), blob.c_str(), offset, length);
-                    result = unknown_error;
-                    break;
-                }
-                std::string raw_block_id = std::to_string(idx);
-                //pad the string to length of 6.
-                raw_block_id.insert(raw_block_id.begin(), 12 - raw_block_id.length(), '0');
-                const std::string block_id_un_base64 = raw_block_id + get_uuid();
-                const std::string block_id(to_base64(reinterpret_cast<const unsigned char*>(block_id_un_base64.c_str()), block_id_un_base64.size()));
-                put_block_list_request_base::block_item block;
-                block.id = block_id;
-                block.type = put_block_list_request_base::block_type::uncommitted;
-                block_list.push_back(block);
-                auto single_put = std::async(std::launch::async, [block_id, this, buffer, length, &container, &blob, &parallel, &mutex, &cv_mutex, &cv](){
+                const long long length = std::min(block_size, fileSize - offset);
+                // Blocks are sent straight from the file with positional reads, no block sized buffer is staged in between.
+                auto single_put = std::async(std::launch::async, [block_id, idx, offset, length, fd, this, &container, &blob, &parallel, &mutex, &cv_mutex, &cv, &journal, &journal_mutex](){
                         {
                             std::unique_lock<std::mutex> lk(cv_mutex);
                             cv.wait(lk, [&parallel, &mutex]() {
@@ -493,8 +551,12 @@ namespace azure {  namespace storage_lite {
                                 });
                         }
 
-                        const auto blockResult = m_blobClient->upload_block_from_buffer(container, blob, block_id, buffer, length).get();
-                        free(buffer);
+                        const auto blockResult = m_blobClient->upload_block_from_file(container, blob, block_id, fd, offset, length).get();
+                        // The block is not read again, leave the page cache to data that is.
+                        if (m_drop_cached_uploads)
+                        {
+                            drop_cached_range(fd, offset, length);
+                        }
 
                         {
                             std::lock_guard<std::mutex> lock(mutex);
@@ -511,6 +573,12 @@ namespace azure {  namespace storage_lite {
                                 result = 503;
                             }
                         }
+                        else if(journal.is_open())
+                        {
+                            std::lock_guard<std::mutex> lock(journal_mutex);
+                            journal << idx << '\n';
+                            journal.flush();
+                        }
                         return result;
                     });
                 task_list.push_back(std::move(single_put));
@@ -538,7 +606,15 @@ namespace azure {  namespace storage_lite {
                 }
             }
 
-            ifs.close();
+            close_file(fd);
+            if(journal.is_open())
+            {
+                journal.close();
+                if(result == 0)
+                {
+                    remove(checkpointPath.c_str());
+                }
+            }
             errno = result;
         }
 
@@ -552,6 +628,71 @@ namespace azure {  namespace storage_lite {
             return -1;
         }
 
+        int open_file_for_read(const char* path)
+        {
+#ifdef _WIN32
+            return _open(path, _O_RDONLY | _O_BINARY);
+#else
+            return open(path, O_RDONLY | O_CLOEXEC);
+#endif
+        }
+
+        void close_file(int fd)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+
+        void drop_cached_range(int fd, long long offset, long long length)
+        {
+#ifdef POSIX_FADV_DONTNEED
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+#else
+            (void)fd;
+            (void)offset;
+            (void)length;
+#endif
+        }
+
+        std::string get_file_fingerprint(const char* path, long long block_size)
+        {
+            // FNV-1a over the file identity, size, modification and change times and the block size.
+            // Times are taken to the nanosecond where the platform has them, a rewrite within the same second still changes the fingerprint,
+            // and the change time also moves when the modification time is set back.
+            unsigned long long values[8] = { 0, 0, 0, 0, 0, 0, 0, static_cast<unsigned long long>(block_size) };
+            struct stat st;
+            if(stat(path, &st) == 0)
+            {
+                values[0] = static_cast<unsigned long long>(st.st_dev);
+                values[1] = static_cast<unsigned long long>(st.st_ino);
+                values[2] = static_cast<unsigned long long>(st.st_size);
+                values[3] = static_cast<unsigned long long>(st.st_mtime);
+                values[5] = static_cast<unsigned long long>(st.st_ctime);
+#if defined(__APPLE__)
+                values[4] = static_cast<unsigned long long>(st.st_mtimespec.tv_nsec);
+                values[6] = static_cast<unsigned long long>(st.st_ctimespec.tv_nsec);
+#elif !defined(_WIN32)
+                values[4] = static_cast<unsigned long long>(st.st_mtim.tv_nsec);
+                values[6] = static_cast<unsigned long long>(st.st_ctim.tv_nsec);
+#endif
+            }
+            unsigned long long hash = 14695981039346656037ULL;
+            for(auto value : values)
+            {
+                for(int i = 0; i < 8; ++i)
+                {
+                    hash ^= (value >> (i * 8)) & 0xff;
+                    hash *= 1099511628211ULL;
+                }
+            }
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", hash);
+            return std::string(hex);
+        }
+
         void blob_client_wrapper::download_blob_to_stream(const std::string &container, const std::string &blob, unsigned long long offset, unsigned long long size, std::ostream &os)
         {
             if(!is_valid())
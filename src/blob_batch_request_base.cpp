@@ -0,0 +1,337 @@
+#include "blob_batch_request_base.h"
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#include "compare.h"
+#include "constants.h"
+#include "storage_errno.h"
+#include "utility.h"
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Collects a sub-request as the credential signs it, it is written into the batch body instead of being sent.
+    class subrequest_http final : public http_base
+    {
+    public:
+        void set_method(http_method method) override { m_method = method; }
+
+        http_method get_method() const override { return m_method; }
+
+        void set_url(const std::string &url) override { m_url = url; }
+
+        std::string get_url() const override { return m_url; }
+
+        void add_header(const std::string &name, const std::string &value) override { m_headers[name] = value; }
+
+        const std::map<std::string, std::string, case_insensitive_compare>& get_request_headers() const override { return m_headers; }
+
+        const std::string &get_response_header(const std::string &) const override { return m_empty; }
+        const std::vector<std::pair<std::string, std::string>>& get_response_headers() const override { return m_response_headers; }
+
+        CURLcode perform() override { return CURLE_OK; }
+
+        void submit(std::function<void(http_code, storage_istream, CURLcode)>, std::chrono::seconds) override {}
+
+        void reset() override {}
+
+        http_code status_code() const override { return 0; }
+
+        void set_input_stream(storage_istream) override {}
+
+        void reset_input_stream() override {}
+
+        void reset_output_stream() override {}
+
+        void set_output_stream(storage_ostream) override {}
+
+        void set_error_stream(std::function<bool(http_code)>, storage_iostream) override {}
+
+        void set_input_buffer(storage_input_buffer) override {}
+
+        void set_output_buffer(storage_output_buffer) override {}
+
+        storage_istream get_input_stream() const override { return storage_istream(); }
+
+        storage_ostream get_output_stream() const override { return storage_ostream(); }
+
+        storage_iostream get_error_stream() const override { return storage_iostream(); }
+
+        void cancel() override {}
+
+        bool is_cancelled() const override { return false; }
+
+        void set_cancellation_token(cancellation_token) override {}
+
+        const cancellation_token &get_cancellation_token() const override { return m_token; }
+
+        void set_absolute_timeout(long long) override {}
+
+        void set_data_rate_timeout() override {}
+
+    private:
+        http_method m_method = http_method::get;
+        std::string m_url;
+        std::map<std::string, std::string, case_insensitive_compare> m_headers;
+        std::vector<std::pair<std::string, std::string>> m_response_headers;
+        std::string m_empty;
+        cancellation_token m_token = cancellation_token::none();
+    };
+
+    const char *get_access_tier(access_tier tier)
+    {
+        switch (tier)
+        {
+        case access_tier::cool:
+            return constants::header_value_access_tier_cool;
+        case access_tier::archive:
+            return constants::header_value_access_tier_archive;
+        default:
+            return constants::header_value_access_tier_hot;
+        }
+    }
+
+    // Gets the path and query of a url, which is what the request line of a sub-request holds.
+    std::string get_path_and_query(const std::string &url)
+    {
+        const size_t scheme_end = url.find("://");
+        const size_t path_start = url.find_first_of("/?", scheme_end == std::string::npos ? 0 : scheme_end + 3);
+        if (path_start == std::string::npos)
+        {
+            return "/";
+        }
+        return url[path_start] == '/' ? url.substr(path_start) : "/" + url.substr(path_start);
+    }
+
+    // Reads a line without its line break, the parts of a response are usually separated by CRLF but a bare LF is accepted.
+    bool read_line(const std::string &body, size_t &position, std::string &line)
+    {
+        if (position >= body.size())
+        {
+            return false;
+        }
+        size_t end = body.find('\n', position);
+        if (end == std::string::npos)
+        {
+            end = body.size();
+        }
+        line.assign(body, position, end - position);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        position = end + 1;
+        return true;
+    }
+
+    bool read_header(const std::string &line, std::string &name, std::string &value)
+    {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            return false;
+        }
+        name = line.substr(0, colon);
+        const size_t value_start = line.find_first_not_of(' ', colon + 1);
+        value = value_start == std::string::npos ? std::string() : line.substr(value_start);
+        return true;
+    }
+
+} // noname namespace
+
+    std::string blob_batch_request_base::build_body(const storage_account &a) const
+    {
+        const auto &r = *this;
+
+        // The batch request carries the version, the sub-requests are signed without it.
+        const std::string date = get_ms_date(date_format::rfc_1123);
+        const std::string delimiter = "--" + r.boundary();
+
+        std::string body;
+        const auto subrequests = r.subrequests();
+        for (size_t i = 0; i < subrequests.size(); ++i)
+        {
+            const auto &s = subrequests[i];
+            subrequest_http h;
+
+            storage_url url = a.get_url(storage_account::service::blob);
+            url.append_path(s.container).append_path(s.blob);
+
+            storage_headers headers;
+            if (s.type == operation::del)
+            {
+                h.set_method(http_base::http_method::del);
+                h.set_url(url.to_string());
+
+                switch (s.snapshots)
+                {
+                case delete_blob_request_base::delete_snapshots::only:
+                    add_ms_header(h, headers, constants::header_ms_delete_snapshots, constants::header_value_delete_snapshots_only);
+                    break;
+                case delete_blob_request_base::delete_snapshots::include:
+                    add_ms_header(h, headers, constants::header_ms_delete_snapshots, constants::header_value_delete_snapshots_include);
+                    break;
+                default:
+                    break;
+                }
+            }
+            else
+            {
+                h.set_method(http_base::http_method::put);
+                url.add_query(constants::query_comp, constants::query_comp_tier);
+                h.set_url(url.to_string());
+
+                add_ms_header(h, headers, constants::header_ms_access_tier, get_access_tier(s.tier));
+            }
+            add_content_length(h, headers, 0);
+            add_ms_header(h, headers, constants::header_ms_date, date);
+
+            a.credential()->sign_request(r, h, url, headers);
+
+            body.append(delimiter).append("\r\n");
+            body.append(constants::header_content_type).append(": ").append(constants::header_value_content_type_http).append("\r\n");
+            body.append(constants::header_content_transfer_encoding).append(": ").append(constants::header_value_content_transfer_encoding_binary).append("\r\n");
+            body.append(constants::header_content_id).append(": ").append(std::to_string(i)).append("\r\n");
+            body.append("\r\n");
+
+            body.append(get_http_verb(h.get_method())).append(" ").append(get_path_and_query(h.get_url())).append(" HTTP/1.1\r\n");
+            for (const auto &header : h.get_request_headers())
+            {
+                body.append(header.first).append(": ").append(header.second).append("\r\n");
+            }
+            body.append("\r\n");
+        }
+        body.append(delimiter).append("--\r\n");
+        return body;
+    }
+
+    void blob_batch_request_base::build_request(const storage_account &a, http_base &h) const
+    {
+        const auto &r = *this;
+
+        h.set_absolute_timeout(60L);
+
+        h.set_method(http_base::http_method::post);
+
+        storage_url url = a.get_url(storage_account::service::blob);
+        url.append_path("");
+
+        url.add_query(constants::query_comp, constants::query_comp_batch);
+        add_optional_query(url, constants::query_timeout, r.timeout());
+        h.set_url(url.to_string());
+
+        // Built on every attempt, so a retried batch is signed with a fresh date.
+        auto body = r.build_body(a);
+        const auto length = body.size();
+        auto ss = std::make_shared<std::stringstream>(std::move(body));
+        h.set_input_stream(storage_istream(ss));
+
+        storage_headers headers;
+        add_content_length(h, headers, length);
+        add_optional_content_type(h, headers, std::string(constants::header_value_content_type_multipart_mixed) + "; boundary=" + r.boundary());
+
+        add_ms_header(h, headers, constants::header_ms_client_request_id, r.ms_client_request_id(), true);
+
+        h.add_header(constants::header_user_agent, constants::header_value_user_agent);
+        add_ms_header(h, headers, constants::header_ms_date, get_ms_date(date_format::rfc_1123));
+        add_ms_header(h, headers, constants::header_ms_version, constants::header_value_storage_blob_version);
+
+        a.credential()->sign_request(r, h, url, headers);
+    }
+
+    blob_batch_response parse_blob_batch_response(const std::string &body)
+    {
+        blob_batch_response response;
+
+        size_t position = 0;
+        std::string line;
+        std::string delimiter;
+        while (read_line(body, position, line))
+        {
+            if (!line.empty())
+            {
+                delimiter = line;
+                break;
+            }
+        }
+        if (delimiter.compare(0, 2, "--") != 0)
+        {
+            return response;
+        }
+        const std::string close_delimiter = delimiter + "--";
+
+        std::string name;
+        std::string value;
+        bool more = true;
+        while (more)
+        {
+            size_t index = response.results.size();
+            while (read_line(body, position, line) && !line.empty())
+            {
+                if (read_header(line, name, value) && strcasecmp(name.c_str(), constants::header_content_id) == 0)
+                {
+                    // Parts are answered in order, the id only matters if the service reorders them.
+                    const size_t id = static_cast<size_t>(std::strtoul(value.c_str(), nullptr, 10));
+                    if (id < constants::max_batch_subrequests)
+                    {
+                        index = id;
+                    }
+                }
+            }
+
+            // HTTP/1.1 <status code> <reason phrase>
+            while (read_line(body, position, line) && line.empty()) {}
+            const size_t status_start = line.find(' ');
+            const size_t reason_start = status_start == std::string::npos ? std::string::npos : line.find(' ', status_start + 1);
+            const int status = status_start == std::string::npos ? 0 : std::atoi(line.c_str() + status_start + 1);
+            const std::string reason = reason_start == std::string::npos ? std::string() : line.substr(reason_start + 1);
+
+            std::string error_code;
+            while (read_line(body, position, line) && !line.empty())
+            {
+                if (read_header(line, name, value) && strcasecmp(name.c_str(), constants::header_ms_error_code) == 0)
+                {
+                    error_code = value;
+                }
+            }
+
+            more = false;
+            while (read_line(body, position, line))
+            {
+                if (line == delimiter)
+                {
+                    more = true;
+                    break;
+                }
+                if (line == close_delimiter)
+                {
+                    break;
+                }
+            }
+
+            storage_outcome<void> result;
+            if (status == 0 || unsuccessful(status))
+            {
+                storage_error error;
+                error.code = std::to_string(status == 0 ? unknown_error : status);
+                error.code_name = error_code;
+                error.message = reason;
+                result = storage_outcome<void>(error);
+            }
+
+            if (index >= response.results.size())
+            {
+                storage_error missing;
+                missing.code = std::to_string(unknown_error);
+                missing.code_name = "BatchResponseMissing";
+                response.results.resize(index + 1, storage_outcome<void>(missing));
+            }
+            response.results[index] = result;
+        }
+        return response;
+    }
+
+}}  // azure::storage_lite
@@ -0,0 +1,391 @@
+#include "checksum.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "base64.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <bcrypt.h>
+#else
+#ifdef USE_OPENSSL
+#include <openssl/evp.h>
+#else
+#include <gnutls/gnutls.h>
+#include <gnutls/crypto.h>
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AZURE_STORAGE_CRC64_PCLMUL
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Reflected form of the polynomial used by the x-ms-content-crc64 header.
+    const uint64_t crc64_polynomial = 0x9A6C9329AC4BC9B5ULL;
+
+    struct crc64_tables
+    {
+        uint64_t slice[8][256];
+
+        // Constants folding 128 bit lanes forward by 128 and 512 bits, x^n mod P bit-reflected.
+        uint64_t fold_128_low;
+        uint64_t fold_128_high;
+        uint64_t fold_512_low;
+        uint64_t fold_512_high;
+
+        crc64_tables()
+        {
+            for (uint64_t i = 0; i < 256; ++i)
+            {
+                uint64_t crc = i;
+                for (int j = 0; j < 8; ++j)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ crc64_polynomial : crc >> 1;
+                }
+                slice[0][i] = crc;
+            }
+            for (int i = 0; i < 256; ++i)
+            {
+                for (int j = 1; j < 8; ++j)
+                {
+                    slice[j][i] = (slice[j - 1][i] >> 8) ^ slice[0][slice[j - 1][i] & 0xff];
+                }
+            }
+
+            fold_128_low = x_pow_mod(128 + 63);
+            fold_128_high = x_pow_mod(127);
+            fold_512_low = x_pow_mod(512 + 63);
+            fold_512_high = x_pow_mod(512 - 1);
+        }
+
+        static uint64_t x_pow_mod(int n)
+        {
+            // In the reflected representation x^0 is the top bit and multiplying by x is a right shift.
+            uint64_t r = uint64_t(1) << 63;
+            for (int i = 0; i < n; ++i)
+            {
+                r = (r & 1) ? (r >> 1) ^ crc64_polynomial : r >> 1;
+            }
+            return r;
+        }
+    };
+
+    const crc64_tables &get_crc64_tables()
+    {
+        static const crc64_tables tables;
+        return tables;
+    }
+
+    uint64_t crc64_table(const unsigned char* p, size_t length, uint64_t crc)
+    {
+        const auto &t = get_crc64_tables().slice;
+        while (length >= 8)
+        {
+            // The data is consumed least significant byte first, as on a little-endian load.
+            uint64_t word = uint64_t(p[0]) | uint64_t(p[1]) << 8 | uint64_t(p[2]) << 16 | uint64_t(p[3]) << 24 |
+                uint64_t(p[4]) << 32 | uint64_t(p[5]) << 40 | uint64_t(p[6]) << 48 | uint64_t(p[7]) << 56;
+            crc ^= word;
+            crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff] ^ t[5][(crc >> 16) & 0xff] ^ t[4][(crc >> 24) & 0xff] ^
+                t[3][(crc >> 32) & 0xff] ^ t[2][(crc >> 40) & 0xff] ^ t[1][(crc >> 48) & 0xff] ^ t[0][crc >> 56];
+            p += 8;
+            length -= 8;
+        }
+        while (length-- > 0)
+        {
+            crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#ifdef AZURE_STORAGE_CRC64_PCLMUL
+#if defined(__GNUC__) || defined(__clang__)
+#define AZURE_STORAGE_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#define AZURE_STORAGE_TARGET_PCLMUL
+#endif
+
+    bool cpu_supports_pclmul()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#else
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 19)) != 0;
+#endif
+    }
+
+    AZURE_STORAGE_TARGET_PCLMUL inline __m128i fold(__m128i lane, __m128i constants, __m128i data)
+    {
+        // The lower 64 bits come first in the stream and move the furthest.
+        __m128i low = _mm_clmulepi64_si128(lane, constants, 0x00);
+        __m128i high = _mm_clmulepi64_si128(lane, constants, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(low, high), data);
+    }
+
+    AZURE_STORAGE_TARGET_PCLMUL uint64_t crc64_pclmul(const unsigned char* p, size_t length, uint64_t crc)
+    {
+        const auto &tables = get_crc64_tables();
+        if (length < 128)
+        {
+            return crc64_table(p, length, crc);
+        }
+
+        // A CRC register equals the CRC of the following data with the register folded into its first 8 bytes.
+        __m128i lanes[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+        }
+        lanes[0] = _mm_xor_si128(lanes[0], _mm_cvtsi64_si128(static_cast<long long>(crc)));
+        p += 64;
+        length -= 64;
+
+        const __m128i fold_512 = _mm_set_epi64x(static_cast<long long>(tables.fold_512_high), static_cast<long long>(tables.fold_512_low));
+        while (length >= 64)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                lanes[i] = fold(lanes[i], fold_512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16)));
+            }
+            p += 64;
+            length -= 64;
+        }
+
+        const __m128i fold_128 = _mm_set_epi64x(static_cast<long long>(tables.fold_128_high), static_cast<long long>(tables.fold_128_low));
+        __m128i lane = fold(lanes[0], fold_128, lanes[1]);
+        lane = fold(lane, fold_128, lanes[2]);
+        lane = fold(lane, fold_128, lanes[3]);
+        while (length >= 16)
+        {
+            lane = fold(lane, fold_128, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            p += 16;
+            length -= 16;
+        }
+
+        unsigned char remaining[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(remaining), lane);
+        crc = crc64_table(remaining, sizeof(remaining), 0);
+        return crc64_table(p, length, crc);
+    }
+#endif
+
+    using crc64_function = uint64_t(*)(const unsigned char*, size_t, uint64_t);
+
+    crc64_function select_crc64()
+    {
+#ifdef AZURE_STORAGE_CRC64_PCLMUL
+        if (cpu_supports_pclmul())
+        {
+            return crc64_pclmul;
+        }
+#endif
+        return crc64_table;
+    }
+
+} // noname namespace
+
+    uint64_t crc64(const char* data, size_t length, uint64_t crc)
+    {
+        static const crc64_function implementation = select_crc64();
+        return ~implementation(reinterpret_cast<const unsigned char*>(data), length, ~crc);
+    }
+
+    uint64_t crc64_portable(const char* data, size_t length, uint64_t crc)
+    {
+        return ~crc64_table(reinterpret_cast<const unsigned char*>(data), length, ~crc);
+    }
+
+    struct checksum_calculator::md5_context
+    {
+#ifdef _WIN32
+        BCRYPT_HASH_HANDLE handle = NULL;
+        std::vector<char> hash_object;
+#else
+#ifdef USE_OPENSSL
+        EVP_MD_CTX *ctx = nullptr;
+#else
+        gnutls_hash_hd_t handle = nullptr;
+#endif
+#endif
+
+        md5_context()
+        {
+            start();
+        }
+
+        ~md5_context()
+        {
+            stop();
+        }
+
+        void start()
+        {
+#ifdef _WIN32
+            static const BCRYPT_ALG_HANDLE md5_algorithm_handle = []() {
+                BCRYPT_ALG_HANDLE handle;
+                NTSTATUS status = BCryptOpenAlgorithmProvider(&handle, BCRYPT_MD5_ALGORITHM, NULL, BCRYPT_HASH_REUSABLE_FLAG);
+                if (status != 0)
+                {
+                    throw std::runtime_error("Cannot open CNG provider");
+                }
+                return handle;
+            }();
+            DWORD hash_object_size = 0;
+            DWORD output_size = 0;
+            BCryptGetProperty(md5_algorithm_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_size, sizeof(DWORD), &output_size, 0);
+            hash_object.resize(hash_object_size);
+            BCryptCreateHash(md5_algorithm_handle, &handle, (PUCHAR)hash_object.data(), hash_object_size, NULL, 0, 0);
+#else
+#ifdef USE_OPENSSL
+            ctx = EVP_MD_CTX_create();
+            EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
+#else
+            gnutls_hash_init(&handle, GNUTLS_DIG_MD5);
+#endif
+#endif
+        }
+
+        void stop()
+        {
+#ifdef _WIN32
+            if (handle != NULL)
+            {
+                BCryptDestroyHash(handle);
+                handle = NULL;
+            }
+#else
+#ifdef USE_OPENSSL
+            if (ctx != nullptr)
+            {
+                EVP_MD_CTX_destroy(ctx);
+                ctx = nullptr;
+            }
+#else
+            if (handle != nullptr)
+            {
+                gnutls_hash_deinit(handle, NULL);
+                handle = nullptr;
+            }
+#endif
+#endif
+        }
+
+        void update(const char* data, size_t length)
+        {
+#ifdef _WIN32
+            BCryptHashData(handle, (PUCHAR)data, (ULONG)length, 0);
+#else
+#ifdef USE_OPENSSL
+            EVP_DigestUpdate(ctx, data, length);
+#else
+            gnutls_hash(handle, data, length);
+#endif
+#endif
+        }
+
+        std::vector<unsigned char> digest() const
+        {
+            unsigned char digest[16];
+#ifdef _WIN32
+            BCRYPT_HASH_HANDLE copy;
+            std::vector<char> copy_object(hash_object.size());
+            BCryptDuplicateHash(handle, &copy, (PUCHAR)copy_object.data(), (ULONG)copy_object.size(), 0);
+            BCryptFinishHash(copy, digest, sizeof(digest), 0);
+            BCryptDestroyHash(copy);
+#else
+#ifdef USE_OPENSSL
+            EVP_MD_CTX *copy = EVP_MD_CTX_create();
+            EVP_MD_CTX_copy_ex(copy, ctx);
+            unsigned int digest_length = sizeof(digest);
+            EVP_DigestFinal_ex(copy, digest, &digest_length);
+            EVP_MD_CTX_destroy(copy);
+#else
+            gnutls_hash_hd_t copy = gnutls_hash_copy(handle);
+            gnutls_hash_deinit(copy, digest);
+#endif
+#endif
+            return std::vector<unsigned char>(digest, digest + sizeof(digest));
+        }
+    };
+
+    checksum_calculator::checksum_calculator(checksum_type type)
+        : m_type(type),
+        m_crc64(0)
+    {
+        if (m_type == checksum_type::md5)
+        {
+            m_md5.reset(new md5_context());
+        }
+    }
+
+    checksum_calculator::~checksum_calculator()
+    {
+    }
+
+    void checksum_calculator::update(const char* data, size_t length)
+    {
+        switch (m_type)
+        {
+        case checksum_type::md5:
+            m_md5->update(data, length);
+            break;
+        case checksum_type::crc64:
+            m_crc64 = crc64(data, length, m_crc64);
+            break;
+        case checksum_type::none:
+            break;
+        }
+    }
+
+    void checksum_calculator::reset()
+    {
+        m_crc64 = 0;
+        if (m_md5)
+        {
+            m_md5->stop();
+            m_md5->start();
+        }
+    }
+
+    std::string checksum_calculator::value() const
+    {
+        switch (m_type)
+        {
+        case checksum_type::md5:
+            return to_base64(m_md5->digest());
+        case checksum_type::crc64:
+        {
+            // The header carries the CRC in little-endian byte order.
+            std::vector<unsigned char> bytes(8);
+            for (int i = 0; i < 8; ++i)
+            {
+                bytes[i] = static_cast<unsigned char>(m_crc64 >> (8 * i));
+            }
+            return to_base64(bytes);
+        }
+        case checksum_type::none:
+            break;
+        }
+        return std::string();
+    }
+
+    std::string checksum_calculator::compute(checksum_type type, const char* data, size_t length)
+    {
+        checksum_calculator calculator(type);
+        calculator.update(data, length);
+        return calculator.value();
+    }
+
+}}  // azure::storage_lite
@@ -0,0 +1,137 @@
+#include "circuit_breaker.h"
+
+#include <algorithm>
+
+namespace azure {  namespace storage_lite {
+
+    const int circuit_breaker::bucket_count;
+
+    circuit_breaker::circuit_breaker(double failure_ratio, int min_requests, std::chrono::milliseconds window, std::chrono::milliseconds open_duration, int half_open_probes)
+        : m_failure_ratio(std::min(std::max(failure_ratio, 0.0), 1.0)),
+        m_min_requests(std::max(min_requests, 1)),
+        m_bucket_width(std::max<std::chrono::steady_clock::duration>(window / bucket_count, std::chrono::milliseconds(1))),
+        m_open_duration(open_duration),
+        m_half_open_probes(std::max(half_open_probes, 1))
+    {
+    }
+
+    circuit_breaker::admission circuit_breaker::allow(const std::string &endpoint)
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        auto &s = m_endpoints[endpoint];
+        admission a;
+        if (s.current == state::open)
+        {
+            if (std::chrono::steady_clock::now() - s.opened_at < m_open_duration)
+            {
+                return a;
+            }
+            s.current = state::half_open;
+            ++s.generation;
+            s.probes_in_flight = 0;
+            s.probe_successes = 0;
+        }
+        if (s.current == state::half_open)
+        {
+            if (s.probes_in_flight >= m_half_open_probes)
+            {
+                return a;
+            }
+            ++s.probes_in_flight;
+            a.probe = true;
+        }
+        a.allowed = true;
+        a.generation = s.generation;
+        return a;
+    }
+
+    void circuit_breaker::record(const std::string &endpoint, const admission &a, result r)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lg(m_mutex);
+        auto &s = m_endpoints[endpoint];
+        if (!a.allowed || a.generation != s.generation)
+        {
+            // Let through before the circuit last changed state, e.g. sent while closed and finishing after the circuit opened.
+            return;
+        }
+        if (a.probe)
+        {
+            s.probes_in_flight = std::max(s.probes_in_flight - 1, 0);
+            if (r == result::failure)
+            {
+                open(s, now);
+            }
+            else if (r == result::success && ++s.probe_successes >= m_half_open_probes)
+            {
+                close(s);
+            }
+            return;
+        }
+        if (r == result::neutral)
+        {
+            return;
+        }
+
+        const int64_t index = (now.time_since_epoch() / m_bucket_width);
+        auto &b = s.buckets[index % bucket_count];
+        if (b.index != index)
+        {
+            b = bucket();
+            b.index = index;
+        }
+        if (r == result::success)
+        {
+            ++b.successes;
+            return;
+        }
+        ++b.failures;
+
+        int successes = 0;
+        int failures = 0;
+        for (const auto &other : s.buckets)
+        {
+            if (other.index > index - bucket_count)
+            {
+                successes += other.successes;
+                failures += other.failures;
+            }
+        }
+        const int total = successes + failures;
+        if (total >= m_min_requests && failures >= m_failure_ratio * total)
+        {
+            open(s, now);
+        }
+    }
+
+    circuit_breaker::state circuit_breaker::get_state(const std::string &endpoint) const
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        auto iter = m_endpoints.find(endpoint);
+        return iter == m_endpoints.end() ? state::closed : iter->second.current;
+    }
+
+    std::string circuit_breaker::endpoint_of(const std::string &url)
+    {
+        auto begin = url.find("://");
+        begin = begin == std::string::npos ? 0 : begin + 3;
+        return url.substr(0, url.find_first_of("/?#", begin));
+    }
+
+    void circuit_breaker::open(endpoint_state &endpoint, std::chrono::steady_clock::time_point now)
+    {
+        const uint64_t generation = endpoint.generation + 1;
+        endpoint = endpoint_state();
+        endpoint.current = state::open;
+        endpoint.generation = generation;
+        endpoint.opened_at = now;
+    }
+
+    void circuit_breaker::close(endpoint_state &endpoint)
+    {
+        const uint64_t generation = endpoint.generation + 1;
+        endpoint = endpoint_state();
+        endpoint.generation = generation;
+    }
+
+}}  // azure::storage_lite
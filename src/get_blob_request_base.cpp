@@ -33,6 +33,10 @@ namespace azure {  namespace storage_lite {
             // TODO check range
             add_ms_header(h, headers, constants::header_ms_range_get_content_md5, "true");
         }
+        if (r.ms_range_get_content_crc64())
+        {
+            add_ms_header(h, headers, constants::header_ms_range_get_content_crc64, "true");
+        }
 
         h.add_header(constants::header_user_agent, constants::header_value_user_agent);
         add_ms_header(h, headers, constants::header_ms_date, get_ms_date(date_format::rfc_1123));
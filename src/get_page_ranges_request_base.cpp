@@ -17,6 +17,7 @@ namespace azure {  namespace storage_lite {
 
         url.add_query(constants::query_comp, constants::query_comp_pagelist);
         add_optional_query(url, constants::query_snapshot, r.snapshot());
+        add_optional_query(url, constants::query_prevsnapshot, r.prevsnapshot());
         add_optional_query(url, constants::query_timeout, r.timeout());
         h.set_url(url.to_string());
 
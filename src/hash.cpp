@@ -7,7 +7,7 @@
 #include <bcrypt.h>
 #else
 #ifdef USE_OPENSSL
-#include <openssl/hmac.h>
+#include <openssl/evp.h>
 #else
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
@@ -17,13 +17,18 @@
 
 namespace azure {  namespace storage_lite {
     std::string hash(const std::string &to_sign, const std::vector<unsigned char> &key)
+    {
+        return hmac_sha256_signer(key).sign(to_sign);
+    }
+
+    std::vector<unsigned char> sha256(const char* data, size_t length)
     {
         unsigned int digest_length = SHA256_DIGEST_LENGTH;
         unsigned char digest[SHA256_DIGEST_LENGTH];
 #ifdef _WIN32
-        static const BCRYPT_ALG_HANDLE hmac_sha256_algorithm_handle = []() {
+        static const BCRYPT_ALG_HANDLE sha256_algorithm_handle = []() {
             BCRYPT_ALG_HANDLE handle;
-            NTSTATUS status = BCryptOpenAlgorithmProvider(&handle, BCRYPT_SHA256_ALGORITHM, NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG);
+            NTSTATUS status = BCryptOpenAlgorithmProvider(&handle, BCRYPT_SHA256_ALGORITHM, NULL, 0);
             if (status != 0)
             {
                 throw std::runtime_error("Cannot open CNG provider");
@@ -33,35 +38,151 @@ namespace azure {  namespace storage_lite {
 
         DWORD hash_object_size = 0;
         DWORD output_size = 0;
-        BCryptGetProperty(hmac_sha256_algorithm_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_size, sizeof(DWORD), &output_size, 0);
+        BCryptGetProperty(sha256_algorithm_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_size, sizeof(DWORD), &output_size, 0);
 
         HANDLE hash_handle;
         std::vector<char> hash_object(hash_object_size);
-        BCryptCreateHash(hmac_sha256_algorithm_handle, &hash_handle, (PUCHAR)hash_object.data(), hash_object_size, (PUCHAR)key.data(), (ULONG)key.size(), 0);
-        BCryptHashData(hash_handle, (PUCHAR)to_sign.data(), (ULONG)to_sign.length(), 0);
+        BCryptCreateHash(sha256_algorithm_handle, &hash_handle, (PUCHAR)hash_object.data(), hash_object_size, NULL, 0, 0);
+        BCryptHashData(hash_handle, (PUCHAR)data, (ULONG)length, 0);
         BCryptFinishHash(hash_handle, digest, digest_length, 0);
         BCryptDestroyHash(hash_handle);
 #else
 #ifdef USE_OPENSSL
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-        HMAC_CTX ctx;
-        HMAC_CTX_init(&ctx);
-        HMAC_Init_ex(&ctx, key.data(), static_cast<int>(key.size()), EVP_sha256(), NULL);
-        HMAC_Update(&ctx, (const unsigned char*)to_sign.c_str(), to_sign.size());
-        HMAC_Final(&ctx, digest, &digest_length);
-        HMAC_CTX_cleanup(&ctx);
+        EVP_Digest(data, length, digest, &digest_length, EVP_sha256(), NULL);
+#else
+        gnutls_hash_fast(GNUTLS_DIG_SHA256, data, length, digest);
+#endif
+#endif
+        return std::vector<unsigned char>(digest, digest + digest_length);
+    }
+    struct hmac_sha256_signer::keyed_state
+    {
+#ifdef _WIN32
+        BCRYPT_HASH_HANDLE handle = NULL;
+        std::vector<char> hash_object;
+
+        ~keyed_state()
+        {
+            if (handle != NULL)
+            {
+                BCryptDestroyHash(handle);
+            }
+        }
+#else
+#ifdef USE_OPENSSL
+        // HMAC is H((K ^ opad) || H((K ^ ipad) || m)), these hold the digests after absorbing each padded key block.
+        EVP_MD_CTX *inner = nullptr;
+        EVP_MD_CTX *outer = nullptr;
+
+        ~keyed_state()
+        {
+            EVP_MD_CTX_destroy(inner);
+            EVP_MD_CTX_destroy(outer);
+        }
 #else
-        HMAC_CTX * ctx = HMAC_CTX_new();
-        HMAC_CTX_reset(ctx);
-        HMAC_Init_ex(ctx, key.data(), static_cast<int>(key.size()), EVP_sha256(), NULL);
-        HMAC_Update(ctx, (const unsigned char*)to_sign.c_str(), to_sign.size());
-        HMAC_Final(ctx, digest, &digest_length);
-        HMAC_CTX_free(ctx);
+        gnutls_hmac_hd_t handle = nullptr;
+
+        ~keyed_state()
+        {
+            if (handle != nullptr)
+            {
+                gnutls_hmac_deinit(handle, NULL);
+            }
+        }
+#endif
+#endif
+    };
+
+namespace {
+#if !defined(_WIN32) && defined(USE_OPENSSL)
+    const size_t sha256_block_size = 64;
+
+    // A digest context per thread, so signing copies the keyed state instead of allocating one.
+    struct scratch_digest
+    {
+        EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+
+        ~scratch_digest()
+        {
+            EVP_MD_CTX_destroy(ctx);
+        }
+    };
+
+    EVP_MD_CTX *create_keyed_digest(const std::vector<unsigned char> &key, unsigned char pad)
+    {
+        unsigned char block[sha256_block_size];
+        for (size_t i = 0; i < sha256_block_size; ++i)
+        {
+            block[i] = static_cast<unsigned char>((i < key.size() ? key[i] : 0) ^ pad);
+        }
+        EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+        EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+        EVP_DigestUpdate(ctx, block, sizeof(block));
+        return ctx;
+    }
 #endif
+} // noname namespace
+
+    hmac_sha256_signer::hmac_sha256_signer(const std::vector<unsigned char> &key)
+    {
+        auto state = std::make_shared<keyed_state>();
+#ifdef _WIN32
+        static const BCRYPT_ALG_HANDLE hmac_sha256_algorithm_handle = []() {
+            BCRYPT_ALG_HANDLE handle;
+            NTSTATUS status = BCryptOpenAlgorithmProvider(&handle, BCRYPT_SHA256_ALGORITHM, NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG);
+            if (status != 0)
+            {
+                throw std::runtime_error("Cannot open CNG provider");
+            }
+            return handle;
+        }();
+
+        DWORD hash_object_size = 0;
+        DWORD output_size = 0;
+        BCryptGetProperty(hmac_sha256_algorithm_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_size, sizeof(DWORD), &output_size, 0);
+        state->hash_object.resize(hash_object_size);
+        BCryptCreateHash(hmac_sha256_algorithm_handle, &state->handle, (PUCHAR)state->hash_object.data(), hash_object_size, (PUCHAR)key.data(), (ULONG)key.size(), 0);
+#else
+#ifdef USE_OPENSSL
+        // Keys longer than a block are hashed first.
+        const std::vector<unsigned char> block_key = key.size() > sha256_block_size ? sha256(reinterpret_cast<const char*>(key.data()), key.size()) : key;
+        state->inner = create_keyed_digest(block_key, 0x36);
+        state->outer = create_keyed_digest(block_key, 0x5c);
+#else
+        gnutls_hmac_init(&state->handle, GNUTLS_MAC_SHA256, key.data(), key.size());
+#endif
+#endif
+        m_state = std::move(state);
+    }
+
+    std::string hmac_sha256_signer::sign(const char* data, size_t length) const
+    {
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+#ifdef _WIN32
+        thread_local std::vector<char> copy_object;
+        copy_object.resize(m_state->hash_object.size());
+        BCRYPT_HASH_HANDLE copy;
+        BCryptDuplicateHash(m_state->handle, &copy, (PUCHAR)copy_object.data(), (ULONG)copy_object.size(), 0);
+        BCryptHashData(copy, (PUCHAR)data, (ULONG)length, 0);
+        BCryptFinishHash(copy, digest, sizeof(digest), 0);
+        BCryptDestroyHash(copy);
+#else
+#ifdef USE_OPENSSL
+        thread_local scratch_digest scratch;
+        unsigned char inner_digest[SHA256_DIGEST_LENGTH];
+        unsigned int digest_length = SHA256_DIGEST_LENGTH;
+        EVP_MD_CTX_copy_ex(scratch.ctx, m_state->inner);
+        EVP_DigestUpdate(scratch.ctx, data, length);
+        EVP_DigestFinal_ex(scratch.ctx, inner_digest, &digest_length);
+        EVP_MD_CTX_copy_ex(scratch.ctx, m_state->outer);
+        EVP_DigestUpdate(scratch.ctx, inner_digest, sizeof(inner_digest));
+        EVP_DigestFinal_ex(scratch.ctx, digest, &digest_length);
 #else
-        gnutls_hmac_fast(GNUTLS_MAC_SHA256, key.data(), key.size(), (const unsigned char *)to_sign.data(), to_sign.size(), digest);
+        gnutls_hmac_hd_t copy = gnutls_hmac_copy(m_state->handle);
+        gnutls_hmac(copy, data, length);
+        gnutls_hmac_deinit(copy, digest);
 #endif
 #endif
-        return to_base64(std::vector<unsigned char>(digest, digest + digest_length));
+        return to_base64(digest, sizeof(digest));
     }
 }}  // azure::storage_lite
@@ -0,0 +1,74 @@
+#include "hedging.h"
+
+#include <algorithm>
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Latencies of the most recent reads the delay is derived from.
+    const size_t latency_window = 256;
+
+    // Fewer latencies than this do not give a meaningful percentile.
+    const size_t min_latencies = 16;
+
+    // Hedges that can be saved up by a run of quick reads.
+    const double max_budget = 10.0;
+
+} // noname namespace
+
+    hedging_policy::hedging_policy(double percentile, double max_hedge_ratio, uint64_t max_read_size, std::chrono::milliseconds min_delay, std::chrono::milliseconds max_delay)
+        : m_percentile(std::min(std::max(percentile, 0.0), 1.0)),
+        m_max_hedge_ratio(std::max(max_hedge_ratio, 0.0)),
+        m_max_read_size(max_read_size),
+        m_min_delay(min_delay),
+        m_max_delay(std::max(max_delay, min_delay)),
+        m_next_latency(0),
+        m_budget(0.0)
+    {
+        m_latencies.reserve(latency_window);
+    }
+
+    std::chrono::microseconds hedging_policy::delay() const
+    {
+        std::vector<int64_t> latencies;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_latencies.size() < min_latencies)
+            {
+                return m_max_delay;
+            }
+            latencies = m_latencies;
+        }
+        const auto nth = latencies.begin() + static_cast<ptrdiff_t>(m_percentile * (latencies.size() - 1));
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return std::min(std::max(std::chrono::microseconds(*nth), m_min_delay), m_max_delay);
+    }
+
+    void hedging_policy::record(std::chrono::microseconds latency)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_latencies.size() < latency_window)
+        {
+            m_latencies.push_back(latency.count());
+        }
+        else
+        {
+            m_latencies[m_next_latency] = latency.count();
+            m_next_latency = (m_next_latency + 1) % latency_window;
+        }
+        m_budget = std::min(m_budget + m_max_hedge_ratio, max_budget);
+    }
+
+    bool hedging_policy::try_hedge()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_budget < 1.0)
+        {
+            return false;
+        }
+        m_budget -= 1.0;
+        return true;
+    }
+
+}}  // azure::storage_lite
@@ -1,30 +1,241 @@
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 #include "http/libcurl_http_client.h"
 
 #include "constants.h"
+#include "utility.h"
 
 namespace azure { namespace storage_lite {
 
-        CurlEasyRequest::CurlEasyRequest(std::shared_ptr<CurlEasyClient> client, CURL *h)
-            : m_client(client), m_curl(h), m_slist(NULL)
+namespace {
+
+    // Shares of freed handles given to waiting interactive, normal and bulk requests.
+    const int priority_weights[] = { 8, 4, 1 };
+
+    const char *const known_response_header_names[] = {
+        constants::header_cache_control,
+        constants::header_content_disposition,
+        constants::header_content_encoding,
+        constants::header_content_language,
+        constants::header_content_length,
+        constants::header_content_md5,
+        constants::header_content_range,
+        constants::header_content_type,
+        constants::header_etag,
+        constants::header_last_modified,
+        constants::header_ms_acl,
+        constants::header_ms_blob_committed_block_count,
+        constants::header_ms_blob_sequence_number,
+        constants::header_ms_blob_type,
+        constants::header_ms_content_crc64,
+        constants::header_ms_continuation,
+        constants::header_ms_copy_status,
+        constants::header_ms_group,
+        constants::header_ms_lease_id,
+        constants::header_ms_owner,
+        constants::header_ms_permissions,
+        constants::header_ms_snapshot,
+    };
+    const size_t known_response_header_count = sizeof(known_response_header_names) / sizeof(known_response_header_names[0]);
+
+    // The response headers the library reads, located through a perfect hash instead of string comparisons against every header.
+    class known_response_headers
+    {
+    public:
+        known_response_headers()
         {
-            check_code(curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, header_callback));
-            check_code(curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, this));
+            // Search for a seed that leaves no two names in the same slot.
+            for (m_seed = 0;; ++m_seed)
+            {
+                m_slots.fill(-1);
+                bool perfect = true;
+                for (int i = 0; perfect && i < static_cast<int>(known_response_header_count); ++i)
+                {
+                    auto &slot = m_slots[hash(known_response_header_names[i], std::strlen(known_response_header_names[i])) % m_slots.size()];
+                    perfect = slot < 0;
+                    slot = static_cast<signed char>(i);
+                }
+                if (perfect)
+                {
+                    break;
+                }
+            }
+        }
+
+        int find(const char *name, size_t length) const
+        {
+            const int index = m_slots[hash(name, length) % m_slots.size()];
+            if (index >= 0 && std::strlen(known_response_header_names[index]) == length && strncasecmp(known_response_header_names[index], name, length) == 0)
+            {
+                return index;
+            }
+            return -1;
+        }
+
+    private:
+        uint32_t hash(const char *name, size_t length) const
+        {
+            // FNV-1a over the lowercase name.
+            uint32_t h = 2166136261u ^ m_seed;
+            for (size_t i = 0; i < length; ++i)
+            {
+                h = (h ^ static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(name[i])))) * 16777619u;
+            }
+            return h;
+        }
+
+        uint32_t m_seed;
+        std::array<signed char, 128> m_slots;
+    };
+
+
+    const known_response_headers &get_known_response_headers()
+    {
+        static const known_response_headers headers;
+        return headers;
+    }
+
+    // The size of the body sent, or of the range asked for, 0 when unknown.
+    uint64_t get_payload_size(const std::map<std::string, std::string, case_insensitive_compare> &headers)
+    {
+        auto header = headers.find(constants::header_content_length);
+        if (header != headers.end())
+        {
+            return std::strtoull(header->second.data(), nullptr, 10);
+        }
+        header = headers.find(constants::header_ms_range);
+        if (header != headers.end())
+        {
+            // bytes=first-last, an open range has no known size.
+            const auto equals = header->second.find('=');
+            const auto dash = header->second.find('-', equals);
+            if (equals != std::string::npos && dash != std::string::npos && dash + 1 < header->second.size())
+            {
+                const uint64_t first = std::strtoull(header->second.data() + equals + 1, nullptr, 10);
+                const uint64_t last = std::strtoull(header->second.data() + dash + 1, nullptr, 10);
+                return last >= first ? last - first + 1 : 0;
+            }
+        }
+        return 0;
+    }
+
+    // The kind of request latencies are kept for, the method along with the comp and restype query parameters.
+    std::string get_operation(http_base::http_method method, const std::string &url)
+    {
+        std::string operation = get_http_verb(method);
+        size_t start = url.find('?');
+        while (start != std::string::npos)
+        {
+            ++start;
+            const size_t end = url.find('&', start);
+            const std::string parameter = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (parameter.compare(0, std::strlen(constants::query_comp) + 1, std::string(constants::query_comp) + "=") == 0
+                || parameter.compare(0, std::strlen(constants::query_restype) + 1, std::string(constants::query_restype) + "=") == 0)
+            {
+                operation.append(" ").append(parameter);
+            }
+            start = end;
+        }
+        return operation;
+    }
+
+} // noname namespace
+
+        CurlEasyRequest::CurlEasyRequest(std::shared_ptr<CurlEasyClient> client, CURL *h, std::chrono::steady_clock::time_point last_used, request_priority priority)
+            : m_client(client), m_curl(h), m_last_used(last_used), m_priority(priority), m_slist(NULL)
+        {
+            static_assert(known_response_header_count <= std::tuple_size<decltype(m_known_response_headers)>::value, "every known response header needs a slot");
+            m_known_response_headers.fill(-1);
+            bind_handle();
         }
 
         CurlEasyRequest::~CurlEasyRequest()
         {
-            curl_easy_reset(m_curl);
-            m_client->release_handle(m_curl);
+            suspend();
             if (m_slist) {
                 curl_slist_free_all(m_slist);
             }
         }
 
+        void CurlEasyRequest::suspend()
+        {
+            if (m_curl)
+            {
+                curl_easy_reset(m_curl);
+                m_client->release_handle(m_curl, std::chrono::steady_clock::now() - m_acquired_at);
+                m_curl = nullptr;
+            }
+        }
+
+        void CurlEasyRequest::resume()
+        {
+            if (!m_curl)
+            {
+                const auto h = m_client->acquire(m_priority);
+                m_curl = h.handle;
+                m_last_used = h.released;
+                m_acquired_at = std::chrono::steady_clock::now();
+                bind_handle();
+            }
+        }
+
+        void CurlEasyRequest::bind_handle()
+        {
+            check_code(curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, header_callback));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, this));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_XFERINFOFUNCTION, progress));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_XFERINFODATA, this));
+            check_code(curl_easy_setopt(m_curl, CURLOPT_NOPROGRESS, 0L));
+            // Blocks and ranges run to megabytes, larger transfer buffers mean fewer read and write callbacks per request.
+#if LIBCURL_VERSION_NUM >= 0x073E00
+            check_code(curl_easy_setopt(m_curl, CURLOPT_UPLOAD_BUFFERSIZE, 2L * 1024 * 1024));
+#endif
+
+            // What the setters put on the previous handle of a resumed request.
+            if (m_data_rate_timeout)
+            {
+                set_data_rate_timeout();
+            }
+            else if (m_absolute_timeout > 0)
+            {
+                set_absolute_timeout(m_absolute_timeout);
+            }
+            const auto length = m_request_headers.find(constants::header_content_length);
+            if (length != m_request_headers.end())
+            {
+                check_code(curl_easy_setopt(m_curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(std::strtoull(length->second.data(), nullptr, 10))));
+            }
+            if (m_input_stream.valid() || m_input_buffer.valid())
+            {
+                check_code(curl_easy_setopt(m_curl, CURLOPT_READFUNCTION, read));
+                check_code(curl_easy_setopt(m_curl, CURLOPT_READDATA, this));
+            }
+        }
+
         CURLcode CurlEasyRequest::perform()
         {
-            if (m_output_stream.valid())
+            if (is_cancelled())
+            {
+                return CURLE_ABORTED_BY_CALLBACK;
+            }
+            resume();
+            m_performed_at = std::chrono::steady_clock::now();
+            const auto policy = m_client->get_timeout_policy();
+            m_throttle = m_client->get_bandwidth_throttle();
+            apply_timeouts(policy);
+#ifdef CURL_MAX_READ_SIZE
+            // As for uploads, large receive buffers mean fewer callbacks, but a throttled download is received in chunks small enough to be paced smoothly.
+            const bool download_throttled = m_throttle && m_throttle->download().limited();
+            check_code(curl_easy_setopt(m_curl, CURLOPT_BUFFERSIZE, static_cast<long>(download_throttled ? m_throttle->download().chunk_size() : CURL_MAX_READ_SIZE)));
+#endif
+            if (m_output_stream.valid() || m_output_buffer.valid())
             {
                 check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, write));
                 check_code(curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this));
@@ -46,6 +257,8 @@ namespace azure { namespace storage_lite {
                 check_code(curl_easy_setopt(m_curl, CURLOPT_NOBODY, 1L));
                 break;
             case http_method::post:
+                // A body is uploaded from the read callback as for a put, e.g. a batch request.
+                check_code(curl_easy_setopt(m_curl, CURLOPT_UPLOAD, (m_input_stream.valid() || m_input_buffer.valid()) ? 1L : 0L));
                 check_code(curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, constants::http_post));
                 break;
             case http_method::patch:
@@ -72,27 +285,123 @@ namespace azure { namespace storage_lite {
 
             const auto result = curl_easy_perform(m_curl);
             check_code(result); // has nothing to do with checks, just resets errno for succeeded ops.
+            ++m_attempts;
+            if (result == CURLE_OK)
+            {
+                record_timings(policy);
+            }
             return result;
         }
 
+        bool CurlEasyRequest::pace(token_bucket &bucket, size_t bytes)
+        {
+            const auto wake = std::chrono::steady_clock::now() + bucket.take(bytes);
+            for (auto now = std::chrono::steady_clock::now(); now < wake; now = std::chrono::steady_clock::now())
+            {
+                if (is_cancelled())
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(wake - now, std::chrono::milliseconds(50)));
+            }
+            return true;
+        }
+
+        void CurlEasyRequest::apply_timeouts(const std::shared_ptr<timeout_policy> &policy)
+        {
+            // Milliseconds the attempt may take, 0 for no limit.
+            long long timeout = m_absolute_timeout * 1000;
+            const long long escalation = 1LL << std::min(m_attempts, 4);
+            if (policy && m_absolute_timeout > 0)
+            {
+                timeout = policy->request_timeout(get_operation(m_method, m_url), m_absolute_timeout, get_payload_size(m_request_headers)).count() * escalation;
+            }
+            else if (policy && m_data_rate_timeout)
+            {
+                check_code(curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_TIME, static_cast<long>(policy->stall_timeout().count() * escalation)));
+                timeout = policy->transfer_timeout(get_payload_size(m_request_headers)).count() * escalation;
+            }
+            if (m_data_rate_timeout && throttled())
+            {
+                // A throttled transfer takes as long as the budget it shares dictates, it only fails when it stops moving.
+                check_code(curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_LIMIT, 1L));
+                timeout = 0;
+            }
+
+            if (m_cancellation_token.has_deadline())
+            {
+                // The attempt may not outlive the deadline either.
+                const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(m_cancellation_token.deadline() - std::chrono::steady_clock::now()).count();
+                timeout = std::max<long long>(timeout > 0 ? std::min<long long>(timeout, remaining) : remaining, 1);
+            }
+            check_code(curl_easy_setopt(m_curl, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout)));
+        }
+
+        void CurlEasyRequest::record_timings(const std::shared_ptr<timeout_policy> &policy)
+        {
+#if LIBCURL_VERSION_NUM >= 0x073D00
+            if (!policy || m_code < 200 || m_code >= 300 || (m_absolute_timeout == 0 && !m_data_rate_timeout))
+            {
+                return;
+            }
+            if (m_absolute_timeout == 0 && throttled())
+            {
+                // The throttle, not the service, set the pace of the transfer.
+                return;
+            }
+            curl_off_t total = 0;
+            curl_easy_getinfo(m_curl, CURLINFO_TOTAL_TIME_T, &total);
+            if (m_absolute_timeout > 0)
+            {
+                policy->record_request(get_operation(m_method, m_url), std::chrono::microseconds(total));
+                return;
+            }
+            curl_off_t first_byte = 0;
+            curl_off_t downloaded = 0;
+            curl_off_t uploaded = 0;
+            curl_easy_getinfo(m_curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+            curl_easy_getinfo(m_curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+            curl_easy_getinfo(m_curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+            // An upload only gets its response once the body is sent, so only downloads tell the time to the first byte.
+            policy->record_transfer(static_cast<uint64_t>(downloaded + uploaded), std::chrono::microseconds(m_method == http_method::get ? first_byte : 0), std::chrono::microseconds(total));
+#else
+            (void)policy;
+#endif
+        }
+
         size_t CurlEasyRequest::header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
         {
             CurlEasyRequest::REQUEST_TYPE *p = static_cast<CurlEasyRequest::REQUEST_TYPE *>(userdata);
-            std::string header(buffer, size * nitems);
-            if (!header.empty() && header.back() == '\n')
+            const char *line = buffer;
+            const size_t total = size * nitems;
+            size_t length = total;
+            if (length > 0 && line[length - 1] == '\n')
             {
-                header.pop_back();
+                --length;
             }
-            if (!header.empty() && header.back() == '\r')
+            if (length > 0 && line[length - 1] == '\r')
             {
-                header.pop_back();
+                --length;
             }
-            auto colon = header.find(':');
-            if (colon == std::string::npos) {
-                auto space = header.find(' ');
-                if (space != std::string::npos) {
-                    std::istringstream iss(header.substr(space));
-                    iss >> p->m_code;
+            const char *end = line + length;
+            const char *colon = std::find(line, end, ':');
+            if (colon == end) {
+                const char *space = std::find(line, end, ' ');
+                if (space != end) {
+                    // A status line starts a new response, drop the headers of interim ones such as 100 Continue.
+                    p->m_response_headers.clear();
+                    p->m_known_response_headers.fill(-1);
+                    http_code code = 0;
+                    for (const char *digit = space + 1; digit != end && *digit >= '0' && *digit <= '9'; ++digit)
+                    {
+                        code = code * 10 + (*digit - '0');
+                    }
+                    p->m_code = code;
+                    if (!p->m_response_started)
+                    {
+                        p->m_response_started_at = std::chrono::steady_clock::now();
+                    }
+                    p->m_response_started = true;
                     if (p->m_switch_error_callback && (p->m_switch_error_callback)(p->m_code)) {
                         curl_easy_setopt(p->m_curl, CURLOPT_WRITEFUNCTION, error);
                         curl_easy_setopt(p->m_curl, CURLOPT_WRITEDATA, p);
@@ -100,9 +409,421 @@ namespace azure { namespace storage_lite {
                 }
             }
             else {
-                p->m_response_headers[header.substr(0, colon)] = header.substr(colon + 2);
+                const char *value = colon + 1;
+                while (value != end && (*value == ' ' || *value == '\t'))
+                {
+                    ++value;
+                }
+                const char *value_end = end;
+                while (value_end != value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+                {
+                    --value_end;
+                }
+                p->m_response_headers.emplace_back(std::string(line, colon), std::string(value, value_end));
+                const int known = get_known_response_headers().find(line, colon - line);
+                if (known >= 0)
+                {
+                    p->m_known_response_headers[known] = static_cast<int>(p->m_response_headers.size() - 1);
+                }
+            }
+            return total;
+        }
+
+        const std::string &CurlEasyRequest::get_response_header(const std::string &name) const
+        {
+            static const std::string empty;
+            const int known = get_known_response_headers().find(name.data(), name.size());
+            if (known >= 0)
+            {
+                const int index = m_known_response_headers[known];
+                return index >= 0 ? m_response_headers[index].second : empty;
+            }
+            // A later header of the same name replaces an earlier one.
+            for (auto iter = m_response_headers.rbegin(); iter != m_response_headers.rend(); ++iter)
+            {
+                if (iter->first.size() == name.size() && strncasecmp(iter->first.data(), name.data(), name.size()) == 0)
+                {
+                    return iter->second;
+                }
+            }
+            return empty;
+        }
+
+        const int CurlEasyClient::priority_count;
+        const int handle_pool_metrics::wait_buckets;
+
+        std::chrono::microseconds handle_pool_metrics::wait_percentile(double percentile) const
+        {
+            uint64_t total = 0;
+            for (auto count : wait_histogram)
+            {
+                total += count;
+            }
+            const uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(percentile, 0.0), 1.0) * total));
+            uint64_t seen = 0;
+            for (int i = 0; i < wait_buckets; ++i)
+            {
+                seen += wait_histogram[i];
+                if (seen >= rank && seen > 0)
+                {
+                    return std::chrono::microseconds(i == 0 ? 1 : int64_t(1) << i);
+                }
+            }
+            return std::chrono::microseconds(0);
+        }
+
+        void CurlEasyClient::global_init()
+        {
+            static std::once_flag once;
+            std::call_once(once, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+        }
+
+        void CurlEasyClient::prewarm(int count, const std::string &url)
+        {
+            auto self = shared_from_this();
+            std::thread([self, count, url]()
+            {
+                std::vector<std::shared_ptr<CurlEasyRequest>> handles;
+                for (int i = 0; i < std::min(count, self->m_size); ++i)
+                {
+                    auto http = self->try_get_handle(request_priority::bulk);
+                    if (!http)
+                    {
+                        break;
+                    }
+                    handles.push_back(std::move(http));
+                }
+                if (url.empty())
+                {
+                    return;
+                }
+
+                // Every handle opens its own connection, so all of them are held until the last handshake is done.
+                std::vector<std::thread> connects;
+                for (auto &http : handles)
+                {
+                    connects.emplace_back([&http, &url]()
+                    {
+                        http->set_method(http_base::http_method::head);
+                        http->set_url(url);
+                        http->set_absolute_timeout(30);
+                        http->perform();
+                    });
+                }
+                for (auto &connect : connects)
+                {
+                    connect.join();
+                }
+            }).detach();
+        }
+
+        void CurlEasyClient::init_handles()
+        {
+            m_created = std::chrono::steady_clock::now();
+            const int shards = std::max(1, std::min<int>(m_size, std::max(1u, std::thread::hardware_concurrency())));
+            for (int i = 0; i < shards; ++i)
+            {
+                m_shards.emplace_back(new shard);
+                for (auto &bucket : m_shards.back()->wait_histogram)
+                {
+                    bucket = 0;
+                }
+            }
+            // Free handles count those not created yet, pop_free creates them once the lists run dry.
+            m_free = m_size;
+
+            // No handles are reserved until set_reserved_handles is called, so every request can use the whole pool.
+            for (auto &reserved : m_reserved_handles)
+            {
+                reserved = 0;
+            }
+            for (auto &queued : m_queued)
+            {
+                queued = 0;
+            }
+            m_credits.fill(0);
+        }
+
+        std::shared_ptr<CurlEasyRequest> CurlEasyClient::get_handle(request_priority priority)
+        {
+            const auto h = acquire(priority);
+            return std::make_shared<CurlEasyRequest>(shared_from_this(), h.handle, h.released, priority);
+        }
+
+        std::shared_ptr<CurlEasyRequest> CurlEasyClient::try_get_handle(request_priority priority)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const int p = static_cast<int>(priority);
+            if (queued_at_or_above(p) || !claim(p))
+            {
+                return nullptr;
+            }
+            bool stolen = false;
+            auto h = pop_free(home_shard(), stolen);
+            record_acquisition(stolen, false, start);
+            return std::make_shared<CurlEasyRequest>(shared_from_this(), h.handle, h.released, priority);
+        }
+
+        CurlEasyClient::free_handle CurlEasyClient::acquire(request_priority priority)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const int p = static_cast<int>(priority);
+            if (!queued_at_or_above(p) && claim(p))
+            {
+                bool stolen = false;
+                auto h = pop_free(home_shard(), stolen);
+                record_acquisition(stolen, false, start);
+                return h;
+            }
+
+            waiter w;
+            std::unique_lock<std::mutex> lk(m_waiters_mutex);
+            m_waiters[p].push_back(&w);
+            ++m_queued[p];
+            // A handle released before the request was queued is claimed here.
+            dispatch();
+            w.cv.wait(lk, [&w]() { return w.handle.handle != nullptr; });
+            lk.unlock();
+            record_acquisition(w.stolen, true, start);
+            return w.handle;
+        }
+
+        void CurlEasyClient::set_reserved_handles(request_priority priority, int count)
+        {
+            std::lock_guard<std::mutex> lg(m_waiters_mutex);
+            if (priority == request_priority::bulk)
+            {
+                return;
+            }
+            const int p = static_cast<int>(priority);
+            m_reserved_handles[p] = std::max(0, std::min(count, m_size - 1 - m_reserved_handles[1 - p]));
+            dispatch();
+        }
+
+        void CurlEasyClient::release_handle(CURL *h, std::chrono::steady_clock::duration held)
+        {
+            auto &s = *m_shards[home_shard()];
+            {
+                std::lock_guard<std::mutex> lg(s.mutex);
+                s.handles.push_back(free_handle{ h, std::chrono::steady_clock::now() });
+            }
+            s.busy_microseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(held).count()), std::memory_order_relaxed);
+
+            // Either a queued request sees the handle when it dispatches, or the handle is given to it here.
+            ++m_free;
+            for (const auto &queued : m_queued)
+            {
+                if (queued > 0)
+                {
+                    std::lock_guard<std::mutex> lg(m_waiters_mutex);
+                    dispatch();
+                    break;
+                }
+            }
+        }
+
+        int CurlEasyClient::reap_idle(std::chrono::steady_clock::duration idle)
+        {
+            const auto oldest = std::chrono::steady_clock::now() - idle;
+            int reaped = 0;
+            for (auto &s : m_shards)
+            {
+                std::vector<free_handle> idle_handles;
+                {
+                    std::lock_guard<std::mutex> lg(s->mutex);
+                    // The stack is ordered by release time, so the idle handles are at the bottom.
+                    auto end = std::find_if(s->handles.begin(), s->handles.end(), [oldest](const free_handle &h) { return h.released > oldest; });
+                    idle_handles.assign(s->handles.begin(), end);
+                    s->handles.erase(s->handles.begin(), end);
+                }
+                // The handles stay counted as free, a request taking one creates a new handle instead.
+                m_created_handles -= static_cast<int>(idle_handles.size());
+                for (const auto &h : idle_handles)
+                {
+                    curl_easy_cleanup(h.handle);
+                }
+                reaped += static_cast<int>(idle_handles.size());
+            }
+            return reaped;
+        }
+
+        handle_pool_metrics CurlEasyClient::metrics() const
+        {
+            handle_pool_metrics metrics;
+            metrics.size = m_size;
+            metrics.created = m_created_handles;
+            metrics.in_use = m_size - m_free;
+            metrics.peak_in_use = m_peak_in_use;
+            for (const auto &queued : m_queued)
+            {
+                metrics.waiting += queued;
+            }
+            uint64_t busy_microseconds = 0;
+            for (const auto &s : m_shards)
+            {
+                metrics.acquisitions += s->acquisitions;
+                metrics.waits += s->waits;
+                metrics.steals += s->steals;
+                busy_microseconds += s->busy_microseconds;
+                for (int i = 0; i < handle_pool_metrics::wait_buckets; ++i)
+                {
+                    metrics.wait_histogram[i] += s->wait_histogram[i];
+                }
+            }
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_created).count();
+            if (elapsed > 0 && m_size > 0)
+            {
+                metrics.utilization = std::min(1.0, static_cast<double>(busy_microseconds) / (static_cast<double>(elapsed) * m_size));
+            }
+            return metrics;
+        }
+
+        int CurlEasyClient::home_shard() const
+        {
+            const int shards = static_cast<int>(m_shards.size());
+#ifdef __linux__
+            const int cpu = sched_getcpu();
+            if (cpu >= 0)
+            {
+                return cpu % shards;
+            }
+#endif
+            static std::atomic<unsigned> next_thread{ 0 };
+            thread_local unsigned thread_index = next_thread++;
+            return static_cast<int>(thread_index % shards);
+        }
+
+        bool CurlEasyClient::queued_at_or_above(int priority) const
+        {
+            for (int p = 0; p <= priority; ++p)
+            {
+                if (m_queued[p] > 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool CurlEasyClient::claim(int priority)
+        {
+            // A request leaves free the handles reserved for every higher priority.
+            int reserved = 0;
+            for (int p = 0; p < priority; ++p)
+            {
+                reserved += m_reserved_handles[p];
+            }
+            int free = m_free;
+            while (free > reserved)
+            {
+                if (m_free.compare_exchange_weak(free, free - 1))
+                {
+                    const int in_use = m_size - free + 1;
+                    int peak = m_peak_in_use.load(std::memory_order_relaxed);
+                    while (in_use > peak && !m_peak_in_use.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+                    {
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        CurlEasyClient::free_handle CurlEasyClient::pop_free(int home, bool &stolen)
+        {
+            // Releases add to a list before counting the handle as free, so a claimed handle is in one of the lists or not created yet,
+            // though a concurrent claim may take it from under the scan and leave another in a list already passed.
+            // Handles that were used before are preferred, they may still hold a connection.
+            const int shards = static_cast<int>(m_shards.size());
+            for (;;)
+            {
+                for (int i = 0; i < shards; ++i)
+                {
+                    auto &s = *m_shards[(home + i) % shards];
+                    std::lock_guard<std::mutex> lg(s.mutex);
+                    if (!s.handles.empty())
+                    {
+                        auto h = s.handles.back();
+                        s.handles.pop_back();
+                        stolen = i != 0;
+                        return h;
+                    }
+                }
+                int created = m_created_handles;
+                while (created < m_size)
+                {
+                    if (m_created_handles.compare_exchange_weak(created, created + 1))
+                    {
+                        stolen = false;
+                        return free_handle{ curl_easy_init(), std::chrono::steady_clock::time_point() };
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void CurlEasyClient::record_acquisition(bool stolen, bool waited, std::chrono::steady_clock::time_point start)
+        {
+            auto &s = *m_shards[home_shard()];
+            s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+            if (waited)
+            {
+                s.waits.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (stolen)
+            {
+                s.steals.fetch_add(1, std::memory_order_relaxed);
+            }
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            int bucket = 0;
+            for (; wait > 0 && bucket < handle_pool_metrics::wait_buckets - 1; wait >>= 1)
+            {
+                ++bucket;
+            }
+            s.wait_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void CurlEasyClient::dispatch()
+        {
+            // Hands free handles to the front waiters of the queues by smooth weighted round robin, called with m_waiters_mutex held.
+            for (;;)
+            {
+                int chosen = -1;
+                int total = 0;
+                int reserved = 0;
+                const int free = m_free;
+                for (int p = 0; p < priority_count; ++p)
+                {
+                    const bool eligible = !m_waiters[p].empty() && free > reserved;
+                    reserved += m_reserved_handles[p];
+                    if (!eligible)
+                    {
+                        continue;
+                    }
+                    m_credits[p] += priority_weights[p];
+                    total += priority_weights[p];
+                    if (chosen < 0 || m_credits[p] > m_credits[chosen])
+                    {
+                        chosen = p;
+                    }
+                }
+                if (chosen < 0)
+                {
+                    return;
+                }
+                m_credits[chosen] -= total;
+                if (!claim(chosen))
+                {
+                    // A request outside the queues took the handle first.
+                    continue;
+                }
+
+                waiter *w = m_waiters[chosen].front();
+                m_waiters[chosen].pop_front();
+                --m_queued[chosen];
+                w->handle = pop_free(home_shard(), w->stolen);
+                w->cv.notify_one();
             }
-            return size * nitems;
         }
 
 }} // azure::storage_lite
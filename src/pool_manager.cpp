@@ -0,0 +1,90 @@
+#include "pool_manager.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace azure {  namespace storage_lite {
+
+    pool_manager::pool_manager(std::shared_ptr<CurlEasyClient> client, std::string url, int min_warm, std::chrono::seconds keepalive_interval, std::chrono::seconds idle_timeout)
+        : m_client(std::move(client)),
+        m_url(std::move(url)),
+        m_min_warm(std::max(0, std::min(min_warm, m_client->size()))),
+        m_keepalive_interval(std::max(keepalive_interval, std::chrono::seconds(1))),
+        m_idle_timeout(std::max(idle_timeout, m_keepalive_interval)),
+        m_stopped(false)
+    {
+        m_thread = std::thread(&pool_manager::run, this);
+    }
+
+    pool_manager::~pool_manager()
+    {
+        {
+            std::lock_guard<std::mutex> lg(m_mutex);
+            m_stopped = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+    void pool_manager::announce_burst(int count)
+    {
+        m_client->prewarm(count, m_url);
+    }
+
+    void pool_manager::maintain()
+    {
+        // The free lists are stacks, so the handles taken here are the most recently used ones. Pushed back, they stay
+        // on top and are the ones kept connected, while the handles beneath them age until they are reaped.
+        std::vector<std::shared_ptr<CurlEasyRequest>> handles;
+        for (int i = 0; i < m_min_warm; ++i)
+        {
+            auto http = m_client->try_get_handle(request_priority::bulk);
+            if (!http)
+            {
+                // The other handles are busy, and so connected.
+                break;
+            }
+            handles.push_back(std::move(http));
+        }
+
+        const auto stale = std::chrono::steady_clock::now() - m_keepalive_interval;
+        std::vector<std::thread> keepalives;
+        for (auto &http : handles)
+        {
+            if (http->last_used() > stale)
+            {
+                continue;
+            }
+            keepalives.emplace_back([&http, this]()
+            {
+                http->set_method(http_base::http_method::head);
+                http->set_url(m_url);
+                http->set_absolute_timeout(30);
+                http->perform();
+            });
+        }
+        for (auto &keepalive : keepalives)
+        {
+            keepalive.join();
+        }
+        // Released in reverse, so the most recently used handle ends up on top again.
+        while (!handles.empty())
+        {
+            handles.pop_back();
+        }
+
+        m_client->reap_idle(m_idle_timeout);
+    }
+
+    void pool_manager::run()
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        while (!m_cv.wait_for(lk, m_keepalive_interval / 2, [this]() { return m_stopped; }))
+        {
+            lk.unlock();
+            maintain();
+            lk.lock();
+        }
+    }
+
+}}  // azure::storage_lite
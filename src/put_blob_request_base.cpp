@@ -31,6 +31,7 @@ void put_blob_request_base::build_request(const storage_account &a, http_base &h
     add_optional_header(h, constants::header_origin, r.origin());
 
     add_ms_header(h, headers, constants::header_ms_client_request_id, r.ms_client_request_id(), true);
+    add_ms_header(h, headers, constants::header_ms_content_crc64, r.content_crc64(), true);
     add_ms_header(h, headers, constants::header_ms_lease_id, r.ms_lease_id(), true);
 
     add_ms_header(h, headers, constants::header_ms_blob_cache_control, r.ms_blob_cache_control(), true);
@@ -23,8 +23,10 @@ namespace azure {  namespace storage_lite {
 
         storage_headers headers;
         add_content_length(h, headers, r.content_length());
+        add_optional_content_md5(h, headers, r.content_md5());
 
         add_ms_header(h, headers, constants::header_ms_client_request_id, r.ms_client_request_id(), true);
+        add_ms_header(h, headers, constants::header_ms_content_crc64, r.content_crc64(), true);
 
         h.add_header(constants::header_user_agent, constants::header_value_user_agent);
         add_ms_header(h, headers, constants::header_ms_date, get_ms_date(date_format::rfc_1123));
@@ -0,0 +1,132 @@
+#include "request_governor.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "storage_account.h"
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Containers without a request in flight are forgotten once this many are tracked.
+    const size_t max_containers = 4096;
+
+    int64_t to_interval(double requests_per_second)
+    {
+        return requests_per_second > 0 ? static_cast<int64_t>(1e9 / requests_per_second) : 0;
+    }
+
+    int64_t steady_now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+} // noname namespace
+
+    request_governor::request_governor(double requests_per_second, double container_requests_per_second, std::chrono::milliseconds burst)
+        : m_interval(to_interval(requests_per_second)),
+        m_container_interval(to_interval(container_requests_per_second)),
+        m_tolerance(std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(burst, std::chrono::milliseconds(0))).count())
+    {
+    }
+
+    void request_governor::set_rate(double requests_per_second)
+    {
+        m_interval = to_interval(requests_per_second);
+    }
+
+    void request_governor::set_container_rate(double requests_per_second)
+    {
+        m_container_interval = to_interval(requests_per_second);
+    }
+
+    int64_t request_governor::limiter::reserve(int64_t now, int64_t interval, int64_t tolerance)
+    {
+        int64_t tat = m_tat;
+        for (;;)
+        {
+            // The request may go up to the tolerance ahead of its even spacing.
+            const int64_t next = std::max(tat, now) + interval;
+            if (m_tat.compare_exchange_weak(tat, next))
+            {
+                return std::max(tat - tolerance, now);
+            }
+        }
+    }
+
+    std::chrono::nanoseconds request_governor::reserve(const std::string &container)
+    {
+        const int64_t now = steady_now();
+        int64_t start = now;
+        const int64_t interval = m_interval;
+        if (interval > 0)
+        {
+            start = std::max(start, m_account.reserve(now, interval, m_tolerance));
+        }
+
+        const int64_t container_interval = m_container_interval;
+        if (container_interval > 0 && !container.empty())
+        {
+            // The slot is taken under the lock, an idle limiter may be erased by another thread as soon as it is released.
+            std::lock_guard<std::mutex> lg(m_containers_mutex);
+            auto &entry = m_containers[container];
+            if (!entry)
+            {
+                entry.reset(new limiter);
+                if (m_containers.size() > max_containers)
+                {
+                    // Erasing others leaves the new entry where it is.
+                    for (auto iter = m_containers.begin(); iter != m_containers.end();)
+                    {
+                        iter = iter->second.get() != entry.get() && iter->second->idle(now) ? m_containers.erase(iter) : std::next(iter);
+                    }
+                }
+            }
+            start = std::max(start, entry->reserve(now, container_interval, m_tolerance));
+        }
+        return std::chrono::nanoseconds(start - now);
+    }
+
+    bool request_governor::wait(const std::string &container, const std::function<bool()> &cancelled)
+    {
+        return wait_for(reserve(container), cancelled);
+    }
+
+    bool request_governor::wait_for(std::chrono::nanoseconds delay, const std::function<bool()> &cancelled)
+    {
+        const auto wake = std::chrono::steady_clock::now() + delay;
+        for (auto now = std::chrono::steady_clock::now(); now < wake; now = std::chrono::steady_clock::now())
+        {
+            if (cancelled())
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(wake - now, std::chrono::milliseconds(50)));
+        }
+        return !cancelled();
+    }
+
+    std::string request_governor::container_of(const storage_account &account, const std::string &url)
+    {
+        auto begin = url.find("://");
+        begin = url.find('/', begin == std::string::npos ? 0 : begin + 3);
+        if (begin == std::string::npos)
+        {
+            return std::string();
+        }
+        // Emulator and custom endpoints put the account name in the path, ahead of the container.
+        const auto prefix = account.get_url(storage_account::service::blob).get_path();
+        if (!prefix.empty() && url.compare(begin, prefix.size(), prefix) == 0)
+        {
+            begin += prefix.size();
+        }
+        if (begin >= url.size() || url[begin] != '/')
+        {
+            return std::string();
+        }
+        ++begin;
+        return url.substr(begin, url.find_first_of("/?", begin) - begin);
+    }
+
+}}  // azure::storage_lite
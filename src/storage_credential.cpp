@@ -1,23 +1,95 @@
 #include "storage_credential.h"
 
+#include <algorithm>
+#include <cctype>
+
 #include "base64.h"
+#include "compare.h"
 #include "constants.h"
-#include "hash.h"
 #include "utility.h"
 
 namespace azure {  namespace storage_lite {
 
+namespace {
+    void append_lowercase(std::string &target, const std::string &source)
+    {
+        const size_t offset = target.size();
+        target.append(source);
+        std::transform(target.begin() + offset, target.end(), target.begin() + offset, [](char c) { return char(std::tolower(c)); });
+    }
+
+    std::string format_sas_time(std::chrono::system_clock::time_point time)
+    {
+        if (time == std::chrono::system_clock::time_point())
+        {
+            return std::string();
+        }
+        return get_ms_date(date_format::iso_8601, std::chrono::system_clock::to_time_t(time));
+    }
+
+    void append_sas_query(std::string &token, const std::string &name, const std::string &value)
+    {
+        if (value.empty())
+        {
+            return;
+        }
+        if (!token.empty())
+        {
+            token.append("&");
+        }
+        token.append(name).append("=").append(encode_url_query(value));
+    }
+
+    std::string append_sas_token(std::string url, const std::string &token)
+    {
+        url.append(url.find('?') != std::string::npos ? "&" : "?");
+        url.append(token);
+        return url;
+    }
+
+    // Finds the container a request path refers to. Unless the host is named after the account, the endpoint is path style
+    // and the account name is the first segment.
+    std::string get_container(const std::string &account_name, const std::string &host, const std::string &path, bool &has_blob)
+    {
+        size_t start = 0;
+        if (host.compare(0, account_name.size() + 1, account_name + ".") != 0)
+        {
+            start = path.find('/', 1);
+            if (start == std::string::npos)
+            {
+                has_blob = false;
+                return std::string();
+            }
+        }
+        start = path.find_first_not_of('/', start);
+        if (start == std::string::npos)
+        {
+            has_blob = false;
+            return std::string();
+        }
+        size_t end = path.find('/', start);
+        has_blob = end != std::string::npos && end + 1 < path.size();
+        return path.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+} // noname namespace
+
     shared_key_credential::shared_key_credential(const std::string &account_name, const std::string &account_key)
         : m_account_name(account_name),
-        m_account_key(from_base64(account_key)) {}
+        m_account_key(from_base64(account_key)),
+        m_signer(m_account_key) {}
 
     shared_key_credential::shared_key_credential(const std::string &account_name, const std::vector<unsigned char> &account_key)
         : m_account_name(account_name),
-        m_account_key(account_key) {}
+        m_account_key(account_key),
+        m_signer(m_account_key) {}
 
     void shared_key_credential::sign_request(const storage_request_base &, http_base &h, const storage_url &url, const storage_headers &headers) const
     {
-        std::string string_to_sign(get_http_verb(h.get_method()));
+        // The buffers keep their capacity between requests signed on the same thread.
+        thread_local std::string string_to_sign;
+        thread_local std::vector<const std::pair<const std::string, std::string>*> ordered_ms_headers;
+
+        string_to_sign.assign(get_http_verb(h.get_method()));
         string_to_sign.append("\n");
 
         string_to_sign.append(headers.content_encoding).append("\n");
@@ -33,51 +105,124 @@ namespace azure {  namespace storage_lite {
         string_to_sign.append(headers.if_unmodified_since).append("\n");
         string_to_sign.append("\n"); // Range
 
-        // Canonicalized headers
-        std::map<std::string, std::string> ordered_ms_headers;
+        // Canonicalized headers, ordered by their lowercase names. The names are usually lowercase already and then keep the map order.
+        ordered_ms_headers.clear();
+        bool lowercase = true;
         for (const auto& header : headers.ms_headers)
         {
-            ordered_ms_headers.emplace(to_lowercase(header.first), header.second);
+            ordered_ms_headers.push_back(&header);
+            lowercase = lowercase && std::none_of(header.first.begin(), header.first.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
         }
-        for (const auto &header : ordered_ms_headers)
+        if (!lowercase)
         {
-            string_to_sign.append(header.first).append(":").append(header.second).append("\n");
+            std::stable_sort(ordered_ms_headers.begin(), ordered_ms_headers.end(), [](const std::pair<const std::string, std::string>* lhs, const std::pair<const std::string, std::string>* rhs)
+            {
+                return case_insensitive_compare()(lhs->first, rhs->first);
+            });
+        }
+        const std::pair<const std::string, std::string>* previous = nullptr;
+        for (const auto header : ordered_ms_headers)
+        {
+            // Names differing only in case are a single header, the lowercase copy used to keep the first of them.
+            if (previous != nullptr && strcasecmp(previous->first.c_str(), header->first.c_str()) == 0)
+            {
+                continue;
+            }
+            previous = header;
+            append_lowercase(string_to_sign, header->first);
+            string_to_sign.append(":").append(header->second).append("\n");
         }
 
         // Canonicalized resource
         string_to_sign.append("/").append(m_account_name).append(url.get_encoded_path());
-        for (const auto &name : url.get_query()) {
-            string_to_sign.append("\n").append(to_lowercase(name.first));
-            bool first_value = true;
-            for (const auto &value : name.second) {
-                if (first_value) {
-                    string_to_sign.append(":");
-                    first_value = false;
-                }
-                else {
-                    string_to_sign.append(",");
-                }
-                string_to_sign.append(value);
+        const std::string *previous_name = nullptr;
+        for (const auto &query : url.get_query()) {
+            if (previous_name != nullptr && *previous_name == query.first) {
+                string_to_sign.append(",");
+            }
+            else {
+                string_to_sign.append("\n");
+                append_lowercase(string_to_sign, query.first);
+                string_to_sign.append(":");
             }
+            string_to_sign.append(query.second);
+            previous_name = &query.first;
         }
 
         std::string authorization("SharedKey ");
-        authorization.append(m_account_name).append(":").append(hash(string_to_sign, m_account_key));
+        authorization.append(m_account_name).append(":").append(m_signer.sign(string_to_sign));
         h.add_header(constants::header_authorization, authorization);
     }
 
     void shared_key_credential::sign_request(const table_request_base &, http_base &, const storage_url &, const storage_headers &) const {}
 
-    std::string shared_access_signature_credential::transform_url(std::string url) const
+    std::string shared_key_credential::generate_blob_sas(const std::string &container, const std::string &blob, const shared_access_signature_parameters &parameters) const
     {
-        if (url.find('?') != std::string::npos) {
-            url.append("&");
-        }
-        else {
-            url.append("?");
+        const std::string start = format_sas_time(parameters.starts_on);
+        const std::string expiry = format_sas_time(parameters.expires_on);
+        const std::string resource = blob.empty() ? "c" : "b";
+
+        std::string string_to_sign(parameters.permissions);
+        string_to_sign.append("\n").append(start);
+        string_to_sign.append("\n").append(expiry);
+        string_to_sign.append("\n/blob/").append(m_account_name).append("/").append(container);
+        if (!blob.empty())
+        {
+            string_to_sign.append("/").append(blob);
         }
-        url.append(m_sas_token);
-        return url;
+        string_to_sign.append("\n").append(parameters.identifier);
+        string_to_sign.append("\n").append(parameters.ip_range);
+        string_to_sign.append("\n").append(parameters.protocol);
+        string_to_sign.append("\n").append(constants::header_value_storage_blob_version);
+        string_to_sign.append("\n").append(resource);
+        // Snapshot time, Cache-Control, Content-Disposition, Content-Encoding, Content-Language and Content-Type overrides.
+        string_to_sign.append("\n\n\n\n\n\n");
+
+        std::string token;
+        append_sas_query(token, "sv", constants::header_value_storage_blob_version);
+        append_sas_query(token, "sr", resource);
+        append_sas_query(token, "sp", parameters.permissions);
+        append_sas_query(token, "st", start);
+        append_sas_query(token, "se", expiry);
+        append_sas_query(token, "sip", parameters.ip_range);
+        append_sas_query(token, "spr", parameters.protocol);
+        append_sas_query(token, "si", parameters.identifier);
+        append_sas_query(token, "sig", m_signer.sign(string_to_sign));
+        return token;
+    }
+
+    std::string shared_key_credential::generate_account_sas(const std::string &services, const std::string &resource_types, const shared_access_signature_parameters &parameters) const
+    {
+        const std::string start = format_sas_time(parameters.starts_on);
+        const std::string expiry = format_sas_time(parameters.expires_on);
+
+        std::string string_to_sign(m_account_name);
+        string_to_sign.append("\n").append(parameters.permissions);
+        string_to_sign.append("\n").append(services);
+        string_to_sign.append("\n").append(resource_types);
+        string_to_sign.append("\n").append(start);
+        string_to_sign.append("\n").append(expiry);
+        string_to_sign.append("\n").append(parameters.ip_range);
+        string_to_sign.append("\n").append(parameters.protocol);
+        string_to_sign.append("\n").append(constants::header_value_storage_blob_version);
+        string_to_sign.append("\n");
+
+        std::string token;
+        append_sas_query(token, "sv", constants::header_value_storage_blob_version);
+        append_sas_query(token, "ss", services);
+        append_sas_query(token, "srt", resource_types);
+        append_sas_query(token, "sp", parameters.permissions);
+        append_sas_query(token, "st", start);
+        append_sas_query(token, "se", expiry);
+        append_sas_query(token, "sip", parameters.ip_range);
+        append_sas_query(token, "spr", parameters.protocol);
+        append_sas_query(token, "sig", m_signer.sign(string_to_sign));
+        return token;
+    }
+
+    std::string shared_access_signature_credential::transform_url(std::string url) const
+    {
+        return append_sas_token(std::move(url), m_sas_token);
     }
 
     void shared_access_signature_credential::sign_request(const storage_request_base &, http_base &h, const storage_url &, const storage_headers &) const
@@ -86,18 +231,176 @@ namespace azure {  namespace storage_lite {
         h.set_url(transformed_url);
     }
 
+    rotating_sas_credential::rotating_sas_credential(std::shared_ptr<shared_key_credential> key, const rotating_sas_credential_options &options)
+        : m_key(std::move(key)),
+        m_options(options)
+    {
+        m_options.refresh_margin = std::min(m_options.refresh_margin, m_options.validity / 2);
+    }
+
+    std::string rotating_sas_credential::get_token(const std::string &container) const
+    {
+        const auto now = std::chrono::system_clock::now();
+        std::lock_guard<std::mutex> lock(m_tokens_mutex);
+        auto &cached = m_tokens[container];
+        if (cached.token.empty() || now >= cached.refresh_on)
+        {
+            shared_access_signature_parameters parameters;
+            parameters.starts_on = now - m_options.clock_skew;
+            parameters.expires_on = now + m_options.validity;
+            if (container.empty())
+            {
+                parameters.permissions = m_options.account_permissions;
+                cached.token = m_key->generate_account_sas("b", "sco", parameters);
+            }
+            else
+            {
+                parameters.permissions = m_options.container_permissions;
+                cached.token = m_key->generate_blob_sas(container, std::string(), parameters);
+            }
+            cached.refresh_on = parameters.expires_on - m_options.refresh_margin;
+        }
+        return cached.token;
+    }
+
+    void rotating_sas_credential::sign_request(const storage_request_base &, http_base &h, const storage_url &url, const storage_headers &) const
+    {
+        const std::string &domain = url.get_domain();
+        const size_t scheme_end = domain.find("://");
+        const std::string host = scheme_end == std::string::npos ? domain : domain.substr(scheme_end + 3);
+
+        bool has_blob = false;
+        std::string container = get_container(m_key->account_name(), host, url.get_path(), has_blob);
+        h.set_url(append_sas_token(h.get_url(), get_token(has_blob ? container : std::string())));
+    }
+
+    std::string rotating_sas_credential::transform_url(std::string url) const
+    {
+        const size_t scheme_end = url.find("://");
+        const size_t host_start = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+        const size_t path_start = std::min(url.find('/', host_start), url.find('?', host_start));
+        const std::string host = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+        std::string path;
+        if (path_start != std::string::npos && url[path_start] == '/')
+        {
+            path = url.substr(path_start, url.find('?', path_start) - path_start);
+        }
+
+        bool has_blob = false;
+        std::string container = get_container(m_key->account_name(), host, path, has_blob);
+        return append_sas_token(std::move(url), get_token(has_blob ? container : std::string()));
+    }
+
     AZURE_STORAGE_API token_credential::token_credential(const std::string &token)
-        : m_token(std::move(token)) {}
+        : m_token(std::make_shared<const std::string>(token)),
+        m_stopping(false) {}
+
+    token_credential::token_credential(std::function<access_token()> provider, std::chrono::seconds refresh_margin)
+        : m_provider(std::move(provider)),
+        m_refresh_margin(refresh_margin),
+        m_stopping(false)
+    {
+        access_token first = m_provider();
+        m_token = std::make_shared<const std::string>(std::move(first.token));
+        m_expires_on = first.expires_on;
+        m_refresh_on = next_refresh(m_expires_on);
+        m_refresher = std::thread(&token_credential::refresh, this);
+    }
+
+    token_credential::~token_credential()
+    {
+        {
+            std::lock_guard<std::mutex> lg(m_refresh_mutex);
+            m_stopping = true;
+        }
+        m_refresh_cv.notify_all();
+        if (m_refresher.joinable())
+        {
+            m_refresher.join();
+        }
+    }
+
+    std::chrono::system_clock::time_point token_credential::next_refresh(std::chrono::system_clock::time_point expires_on) const
+    {
+        // Renew ahead of expiry, but no sooner than halfway through a short-lived token's lifetime.
+        const auto now = std::chrono::system_clock::now();
+        const auto lifetime = expires_on - now;
+        const auto margin = std::min<std::chrono::system_clock::duration>(m_refresh_margin, lifetime / 2);
+        return std::max<std::chrono::system_clock::time_point>(expires_on - margin, now + std::chrono::seconds(1));
+    }
+
+    bool token_credential::refresh_now()
+    {
+        if (!m_provider)
+        {
+            return false;
+        }
+
+        access_token next;
+        {
+            // The refresh thread and callers of refresh_now never call the provider at the same time.
+            std::lock_guard<std::mutex> provider_lock(m_provider_mutex);
+            try
+            {
+                next = m_provider();
+            }
+            catch (...)
+            {
+                next.token.clear();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_refresh_mutex);
+        const bool renewed = !next.token.empty();
+        if (renewed)
+        {
+            std::atomic_store(&m_token, std::make_shared<const std::string>(std::move(next.token)));
+            m_expires_on = next.expires_on;
+            m_refresh_on = next_refresh(m_expires_on);
+        }
+        else
+        {
+            // Keep the current token and retry well before it expires.
+            const auto now = std::chrono::system_clock::now();
+            const auto remaining = m_expires_on - now;
+            if (remaining > std::chrono::system_clock::duration::zero())
+            {
+                m_refresh_on = now + std::min<std::chrono::system_clock::duration>(std::max<std::chrono::system_clock::duration>(remaining / 4, std::chrono::milliseconds(100)), std::chrono::seconds(30));
+            }
+            else
+            {
+                m_refresh_on = now + std::chrono::seconds(1);
+            }
+        }
+        m_refresh_cv.notify_all();
+        return renewed;
+    }
+
+    void token_credential::refresh()
+    {
+        std::unique_lock<std::mutex> lock(m_refresh_mutex);
+        while (!m_stopping)
+        {
+            // Woken early when refresh_now moves the schedule.
+            if (std::chrono::system_clock::now() < m_refresh_on)
+            {
+                m_refresh_cv.wait_until(lock, m_refresh_on);
+                continue;
+            }
+            lock.unlock();
+            refresh_now();
+            lock.lock();
+        }
+    }
 
     void token_credential::set_token(const std::string& token) {
-        std::lock_guard<std::mutex> lg(m_token_mutex);
-        m_token = token;
+        std::atomic_store(&m_token, std::make_shared<const std::string>(token));
     }
 
     void token_credential::sign_request(const storage_request_base &, http_base &h, const storage_url &, const storage_headers &) const {
-        std::lock_guard<std::mutex> lg(m_token_mutex);
+        std::shared_ptr<const std::string> token = std::atomic_load(&m_token);
         std::string authorization("Bearer ");
-        authorization.append(m_token);
+        authorization.append(*token);
         h.add_header(constants::header_authorization, authorization);
     }
 }}   // azure::storage_lite
@@ -0,0 +1,193 @@
+#include "storage_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Positional reads and writes, which neither use nor move the file position.
+    bool read_at(int fd, uint64_t offset, char *buffer, size_t length)
+    {
+        while (length > 0)
+        {
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD transferred = 0;
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 1 << 30));
+            if (!ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buffer, chunk, &transferred, &overlapped) || transferred == 0)
+            {
+                return false;
+            }
+#else
+            const ssize_t transferred = pread(fd, buffer, length, static_cast<off_t>(offset));
+            if (transferred < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (transferred <= 0)
+            {
+                return false;
+            }
+#endif
+            buffer += transferred;
+            offset += transferred;
+            length -= static_cast<size_t>(transferred);
+        }
+        return true;
+    }
+
+    bool write_at(int fd, uint64_t offset, const char *data, size_t length)
+    {
+        while (length > 0)
+        {
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD transferred = 0;
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 1 << 30));
+            if (!WriteFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), data, chunk, &transferred, &overlapped) || transferred == 0)
+            {
+                return false;
+            }
+#else
+            const ssize_t transferred = pwrite(fd, data, length, static_cast<off_t>(offset));
+            if (transferred < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (transferred <= 0)
+            {
+                return false;
+            }
+#endif
+            data += transferred;
+            offset += transferred;
+            length -= static_cast<size_t>(transferred);
+        }
+        return true;
+    }
+
+} // noname namespace
+
+    storage_input_buffer::storage_input_buffer(std::vector<std::pair<const char *, size_t>> segments)
+        : m_segments(std::move(segments)),
+        m_valid(true)
+    {
+        for (const auto &segment : m_segments)
+        {
+            m_size += segment.second;
+        }
+    }
+
+    storage_input_buffer storage_input_buffer::from_file(int fd, uint64_t offset, uint64_t length)
+    {
+        storage_input_buffer buffer;
+        buffer.m_fd = fd;
+        buffer.m_file_offset = offset;
+        buffer.m_size = length;
+        buffer.m_valid = true;
+        return buffer;
+    }
+
+    bool storage_input_buffer::read(char *buffer, size_t capacity, size_t &copied)
+    {
+        copied = 0;
+        if (m_fd >= 0)
+        {
+            copied = static_cast<size_t>(std::min<uint64_t>(capacity, m_size - m_position));
+            if (!read_at(m_fd, m_file_offset + m_position, buffer, copied))
+            {
+                copied = 0;
+                return false;
+            }
+            m_position += copied;
+            return true;
+        }
+
+        while (copied < capacity && m_segment < m_segments.size())
+        {
+            const auto &segment = m_segments[m_segment];
+            const size_t length = std::min(capacity - copied, segment.second - m_segment_offset);
+            std::memcpy(buffer + copied, segment.first + m_segment_offset, length);
+            copied += length;
+            m_segment_offset += length;
+            if (m_segment_offset == segment.second)
+            {
+                ++m_segment;
+                m_segment_offset = 0;
+            }
+        }
+        m_position += copied;
+        return true;
+    }
+
+    storage_output_buffer::storage_output_buffer(std::vector<std::pair<char *, size_t>> segments)
+        : m_segments(std::move(segments)),
+        m_valid(true)
+    {
+        for (const auto &segment : m_segments)
+        {
+            m_size += segment.second;
+        }
+    }
+
+    storage_output_buffer storage_output_buffer::from_file(int fd, uint64_t offset, uint64_t length)
+    {
+        storage_output_buffer buffer;
+        buffer.m_fd = fd;
+        buffer.m_file_offset = offset;
+        buffer.m_size = length;
+        buffer.m_valid = true;
+        return buffer;
+    }
+
+    bool storage_output_buffer::write(const char *data, size_t length)
+    {
+        if (length > m_size - m_position)
+        {
+            return false;
+        }
+
+        if (m_fd >= 0)
+        {
+            if (!write_at(m_fd, m_file_offset + m_position, data, length))
+            {
+                return false;
+            }
+            m_position += length;
+            return true;
+        }
+
+        size_t copied = 0;
+        while (copied < length)
+        {
+            const auto &segment = m_segments[m_segment];
+            const size_t chunk = std::min(length - copied, segment.second - m_segment_offset);
+            std::memcpy(segment.first + m_segment_offset, data + copied, chunk);
+            copied += chunk;
+            m_segment_offset += chunk;
+            if (m_segment_offset == segment.second)
+            {
+                ++m_segment;
+                m_segment_offset = 0;
+            }
+        }
+        m_position += length;
+        return true;
+    }
+
+}}  // azure::storage_lite
@@ -10,25 +10,25 @@ namespace azure {  namespace storage_lite {
 
     std::string storage_url::to_string() const
     {
-        std::string url(m_domain);
-        url.append(encode_url_path(m_path));
+        size_t length = m_domain.size() + m_path.size() + 1;
+        for (const auto &q : m_query)
+        {
+            length += q.first.size() + q.second.size() + 2;
+        }
+
+        std::string url;
+        url.reserve(length);
+        url.append(m_domain);
+        append_encoded_url_path(url, m_path);
 
         bool first_query = true;
         for (const auto &q : m_query)
         {
-            if (first_query)
-            {
-                url.append("?");
-                first_query = false;
-            }
-            else
-            {
-                url.append("&");
-            }
-            for (const auto &value : q.second)
-            {
-                url.append(encode_url_query(q.first)).append("=").append(encode_url_query(value));
-            }
+            url.append(first_query ? "?" : "&");
+            first_query = false;
+            append_encoded_url_query(url, q.first);
+            url.append("=");
+            append_encoded_url_query(url, q.second);
         }
         return url;
     }
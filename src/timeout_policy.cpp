@@ -0,0 +1,132 @@
+#include "timeout_policy.h"
+
+#include <algorithm>
+
+namespace azure {  namespace storage_lite {
+
+namespace {
+
+    // Observations of the most recent requests the timeouts are derived from.
+    const size_t sample_window = 256;
+
+    // Fewer observations than this do not give meaningful percentiles.
+    const size_t min_samples = 16;
+
+    // Transfers smaller than this are dominated by latency and say little about throughput.
+    const uint64_t min_throughput_sample = 64 * 1024;
+
+    // The fixed stall detection the requests used before, 60 seconds below 17KB/s.
+    const std::chrono::seconds default_stall_timeout(60);
+    const std::chrono::seconds min_stall_timeout(2);
+
+} // noname namespace
+
+    void timeout_policy::window::add(int64_t sample)
+    {
+        if (m_samples.size() < sample_window)
+        {
+            m_samples.push_back(sample);
+        }
+        else
+        {
+            m_samples[m_next] = sample;
+            m_next = (m_next + 1) % sample_window;
+        }
+    }
+
+    int64_t timeout_policy::window::percentile(double p) const
+    {
+        std::vector<int64_t> samples(m_samples);
+        const auto nth = samples.begin() + static_cast<ptrdiff_t>(p * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    }
+
+    timeout_policy::timeout_policy(double latency_multiplier, double throughput_fraction, std::chrono::milliseconds min_timeout, std::chrono::milliseconds max_timeout)
+        : m_latency_multiplier(std::max(latency_multiplier, 1.0)),
+        m_throughput_fraction(std::min(std::max(throughput_fraction, 0.01), 1.0)),
+        m_min_timeout(min_timeout),
+        m_max_timeout(std::max(max_timeout, min_timeout)) {}
+
+    std::chrono::milliseconds timeout_policy::request_timeout(const std::string &operation, long long hint, uint64_t bytes) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto latencies = m_latencies.find(operation);
+        if (latencies == m_latencies.end() || latencies->second.size() < min_samples)
+        {
+            return std::chrono::seconds(hint);
+        }
+        std::chrono::milliseconds transfer(0);
+        if (bytes >= min_throughput_sample)
+        {
+            // Latencies observed on small bodies say nothing about a large one.
+            const double throughput = expected_throughput();
+            if (throughput <= 0)
+            {
+                return std::chrono::seconds(hint);
+            }
+            transfer = std::chrono::milliseconds(static_cast<int64_t>(1000.0 * bytes / throughput));
+        }
+        const auto timeout = std::chrono::milliseconds(static_cast<int64_t>(m_latency_multiplier * latencies->second.percentile(0.99) / 1000));
+        return std::min(std::max(timeout, m_min_timeout), m_max_timeout) + transfer;
+    }
+
+    std::chrono::seconds timeout_policy::stall_timeout() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_first_byte.size() < min_samples)
+        {
+            return default_stall_timeout;
+        }
+        // Rounded up, curl measures stalls in whole seconds.
+        const auto timeout = std::chrono::seconds(static_cast<int64_t>(m_latency_multiplier * m_first_byte.percentile(0.99) / 1000000) + 1);
+        return std::min(std::max(timeout, min_stall_timeout), default_stall_timeout);
+    }
+
+    std::chrono::milliseconds timeout_policy::transfer_timeout(uint64_t bytes) const
+    {
+        if (bytes == 0)
+        {
+            return std::chrono::milliseconds(0);
+        }
+        const auto stall = stall_timeout();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const double throughput = expected_throughput();
+        if (throughput <= 0)
+        {
+            return std::chrono::milliseconds(0);
+        }
+        const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(stall) + std::chrono::milliseconds(static_cast<int64_t>(1000.0 * bytes / throughput));
+        return std::max(timeout, m_min_timeout);
+    }
+
+    void timeout_policy::record_request(const std::string &operation, std::chrono::microseconds latency)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latencies[operation].add(latency.count());
+    }
+
+    double timeout_policy::expected_throughput() const
+    {
+        if (m_throughput.size() < min_samples)
+        {
+            return 0;
+        }
+        return std::max(m_throughput_fraction * m_throughput.percentile(0.1), 1.0);
+    }
+
+    void timeout_policy::record_transfer(uint64_t bytes, std::chrono::microseconds first_byte, std::chrono::microseconds total)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (first_byte.count() > 0)
+        {
+            m_first_byte.add(first_byte.count());
+        }
+        if (bytes >= min_throughput_sample)
+        {
+            const auto transfer_time = std::max<int64_t>(total.count() - first_byte.count(), 1000);
+            m_throughput.add(static_cast<int64_t>(bytes * 1000000.0 / transfer_time));
+        }
+    }
+
+}}  // azure::storage_lite
@@ -259,6 +259,13 @@ get_page_ranges_response tinyxml2_parser::parse_get_page_ranges_response(const s
             response.pagelist.push_back(parse_get_page_ranges_item(xitem));
             xitem = xitem->NextSiblingElement("PageRange");
         }
+
+        // ClearRange elements are only returned for diff queries against a previous snapshot.
+        xitem = xresults->FirstChildElement("ClearRange");
+        while (xitem) {
+            response.clearlist.push_back(parse_get_page_ranges_item(xitem));
+            xitem = xitem->NextSiblingElement("ClearRange");
+        }
     }
 
     return response;
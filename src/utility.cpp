@@ -79,7 +79,26 @@ namespace azure {  namespace storage_lite {
 
     std::string get_ms_date(date_format format)
     {
-        std::time_t t = std::time(nullptr);
+        // Every request carries the date, format it once per second and thread.
+        struct cached_date
+        {
+            std::time_t time = -1;
+            std::string value;
+        };
+        thread_local cached_date cache[2];
+
+        const std::time_t t = std::time(nullptr);
+        cached_date &cached = cache[format == date_format::iso_8601 ? 1 : 0];
+        if (cached.time != t)
+        {
+            cached.value = get_ms_date(format, t);
+            cached.time = t;
+        }
+        return cached.value;
+    }
+
+    std::string get_ms_date(date_format format, std::time_t t)
+    {
         std::tm *pm;
 #ifdef _WIN32
         std::tm m;
@@ -206,44 +225,42 @@ namespace azure {  namespace storage_lite {
         "%E0", "%E1", "%E2", "%E3", "%E4", "%E5", "%E6", "%E7", "%E8", "%E9", "%EA", "%EB", "%EC", "%ED", "%EE", "%EF",
         "%F0", "%F1", "%F2", "%F3", "%F4", "%F5", "%F6", "%F7", "%F8", "%F9", "%FA", "%FB", "%FC", "%FD", "%FE", "%FF"
     };
-    std::string encode_url_path(const std::string& path)
+    void append_encoded_url_path(std::string &result, const std::string &path)
     {
         static const std::vector<uint8_t> is_path_char = []()
         {
             std::vector<uint8_t> ret(256, 0);
             for (char c : std::string(unreserved) + std::string(subdelimiters) + "%!@")
             {
-                ret[c] = 1;
+                ret[static_cast<unsigned char>(c)] = 1;
             }
             // Parameter path is already joint with '/'.
             ret['/'] = 1;
             return ret;
         }();
 
-        std::string result;
+        result.reserve(result.size() + path.size());
         for (char c : path)
         {
-            if (is_path_char[c])
+            if (is_path_char[static_cast<unsigned char>(c)])
             {
                 result += c;
             }
             else
             {
-                result += encoded_chars[static_cast<unsigned char>(c)];
+                result.append(encoded_chars[static_cast<unsigned char>(c)], 3);
             }
         }
-
-        return result;
     }
 
-    std::string encode_url_query(const std::string& query)
+    void append_encoded_url_query(std::string &result, const std::string &query)
     {
         static const std::vector<uint8_t> is_query_char = []()
         {
             std::vector<uint8_t> ret(256, 0);
             for (char c : std::string(unreserved) + std::string(subdelimiters) + "%!@/?")
             {
-                ret[c] = 1;
+                ret[static_cast<unsigned char>(c)] = 1;
             }
             // Literal + needs to be encoded
             ret['+'] = 0;
@@ -252,19 +269,31 @@ namespace azure {  namespace storage_lite {
             return ret;
         }();
 
-        std::string result;
+        result.reserve(result.size() + query.size());
         for (char c : query)
         {
-            if (is_query_char[c])
+            if (is_query_char[static_cast<unsigned char>(c)])
             {
                 result += c;
             }
             else
             {
-                result += encoded_chars[static_cast<unsigned char>(c)];
+                result.append(encoded_chars[static_cast<unsigned char>(c)], 3);
             }
         }
+    }
 
+    std::string encode_url_path(const std::string& path)
+    {
+        std::string result;
+        append_encoded_url_path(result, path);
+        return result;
+    }
+
+    std::string encode_url_query(const std::string& query)
+    {
+        std::string result;
+        append_encoded_url_query(result, query);
         return result;
     }
 
@@ -1,4 +1,8 @@
 #include "blob_integration_base.h"
+#include "blob/append_blob_reader.h"
+#include "blob/append_blob_writer.h"
+
+#include <thread>
 
 #include "catch2/catch.hpp"
 
@@ -90,3 +94,159 @@ TEST_CASE("Append block from stream", "[append blob],[blob_service]")
 
     client.delete_container(container_name);
 }
+
+TEST_CASE("Append blob writer", "[append blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+    auto shared_client = std::make_shared<azure::storage_lite::blob_client>(client);
+
+    SECTION("Records from many threads are committed in few blocks")
+    {
+        const int thread_count = 8;
+        const int records_per_thread = 200;
+        std::vector<std::future<azure::storage_lite::storage_outcome<void>>> outcomes[thread_count];
+        {
+            // Only the flush commits, so every record queued by then goes out in the same block.
+            azure::storage_lite::append_blob_writer_options options;
+            options.flush_interval = std::chrono::minutes(10);
+            azure::storage_lite::append_blob_writer writer(shared_client, container_name, blob_name, options);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < thread_count; ++t)
+            {
+                threads.emplace_back([&writer, &outcomes, t]()
+                {
+                    for (int i = 0; i < records_per_thread; ++i)
+                    {
+                        outcomes[t].push_back(writer.append(std::to_string(t) + ":" + std::to_string(i) + "\n"));
+                    }
+                });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+            writer.flush();
+        }
+
+        size_t expected_size = 0;
+        for (int t = 0; t < thread_count; ++t)
+        {
+            for (int i = 0; i < records_per_thread; ++i)
+            {
+                REQUIRE(outcomes[t][i].get().success());
+                expected_size += (std::to_string(t) + ":" + std::to_string(i) + "\n").size();
+            }
+        }
+
+        auto get_blob_property_outcome = client.get_blob_properties(container_name, blob_name).get();
+        REQUIRE(get_blob_property_outcome.success());
+        REQUIRE(get_blob_property_outcome.response().size == expected_size);
+        REQUIRE(get_blob_property_outcome.response().committed_block_count == 1);
+    }
+
+    SECTION("Writer resumes at the end of an existing blob")
+    {
+        REQUIRE(client.create_append_blob(container_name, blob_name).get().success());
+        std::string existing(1024, 'a');
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, existing.data(), existing.size()).get().success());
+
+        azure::storage_lite::append_blob_writer writer(shared_client, container_name, blob_name);
+        auto first = writer.append("first");
+        auto second = writer.append("second");
+        writer.close();
+        REQUIRE(first.get().success());
+        REQUIRE(second.get().success());
+        REQUIRE(!writer.append("late").get().success());
+
+        std::stringbuf strbuf;
+        std::ostream os(&strbuf);
+        REQUIRE(client.download_blob_to_stream(container_name, blob_name, 0, existing.size() + 11, os).get().success());
+        REQUIRE(strbuf.str() == existing + "firstsecond");
+    }
+
+    SECTION("Append at a stale position unsuccessfully")
+    {
+        REQUIRE(client.create_append_blob(container_name, blob_name).get().success());
+        std::string content(512, 'b');
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, content.data(), content.size(), 0).get().success());
+        auto outcome = client.append_block_from_buffer(container_name, blob_name, content.data(), content.size(), 0).get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == "412");
+    }
+
+    client.delete_container(container_name);
+}
+
+TEST_CASE("Append blob reader", "[append blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+    auto shared_client = std::make_shared<azure::storage_lite::blob_client>(client);
+    REQUIRE(client.create_append_blob(container_name, blob_name).get().success());
+
+    std::vector<std::string> records;
+    azure::storage_lite::append_blob_reader reader(shared_client, container_name, blob_name, [&records](const char* data, size_t size)
+    {
+        records.emplace_back(data, size);
+    });
+
+    SECTION("Poll an unchanged blob without data")
+    {
+        auto outcome = reader.poll();
+        REQUIRE(outcome.success());
+        REQUIRE(outcome.response() == 0);
+        outcome = reader.poll();
+        REQUIRE(outcome.success());
+        REQUIRE(outcome.response() == 0);
+        REQUIRE(records.empty());
+    }
+
+    SECTION("Records split across appends are handed out once complete")
+    {
+        std::string first = "alpha\nbra";
+        std::string second = "vo\ncharlie\n";
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, first.data(), first.size()).get().success());
+        auto outcome = reader.poll();
+        REQUIRE(outcome.success());
+        REQUIRE(outcome.response() == first.size());
+        REQUIRE(records == std::vector<std::string>{ "alpha" });
+        REQUIRE(reader.offset() == 6);
+
+        REQUIRE(reader.poll().response() == 0);
+
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, second.data(), second.size()).get().success());
+        outcome = reader.poll();
+        REQUIRE(outcome.success());
+        REQUIRE(outcome.response() == second.size());
+        REQUIRE(records == std::vector<std::string>{ "alpha", "bravo", "charlie" });
+        REQUIRE(reader.offset() == first.size() + second.size());
+    }
+
+    SECTION("Records longer than the largest record size are handed out in pieces")
+    {
+        azure::storage_lite::append_blob_reader_options options;
+        options.max_record_size = 4;
+        std::vector<std::string> pieces;
+        azure::storage_lite::append_blob_reader bounded_reader(shared_client, container_name, blob_name, [&pieces](const char* data, size_t size)
+        {
+            pieces.emplace_back(data, size);
+        }, 0, options);
+
+        std::string first = "abcdefghij\nxy\nabc";
+        std::string second = "defgh\n";
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, first.data(), first.size()).get().success());
+        REQUIRE(bounded_reader.poll().response() == first.size());
+        REQUIRE(pieces == std::vector<std::string>{ "abcd", "efgh", "ij", "xy" });
+        REQUIRE(bounded_reader.offset() == 14);
+
+        REQUIRE(client.append_block_from_buffer(container_name, blob_name, second.data(), second.size()).get().success());
+        REQUIRE(bounded_reader.poll().response() == second.size());
+        REQUIRE(pieces == std::vector<std::string>{ "abcd", "efgh", "ij", "xy", "abcd", "efgh" });
+        REQUIRE(bounded_reader.offset() == first.size() + second.size());
+    }
+
+    client.delete_container(container_name);
+}
@@ -1,7 +1,11 @@
 #include "blob_integration_base.h"
+#include "blob/get_blob_property_request.h"
 
 #include "catch2/catch.hpp"
 
+#include <atomic>
+#include <thread>
+
 TEST_CASE("Create containers", "[container],[blob_service]")
 {
     azure::storage_lite::blob_client client = as_test::base::test_blob_client();
@@ -256,6 +260,72 @@ TEST_CASE("SAS Authorization", "[blob_service][sas]")
     REQUIRE(outcome.success());
 }
 
+TEST_CASE("SAS generation", "[sas]")
+{
+    azure::storage_lite::shared_key_credential credential("account", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+    azure::storage_lite::shared_access_signature_parameters parameters;
+    parameters.protocol = "https";
+    parameters.expires_on = std::chrono::system_clock::from_time_t(1792454400);
+
+    SECTION("Container SAS")
+    {
+        parameters.permissions = "racwdl";
+        parameters.starts_on = std::chrono::system_clock::from_time_t(1792368000);
+        REQUIRE(credential.generate_blob_sas("container", "", parameters) ==
+            "sv=2019-02-02&sr=c&sp=racwdl&st=2026-10-19T00%3A00%3A00Z&se=2026-10-20T00%3A00%3A00Z&spr=https&sig=q3ptFojxB18PCR3UpUYFMyrNf9o9UudR%2BnfnOyBmTHQ%3D");
+    }
+
+    SECTION("Account SAS")
+    {
+        parameters.permissions = "rwdlac";
+        REQUIRE(credential.generate_account_sas("b", "sco", parameters) ==
+            "sv=2019-02-02&ss=b&srt=sco&sp=rwdlac&se=2026-10-20T00%3A00%3A00Z&spr=https&sig=XoyoDX4h9qOMXYTK/3uNvXHp2VjeU0xL64FR%2BWTiz5E%3D");
+    }
+}
+
+TEST_CASE("Rotating SAS credential", "[sas]")
+{
+    auto key = std::make_shared<azure::storage_lite::shared_key_credential>("account", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+    azure::storage_lite::rotating_sas_credential credential(key);
+
+    auto token_of = [](const std::string &url)
+    {
+        return url.substr(url.find("sv="));
+    };
+
+    std::string blob_token = token_of(credential.transform_url("https://account.blob.core.windows.net/container/blob1"));
+    REQUIRE(blob_token.find("sr=c") != std::string::npos);
+    REQUIRE(token_of(credential.transform_url("https://account.blob.core.windows.net/container/dir/blob2")) == blob_token);
+    REQUIRE(token_of(credential.transform_url("http://127.0.0.1:10000/account/container/blob3")) == blob_token);
+    REQUIRE(token_of(credential.transform_url("https://account.blob.core.windows.net/other/blob1")) != blob_token);
+
+    std::string account_token = token_of(credential.transform_url("https://account.blob.core.windows.net/container?restype=container"));
+    REQUIRE(account_token.find("srt=sco") != std::string::npos);
+    REQUIRE(credential.transform_url("https://account.blob.core.windows.net/?comp=list") == "https://account.blob.core.windows.net/?comp=list&" + account_token);
+}
+
+TEST_CASE("Rotating SAS Authorization", "[blob_service][sas]")
+{
+    auto key = std::dynamic_pointer_cast<azure::storage_lite::shared_key_credential>(as_test::base::test_blob_client().account()->credential());
+    auto cred = std::make_shared<azure::storage_lite::rotating_sas_credential>(key);
+    auto account = std::make_shared<azure::storage_lite::storage_account>(key->account_name(), cred);
+    auto client = std::make_shared<azure::storage_lite::blob_client>(account, 1);
+
+    std::string container_name = as_test::get_random_string(10);
+    auto outcome = client->create_container(container_name).get();
+    REQUIRE(outcome.success());
+    std::string content = as_test::get_random_string(100);
+    std::istringstream iss(content);
+    outcome = client->upload_block_blob_from_stream(container_name, "blob", iss, std::vector<std::pair<std::string, std::string>>()).get();
+    REQUIRE(outcome.success());
+    std::ostringstream oss;
+    outcome = client->download_blob_to_stream(container_name, "blob", 0, 0, oss).get();
+    REQUIRE(outcome.success());
+    REQUIRE(oss.str() == content);
+    outcome = client->delete_container(container_name).get();
+    REQUIRE(outcome.success());
+}
+
 TEST_CASE("Token Authorization", "[blob_service][token]")
 {
     std::string account_name = "";
@@ -274,4 +344,82 @@ TEST_CASE("Token Authorization", "[blob_service][token]")
     REQUIRE(outcome.success());
     outcome = client->delete_container(container_name).get();
     REQUIRE(outcome.success());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Token credential refresh", "[token]")
+{
+    // A local stand-in for a token service, issuing numbered tokens and failing every third call.
+    std::atomic<int> calls(0);
+    std::atomic<long long> lifetime_ms(3600 * 1000);
+    auto provider = [&calls, &lifetime_ms]()
+    {
+        int call = ++calls;
+        if (call % 3 == 0)
+        {
+            throw std::runtime_error("token service unavailable");
+        }
+        azure::storage_lite::access_token token;
+        token.token = "token-" + std::to_string(call);
+        token.expires_on = std::chrono::system_clock::now() + std::chrono::milliseconds(lifetime_ms.load());
+        return token;
+    };
+
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+    auto http = client->get_handle();
+    auto authorization = [&http](const azure::storage_lite::token_credential &credential)
+    {
+        http->reset();
+        credential.sign_request(azure::storage_lite::get_blob_property_request("container", "blob"), *http, azure::storage_lite::storage_url(), azure::storage_lite::storage_headers());
+        return http->get_request_headers().at("Authorization");
+    };
+
+    SECTION("Renewals replace the token and failures keep it")
+    {
+        // Tokens live for an hour, so only refresh_now renews them during the test.
+        azure::storage_lite::token_credential credential(provider, std::chrono::seconds(1));
+        REQUIRE(calls.load() == 1);
+        REQUIRE(authorization(credential) == "Bearer token-1");
+
+        REQUIRE(credential.refresh_now());
+        REQUIRE(calls.load() == 2);
+        REQUIRE(authorization(credential) == "Bearer token-2");
+
+        REQUIRE(!credential.refresh_now());
+        REQUIRE(calls.load() == 3);
+        REQUIRE(authorization(credential) == "Bearer token-2");
+
+        REQUIRE(credential.refresh_now());
+        REQUIRE(authorization(credential) == "Bearer token-4");
+
+        credential.set_token("manual");
+        REQUIRE(authorization(credential) == "Bearer manual");
+    }
+
+    SECTION("The refresh thread renews a token ahead of its expiry")
+    {
+        lifetime_ms = 2000;
+        {
+            azure::storage_lite::token_credential credential(provider, std::chrono::seconds(1));
+            REQUIRE(authorization(credential) == "Bearer token-1");
+
+            // Renewed about a second in, waiting for the state rather than for a fixed time.
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            while (authorization(credential) == "Bearer token-1" && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            REQUIRE(authorization(credential) == "Bearer token-2");
+        }
+        // Destroying the credential joins the refresh thread, nothing calls the provider afterwards.
+        const int calls_after_stop = calls.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        REQUIRE(calls.load() == calls_after_stop);
+    }
+
+    SECTION("A credential with a fixed token has nothing to renew")
+    {
+        azure::storage_lite::token_credential credential("fixed");
+        REQUIRE(!credential.refresh_now());
+        REQUIRE(authorization(credential) == "Bearer fixed");
+    }
+}
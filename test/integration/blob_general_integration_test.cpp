@@ -1,7 +1,22 @@
 #include "blob_integration_base.h"
 
+#include "bandwidth_throttle.h"
+#include "base64.h"
+#include "blob/blob_batch_request.h"
+#include "circuit_breaker.h"
+#include "hash.h"
+#include "hedging.h"
+#include "pool_manager.h"
+#include "request_governor.h"
+#include "blob/get_blob_property_request.h"
+#include "storage_errno.h"
+#include "timeout_policy.h"
+
 #include "catch2/catch.hpp"
 
+#include <random>
+#include <thread>
+
 // List all blobs that returns a iterator is going to be supported in the future, and this test case set will be valid again.
 
 //TEST_CASE("List blobs", "[blob],[blob_service]")
@@ -116,6 +131,124 @@ TEST_CASE("Storage endpoint", "[endpoint]")
     }
 }
 
+TEST_CASE("Storage url", "[endpoint]")
+{
+    azure::storage_lite::storage_url url;
+    url.set_domain("https://account.blob.core.windows.net").append_path("container").append_path("dir/\xE6\x96\x87 1+2");
+    url.add_query("comp", "list").add_query("include", "snapshots").add_query("include", "metadata").add_query("comp", "list").add_query("prefix", "a=b");
+
+    REQUIRE(url.get_query().size() == 4);
+    REQUIRE(url.to_string() == "https://account.blob.core.windows.net/container/dir/%E6%96%87%201+2?comp=list&include=metadata&include=snapshots&prefix=a%3Db");
+}
+
+TEST_CASE("Response headers", "[headers]")
+{
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+    auto http = client->get_handle();
+    auto receive = [&http](std::string line)
+    {
+        line.append("\r\n");
+        REQUIRE(azure::storage_lite::CurlEasyRequest::header_callback(&line[0], 1, line.size(), http.get()) == line.size());
+    };
+
+    SECTION("A status line drops the headers of an interim response")
+    {
+        receive("HTTP/1.1 100 Continue");
+        receive("ETag: \"interim\"");
+        receive("x-ms-interim: 1");
+        receive("");
+        REQUIRE(http->status_code() == 100);
+        REQUIRE(http->get_response_header("ETag") == "\"interim\"");
+
+        receive("HTTP/1.1 201 Created");
+        receive("Content-Length: 0");
+        REQUIRE(http->status_code() == 201);
+        REQUIRE(http->get_response_header("ETag").empty());
+        REQUIRE(http->get_response_header("x-ms-interim").empty());
+        REQUIRE(http->get_response_header("Content-Length") == "0");
+        REQUIRE(http->get_response_headers().size() == 1);
+    }
+
+    SECTION("A status line drops the headers of a redirect")
+    {
+        receive("HTTP/1.1 302 Found");
+        receive("Location: https://other.blob.core.windows.net/container/blob");
+        receive("ETag: \"old\"");
+        receive("");
+        receive("HTTP/1.1 200 OK");
+        receive("ETag: \"new\"");
+        receive("");
+        REQUIRE(http->status_code() == 200);
+        REQUIRE(http->get_response_header("Location").empty());
+        REQUIRE(http->get_response_header("ETag") == "\"new\"");
+    }
+
+    SECTION("Whitespace around values is trimmed")
+    {
+        receive("HTTP/1.1 200 OK");
+        receive("ETag:   \"0x8D\" \t");
+        receive("x-ms-meta-key:\tvalue with spaces  ");
+        receive("Content-Type:");
+        receive("Content-Encoding:  \t ");
+        REQUIRE(http->get_response_header("ETag") == "\"0x8D\"");
+        REQUIRE(http->get_response_header("x-ms-meta-key") == "value with spaces");
+        REQUIRE(http->get_response_header("Content-Type").empty());
+        REQUIRE(http->get_response_header("Content-Encoding").empty());
+        REQUIRE(http->get_response_headers().size() == 4);
+    }
+
+    SECTION("Names are compared without case and the latest value wins")
+    {
+        receive("HTTP/1.1 200 OK");
+        receive("etag: \"first\"");
+        receive("x-ms-meta-key: first");
+        REQUIRE(http->get_response_header("ETAG") == "\"first\"");
+        REQUIRE(http->get_response_header("X-MS-META-KEY") == "first");
+
+        receive("ETag: \"second\"");
+        receive("X-Ms-Meta-Key: second");
+        REQUIRE(http->get_response_header("etag") == "\"second\"");
+        REQUIRE(http->get_response_header("x-ms-meta-key") == "second");
+        REQUIRE(http->get_response_headers().size() == 4);
+    }
+
+    SECTION("Every header the library reads is found, unknown ones are kept too")
+    {
+        const char *const names[] = {
+            "Cache-Control", "Content-Disposition", "Content-Encoding", "Content-Language", "Content-Length", "Content-MD5",
+            "Content-Range", "Content-Type", "ETag", "Last-Modified", "x-ms-acl", "x-ms-blob-committed-block-count", "x-ms-blob-sequence-number", "x-ms-blob-type",
+            "x-ms-content-crc64", "x-ms-continuation", "x-ms-copy-status", "x-ms-group", "x-ms-lease-id", "x-ms-owner",
+            "x-ms-permissions", "x-ms-snapshot" };
+        receive("HTTP/1.1 200 OK");
+        for (const auto name : names)
+        {
+            receive(std::string(name) + ": value of " + name);
+        }
+        receive("x-ms-request-id: 0d6f1c7e");
+        // Near misses of known names are unknown headers of their own.
+        receive("ETa: short");
+        receive("ETagX: long");
+        for (const auto name : names)
+        {
+            REQUIRE(http->get_response_header(name) == std::string("value of ") + name);
+        }
+        REQUIRE(http->get_response_header("x-ms-request-id") == "0d6f1c7e");
+        REQUIRE(http->get_response_header("ETa") == "short");
+        REQUIRE(http->get_response_header("ETagX") == "long");
+        REQUIRE(http->get_response_headers().size() == sizeof(names) / sizeof(names[0]) + 3);
+    }
+
+    SECTION("A missing header is empty")
+    {
+        receive("HTTP/1.1 404 The specified blob does not exist.");
+        receive("x-ms-error-code: BlobNotFound");
+        REQUIRE(http->status_code() == 404);
+        REQUIRE(http->get_response_header("ETag").empty());
+        REQUIRE(http->get_response_header("x-ms-request-id").empty());
+        REQUIRE(http->get_response_header("").empty());
+    }
+}
+
 TEST_CASE("List blobs segmented", "[blob],[blob_service]")
 {
     azure::storage_lite::blob_client client = as_test::base::test_blob_client();
@@ -303,3 +436,740 @@ TEST_CASE("Start copy blob", "[blob],[blob_service]")
 
     client.delete_container(container_name);
 }
+
+TEST_CASE("Base64", "[base64]")
+{
+    SECTION("Round trip across vector and scalar lengths")
+    {
+        std::mt19937 gen(static_cast<unsigned>(std::random_device()()));
+        std::uniform_int_distribution<int> distrib(0, 255);
+        for (size_t length = 0; length < 300; ++length)
+        {
+            std::vector<unsigned char> data(length);
+            for (auto &c : data)
+            {
+                c = static_cast<unsigned char>(distrib(gen));
+            }
+            auto encoded = azure::storage_lite::to_base64(data);
+            REQUIRE(encoded.size() == (length + 2) / 3 * 4);
+            REQUIRE(azure::storage_lite::from_base64(encoded) == data);
+        }
+    }
+
+    SECTION("Matches the reference encoder")
+    {
+        for (size_t length : {1, 2, 3, 15, 16, 17, 47, 48, 100, 1000})
+        {
+            std::string data = as_test::get_random_string(length);
+            REQUIRE(azure::storage_lite::to_base64(reinterpret_cast<const unsigned char*>(data.data()), data.size()) == as_test::to_base64(data.data(), data.size()));
+        }
+    }
+
+    SECTION("Rejects invalid input anywhere in the string")
+    {
+        const std::string encoded = azure::storage_lite::to_base64(std::vector<unsigned char>(96, 'a'));
+        for (size_t position : {0, 5, 31, 40, 63, 100, 125})
+        {
+            std::string invalid = encoded;
+            invalid[position] = '!';
+            REQUIRE_THROWS_WITH(azure::storage_lite::from_base64(invalid), "invalid character found in base64 string");
+            invalid[position] = '=';
+            REQUIRE_THROWS_WITH(azure::storage_lite::from_base64(invalid), "invalid padding character found in base64 string");
+        }
+        REQUIRE_THROWS_WITH(azure::storage_lite::from_base64(encoded.substr(1)), "length of base64 string is not an even multiple of 4");
+        REQUIRE_THROWS_WITH(azure::storage_lite::from_base64("QR=="), "Invalid end of base64 string");
+        REQUIRE(azure::storage_lite::from_base64("QQ==") == std::vector<unsigned char>{'A'});
+    }
+}
+
+TEST_CASE("Shared key signing", "[credential]")
+{
+    SECTION("HMAC-SHA256 signer")
+    {
+        azure::storage_lite::hmac_sha256_signer signer(std::vector<unsigned char>{'J', 'e', 'f', 'e'});
+        REQUIRE(signer.sign("what do ya want for nothing?") == "W9zBRr9gdU5qBCQmCJV1x1oAPwidJzmDnexYuWTsOEM=");
+        // Signing again starts over from the keyed state.
+        REQUIRE(signer.sign("what do ya want for nothing?") == "W9zBRr9gdU5qBCQmCJV1x1oAPwidJzmDnexYuWTsOEM=");
+
+        azure::storage_lite::hmac_sha256_signer long_key_signer(std::vector<unsigned char>(131, 0xaa));
+        REQUIRE(long_key_signer.sign("Test Using Larger Than Block-Size Key - Hash Key First") == "YOQxWR7gtn8Niiaqy/W3f44LxiE3KMUUBUYEDw7jf1Q=");
+    }
+
+    SECTION("Canonicalized headers are ordered by lowercase name")
+    {
+        azure::storage_lite::shared_key_credential credential("account", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+        auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+        auto http = client->get_handle();
+        http->set_method(azure::storage_lite::http_base::http_method::put);
+
+        azure::storage_lite::storage_url url;
+        url.append_path("container").append_path("blob").add_query("comp", "metadata");
+        azure::storage_lite::storage_headers headers;
+        headers.content_length = "0";
+        headers.ms_headers["x-ms-version"] = "2019-02-02";
+        headers.ms_headers["x-ms-date"] = "Mon, 19 Oct 2026 00:00:00 GMT";
+        headers.ms_headers["x-ms-meta-alpha"] = "1";
+        headers.ms_headers["x-ms-meta-Zeta"] = "2";
+
+        credential.sign_request(azure::storage_lite::get_blob_property_request("container", "blob"), *http, url, headers);
+        REQUIRE(http->get_request_headers().at("Authorization") == "SharedKey account:lhHQ711mILkXKvk4JLXrh4X2dsBXKOP5ljfvdhAC10g=");
+    }
+}
+
+TEST_CASE("Hedging policy", "[hedging]")
+{
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+
+    azure::storage_lite::hedging_policy policy(0.9, 0.1, 1024, milliseconds(1), milliseconds(200));
+
+    SECTION("The delay is the upper bound until enough reads complete")
+    {
+        REQUIRE(policy.delay() == microseconds(200000));
+        for (int i = 0; i < 10; ++i)
+        {
+            policy.record(milliseconds(5));
+        }
+        REQUIRE(policy.delay() == microseconds(200000));
+    }
+
+    SECTION("The delay follows the percentile of recent latencies within its bounds")
+    {
+        for (int i = 1; i <= 100; ++i)
+        {
+            policy.record(milliseconds(i));
+        }
+        REQUIRE(policy.delay() >= milliseconds(89));
+        REQUIRE(policy.delay() <= milliseconds(91));
+
+        // Older latencies leave the window.
+        for (int i = 0; i < 256; ++i)
+        {
+            policy.record(microseconds(10));
+        }
+        REQUIRE(policy.delay() == milliseconds(1));
+        for (int i = 0; i < 256; ++i)
+        {
+            policy.record(std::chrono::seconds(10));
+        }
+        REQUIRE(policy.delay() == milliseconds(200));
+    }
+
+    SECTION("Hedges are limited to a fraction of the reads")
+    {
+        REQUIRE(!policy.try_hedge());
+        int hedges = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            policy.record(milliseconds(1));
+            if (policy.try_hedge())
+            {
+                ++hedges;
+            }
+        }
+        REQUIRE(hedges >= 99);
+        REQUIRE(hedges <= 100);
+    }
+}
+
+TEST_CASE("Cancellation token", "[cancellation]")
+{
+    SECTION("Copies share the cancellation")
+    {
+        azure::storage_lite::cancellation_token token;
+        auto copy = token;
+        REQUIRE(!copy.is_cancelled());
+        token.cancel();
+        REQUIRE(copy.is_cancelled());
+        REQUIRE(!copy.is_expired());
+
+        auto none = azure::storage_lite::cancellation_token::none();
+        none.cancel();
+        REQUIRE(!none.is_cancelled());
+        REQUIRE(!none.has_deadline());
+    }
+
+    SECTION("A deadline cancels once it passes")
+    {
+        auto token = azure::storage_lite::cancellation_token::with_timeout(std::chrono::milliseconds(50));
+        REQUIRE(token.has_deadline());
+        REQUIRE(!token.is_cancelled());
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        REQUIRE(token.is_expired());
+        REQUIRE(token.is_cancelled());
+    }
+
+    SECTION("Operations of a cancelled client fail without sending a request")
+    {
+        // Nothing listens on this endpoint, the requests must never be sent.
+        auto account = std::make_shared<azure::storage_lite::storage_account>("account", std::make_shared<azure::storage_lite::anonymous_credential>(), false, "127.0.0.1:9");
+        azure::storage_lite::blob_client client(account, 1);
+
+        azure::storage_lite::cancellation_token token;
+        token.cancel();
+        auto outcome = client.with_cancellation(token).delete_container("container").get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(operation_cancelled));
+
+        auto expired = azure::storage_lite::cancellation_token::with_deadline(std::chrono::steady_clock::now());
+        auto properties = client.with_cancellation(expired).get_blob_properties("container", "blob").get();
+        REQUIRE(!properties.success());
+        REQUIRE(properties.error().code == std::to_string(operation_timed_out));
+
+        auto http = client.client()->get_handle();
+        http->cancel();
+        REQUIRE(http->perform() == CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+TEST_CASE("Circuit breaker", "[circuit]")
+{
+    using azure::storage_lite::circuit_breaker;
+    const std::string endpoint = "https://account.blob.core.windows.net";
+
+    SECTION("Endpoints are told apart by scheme, host and port")
+    {
+        REQUIRE(circuit_breaker::endpoint_of("https://account.blob.core.windows.net/container/blob?comp=list") == endpoint);
+        REQUIRE(circuit_breaker::endpoint_of("http://127.0.0.1:10000/account/container") == "http://127.0.0.1:10000");
+        REQUIRE(circuit_breaker::endpoint_of("https://account.blob.core.windows.net?restype=service") == endpoint);
+    }
+
+    SECTION("The circuit opens on the failure ratio and probes after a while")
+    {
+        circuit_breaker breaker(0.5, 4, std::chrono::milliseconds(10000), std::chrono::milliseconds(50), 1);
+        for (int i = 0; i < 3; ++i)
+        {
+            auto admission = breaker.allow(endpoint);
+            REQUIRE(admission);
+            REQUIRE(!admission.probe);
+            breaker.record(endpoint, admission, circuit_breaker::result::failure);
+        }
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::closed);
+        auto admission = breaker.allow(endpoint);
+        REQUIRE(admission);
+        breaker.record(endpoint, admission, circuit_breaker::result::success);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::closed);
+        admission = breaker.allow(endpoint);
+        REQUIRE(admission);
+        breaker.record(endpoint, admission, circuit_breaker::result::failure);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::open);
+        REQUIRE(!breaker.allow(endpoint));
+        REQUIRE(breaker.allow("https://other.blob.core.windows.net"));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        admission = breaker.allow(endpoint);
+        REQUIRE(admission);
+        REQUIRE(admission.probe);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::half_open);
+        REQUIRE(!breaker.allow(endpoint));
+        breaker.record(endpoint, admission, circuit_breaker::result::failure);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::open);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        admission = breaker.allow(endpoint);
+        REQUIRE(admission);
+        breaker.record(endpoint, admission, circuit_breaker::result::neutral);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::half_open);
+        admission = breaker.allow(endpoint);
+        REQUIRE(admission);
+        breaker.record(endpoint, admission, circuit_breaker::result::success);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::closed);
+    }
+
+    SECTION("Requests let through before the circuit opened are not taken for probes")
+    {
+        circuit_breaker breaker(0.5, 2, std::chrono::milliseconds(10000), std::chrono::milliseconds(50), 1);
+        auto slow_success = breaker.allow(endpoint);
+        auto slow_failure = breaker.allow(endpoint);
+        for (int i = 0; i < 2; ++i)
+        {
+            auto admission = breaker.allow(endpoint);
+            breaker.record(endpoint, admission, circuit_breaker::result::failure);
+        }
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::open);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        auto probe = breaker.allow(endpoint);
+        REQUIRE(probe.probe);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::half_open);
+
+        // Requests sent while closed finish now, they neither close nor reopen the circuit nor free the probe slot.
+        breaker.record(endpoint, slow_success, circuit_breaker::result::success);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::half_open);
+        breaker.record(endpoint, slow_failure, circuit_breaker::result::failure);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::half_open);
+        REQUIRE(!breaker.allow(endpoint));
+
+        breaker.record(endpoint, probe, circuit_breaker::result::success);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::closed);
+        // A second report of the probe after the circuit closed changes nothing.
+        breaker.record(endpoint, probe, circuit_breaker::result::failure);
+        REQUIRE(breaker.get_state(endpoint) == circuit_breaker::state::closed);
+    }
+
+    SECTION("Operations fail fast while the circuit is open")
+    {
+        // Nothing listens on this endpoint, every attempt fails to connect.
+        auto account = std::make_shared<azure::storage_lite::storage_account>("account", std::make_shared<azure::storage_lite::anonymous_credential>(), false, "127.0.0.1:9");
+        azure::storage_lite::blob_client client(account, 1);
+        auto breaker = std::make_shared<circuit_breaker>(0.5, 4, std::chrono::milliseconds(10000), std::chrono::milliseconds(60000), 1);
+        client.context()->set_circuit_breaker(breaker);
+
+        auto outcome = client.delete_container("container").get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(CURLE_COULDNT_CONNECT));
+        REQUIRE(breaker->get_state("http://127.0.0.1:9") == circuit_breaker::state::open);
+
+        auto properties = client.get_blob_properties("container", "blob").get();
+        REQUIRE(!properties.success());
+        REQUIRE(properties.error().code == std::to_string(circuit_open));
+    }
+}
+
+TEST_CASE("Handle priorities", "[priority]")
+{
+    using azure::storage_lite::request_priority;
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(4);
+    client->set_reserved_handles(request_priority::interactive, 1);
+    client->set_reserved_handles(request_priority::normal, 1);
+
+    SECTION("Nothing is reserved by default")
+    {
+        auto unreserved = std::make_shared<azure::storage_lite::CurlEasyClient>(16);
+        std::vector<std::shared_ptr<azure::storage_lite::CurlEasyRequest>> handles;
+        for (int i = 0; i < 16; ++i)
+        {
+            handles.push_back(unreserved->try_get_handle(i % 2 == 0 ? request_priority::bulk : request_priority::normal));
+            REQUIRE(handles.back());
+        }
+        REQUIRE(!unreserved->try_get_handle(request_priority::interactive));
+    }
+
+    SECTION("Requests leave the handles reserved for higher priorities")
+    {
+        auto bulk1 = client->try_get_handle(request_priority::bulk);
+        auto bulk2 = client->try_get_handle(request_priority::bulk);
+        REQUIRE(bulk1);
+        REQUIRE(bulk2);
+        REQUIRE(!client->try_get_handle(request_priority::bulk));
+        auto normal = client->try_get_handle(request_priority::normal);
+        REQUIRE(normal);
+        REQUIRE(!client->try_get_handle(request_priority::normal));
+        auto interactive = client->try_get_handle(request_priority::interactive);
+        REQUIRE(interactive);
+        REQUIRE(!client->try_get_handle(request_priority::interactive));
+    }
+
+    SECTION("Freed handles go to interactive requests before bulk ones")
+    {
+        auto bulk1 = client->get_handle(request_priority::bulk);
+        auto bulk2 = client->get_handle(request_priority::bulk);
+        auto normal = client->get_handle(request_priority::normal);
+        auto interactive = client->get_handle(request_priority::interactive);
+
+        std::atomic<bool> got_bulk{ false };
+        std::thread waiting([&client, &got_bulk]()
+        {
+            auto handle = client->get_handle(request_priority::bulk);
+            got_bulk = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        interactive.reset();
+        interactive = client->get_handle(request_priority::interactive);
+        REQUIRE(interactive);
+        bulk1.reset();
+        bulk2.reset();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(!got_bulk);
+        normal.reset();
+        waiting.join();
+        REQUIRE(got_bulk);
+    }
+}
+
+TEST_CASE("Handle pool metrics", "[pool]")
+{
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(4);
+    const int thread_count = 8;
+    const int acquisitions = 200;
+
+    std::atomic<int> acquired{ 0 };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back([&client, &acquired]()
+        {
+            for (int j = 0; j < acquisitions; ++j)
+            {
+                auto http = client->get_handle(j % 2 == 0 ? azure::storage_lite::request_priority::normal : azure::storage_lite::request_priority::bulk);
+                acquired += http ? 1 : 0;
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    REQUIRE(acquired == thread_count * acquisitions);
+
+    auto metrics = client->metrics();
+    REQUIRE(metrics.size == 4);
+    REQUIRE(metrics.in_use == 0);
+    REQUIRE(metrics.waiting == 0);
+    REQUIRE(metrics.peak_in_use > 0);
+    REQUIRE(metrics.peak_in_use <= 4);
+    REQUIRE(metrics.acquisitions == uint64_t(thread_count * acquisitions));
+    uint64_t histogram_total = 0;
+    for (auto count : metrics.wait_histogram)
+    {
+        histogram_total += count;
+    }
+    REQUIRE(histogram_total == metrics.acquisitions);
+    REQUIRE(metrics.wait_percentile(0.5) <= metrics.wait_percentile(0.99));
+    REQUIRE(metrics.utilization >= 0.0);
+    REQUIRE(metrics.utilization <= 1.0);
+
+    // Every handle is back, so all of them can be held at once.
+    std::vector<std::shared_ptr<azure::storage_lite::CurlEasyRequest>> handles;
+    for (int i = 0; i < 4; ++i)
+    {
+        handles.push_back(client->try_get_handle(azure::storage_lite::request_priority::interactive));
+        REQUIRE(handles.back());
+    }
+    REQUIRE(!client->try_get_handle(azure::storage_lite::request_priority::interactive));
+    REQUIRE(client->metrics().in_use == 4);
+}
+
+TEST_CASE("Lazy handles", "[pool]")
+{
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(4);
+    REQUIRE(client->metrics().created == 0);
+
+    client->get_handle();
+    client->get_handle();
+    REQUIRE(client->metrics().created == 1);
+
+    client->prewarm(3);
+    for (int i = 0; i < 100 && client->metrics().created < 3; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(client->metrics().created == 3);
+    for (int i = 0; i < 100 && client->metrics().in_use > 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(client->metrics().in_use == 0);
+}
+
+TEST_CASE("Pool manager", "[pool]")
+{
+    auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(4);
+
+    SECTION("Handles kept warm are created and idle ones are reaped")
+    {
+        // Nothing listens on this endpoint, the HEAD requests fail at once.
+        azure::storage_lite::pool_manager manager(client, "http://127.0.0.1:9/", 2, std::chrono::seconds(60), std::chrono::seconds(120));
+        manager.maintain();
+        auto metrics = client->metrics();
+        REQUIRE(metrics.created == 2);
+        REQUIRE(metrics.in_use == 0);
+
+        auto http = client->get_handle();
+        REQUIRE(http->last_used() > std::chrono::steady_clock::time_point());
+        http.reset();
+
+        REQUIRE(client->reap_idle(std::chrono::hours(1)) == 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(client->reap_idle(std::chrono::milliseconds(10)) == 2);
+        REQUIRE(client->metrics().created == 0);
+
+        http = client->get_handle();
+        REQUIRE(http->last_used() == std::chrono::steady_clock::time_point());
+        REQUIRE(client->metrics().created == 1);
+    }
+}
+
+TEST_CASE("Bandwidth throttle", "[throttle]")
+{
+    using std::chrono::microseconds;
+
+    SECTION("Bytes beyond the burst wait for the rate")
+    {
+        azure::storage_lite::token_bucket bucket(1000, 1000);
+        REQUIRE(bucket.limited());
+        REQUIRE(bucket.take(1000) == microseconds(0));
+        auto wait = bucket.take(500);
+        REQUIRE(wait > microseconds(450000));
+        REQUIRE(wait <= microseconds(500000));
+        // Debt accumulates, a second taker waits behind the first.
+        REQUIRE(bucket.take(500) > microseconds(950000));
+    }
+
+    SECTION("The rate can change at runtime")
+    {
+        azure::storage_lite::bandwidth_throttle throttle(0, 1000000);
+        REQUIRE(!throttle.upload().limited());
+        REQUIRE(throttle.upload().take(100000000) == microseconds(0));
+        REQUIRE(throttle.download().chunk_size() == 100000);
+
+        throttle.upload().set_rate(10000);
+        REQUIRE(throttle.upload().limited());
+        REQUIRE(throttle.upload().chunk_size() == 4096);
+        REQUIRE(throttle.upload().take(1000) == microseconds(0));
+        REQUIRE(throttle.upload().take(1000) > microseconds(0));
+
+        throttle.upload().set_rate(0);
+        REQUIRE(throttle.upload().take(1000000) == microseconds(0));
+    }
+}
+
+TEST_CASE("Request governor", "[governor]")
+{
+    using std::chrono::milliseconds;
+    using std::chrono::nanoseconds;
+    using azure::storage_lite::request_governor;
+
+    SECTION("Requests are told apart by container")
+    {
+        azure::storage_lite::storage_account account("account", std::make_shared<azure::storage_lite::anonymous_credential>());
+        REQUIRE(request_governor::container_of(account, "https://account.blob.core.windows.net/container/dir/blob?comp=metadata") == "container");
+        REQUIRE(request_governor::container_of(account, "https://account.blob.core.windows.net/container?restype=container") == "container");
+        REQUIRE(request_governor::container_of(account, "https://account.blob.core.windows.net/?comp=list").empty());
+        REQUIRE(request_governor::container_of(account, "https://account.blob.core.windows.net").empty());
+
+        azure::storage_lite::storage_account emulator("devstoreaccount1", std::make_shared<azure::storage_lite::anonymous_credential>(), false, "127.0.0.1:10000/devstoreaccount1");
+        REQUIRE(request_governor::container_of(emulator, "http://127.0.0.1:10000/devstoreaccount1/container/blob") == "container");
+        REQUIRE(request_governor::container_of(emulator, "http://127.0.0.1:10000/devstoreaccount1?comp=list").empty());
+    }
+
+    SECTION("Requests are spaced evenly")
+    {
+        request_governor governor(100, 0, milliseconds(0));
+        REQUIRE(governor.reserve("") == nanoseconds(0));
+        for (int i = 1; i < 5; ++i)
+        {
+            auto wait = governor.reserve("container");
+            REQUIRE(wait > milliseconds(10 * i - 5));
+            REQUIRE(wait <= milliseconds(10 * i));
+        }
+
+        governor.set_rate(0);
+        REQUIRE(governor.reserve("container") == nanoseconds(0));
+    }
+
+    SECTION("Each container has its own rate")
+    {
+        request_governor governor(0, 10, milliseconds(0));
+        REQUIRE(governor.reserve("a") == nanoseconds(0));
+        REQUIRE(governor.reserve("a") > milliseconds(90));
+        REQUIRE(governor.reserve("b") == nanoseconds(0));
+        REQUIRE(governor.reserve("") == nanoseconds(0));
+    }
+
+    SECTION("A burst is allowed after a quiet period")
+    {
+        request_governor governor(100, 0, milliseconds(30));
+        for (int i = 0; i < 4; ++i)
+        {
+            REQUIRE(governor.reserve("") == nanoseconds(0));
+        }
+        REQUIRE(governor.reserve("") > nanoseconds(0));
+    }
+
+    SECTION("Waiting stops when cancelled")
+    {
+        request_governor governor(1, 0, milliseconds(0));
+        REQUIRE(governor.wait("", []() { return false; }));
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(!governor.wait("", []() { return true; }));
+        REQUIRE(std::chrono::steady_clock::now() - start < milliseconds(500));
+    }
+
+    SECTION("A waiting request gives its handle back")
+    {
+        auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+        auto waiting = client->get_handle();
+        waiting->set_absolute_timeout(30L);
+        REQUIRE(client->try_get_handle() == nullptr);
+
+        waiting->suspend();
+        REQUIRE(client->metrics().in_use == 0);
+        {
+            auto other = client->try_get_handle();
+            REQUIRE(other != nullptr);
+        }
+
+        waiting->resume();
+        REQUIRE(client->metrics().in_use == 1);
+        REQUIRE(client->try_get_handle() == nullptr);
+    }
+}
+
+TEST_CASE("Blob batch", "[batch]")
+{
+    using azure::storage_lite::blob_batch_request;
+    using azure::storage_lite::blob_batch_request_base;
+    using azure::storage_lite::delete_blob_request_base;
+    using azure::storage_lite::access_tier;
+
+    auto account = std::make_shared<azure::storage_lite::storage_account>("account", std::make_shared<azure::storage_lite::shared_key_credential>("account", "a2V5"));
+
+    SECTION("Sub-requests are signed one by one")
+    {
+        blob_batch_request request({
+            blob_batch_request_base::subrequest{ blob_batch_request_base::operation::del, "container", "dir/blob 1", delete_blob_request_base::delete_snapshots::include, access_tier::hot },
+            blob_batch_request_base::subrequest{ blob_batch_request_base::operation::set_tier, "container", "blob2", delete_blob_request_base::delete_snapshots::unspecified, access_tier::cool } });
+        const std::string delimiter = "--" + request.boundary();
+
+        auto body = request.build_body(*account);
+        REQUIRE(body.compare(0, delimiter.size() + 2, delimiter + "\r\n") == 0);
+        REQUIRE(body.find("Content-ID: 0\r\n\r\nDELETE /container/dir/blob%201 HTTP/1.1\r\n") != std::string::npos);
+        REQUIRE(body.find("x-ms-delete-snapshots: include\r\n") != std::string::npos);
+        REQUIRE(body.find("Content-ID: 1\r\n\r\nPUT /container/blob2?comp=tier HTTP/1.1\r\n") != std::string::npos);
+        REQUIRE(body.find("x-ms-access-tier: Cool\r\n") != std::string::npos);
+        REQUIRE(body.find("x-ms-version") == std::string::npos);
+
+        size_t signatures = 0;
+        for (size_t pos = body.find("Authorization: SharedKey account:"); pos != std::string::npos; pos = body.find("Authorization: SharedKey account:", pos + 1))
+        {
+            ++signatures;
+        }
+        REQUIRE(signatures == 2);
+        REQUIRE(body.size() >= delimiter.size() + 4);
+        REQUIRE(body.compare(body.size() - delimiter.size() - 4, std::string::npos, delimiter + "--\r\n") == 0);
+
+        auto client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+        auto http = client->get_handle();
+        request.build_request(*account, *http);
+        REQUIRE(http->get_url() == "https://account.blob.core.windows.net/?comp=batch");
+        REQUIRE(http->get_method() == azure::storage_lite::http_base::http_method::post);
+        REQUIRE(http->get_request_headers().at("Content-Type") == "multipart/mixed; boundary=" + request.boundary());
+        REQUIRE(std::stoul(http->get_request_headers().at("Content-Length")) == body.size());
+    }
+
+    SECTION("Sub-responses are matched to their sub-requests")
+    {
+        const std::string body =
+            "--batchresponse_1\r\n"
+            "Content-Type: application/http\r\n"
+            "Content-ID: 1\r\n"
+            "\r\n"
+            "HTTP/1.1 404 The specified blob does not exist.\r\n"
+            "x-ms-error-code: BlobNotFound\r\n"
+            "Content-Type: application/xml\r\n"
+            "\r\n"
+            "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+            "<Error><Code>BlobNotFound</Code><Message>The specified blob does not exist.</Message></Error>\r\n"
+            "--batchresponse_1\r\n"
+            "Content-Type: application/http\r\n"
+            "Content-ID: 0\r\n"
+            "\r\n"
+            "HTTP/1.1 202 Accepted\r\n"
+            "x-ms-delete-type-permanent: true\r\n"
+            "\r\n"
+            "--batchresponse_1\r\n"
+            "Content-Type: application/http\r\n"
+            "Content-ID: 3\r\n"
+            "\r\n"
+            "HTTP/1.1 200 OK\r\n"
+            "\r\n"
+            "--batchresponse_1--\r\n";
+
+        auto response = azure::storage_lite::parse_blob_batch_response(body);
+        REQUIRE(response.results.size() == 4);
+        REQUIRE(response.results[0].success());
+        REQUIRE(!response.results[1].success());
+        REQUIRE(response.results[1].error().code == "404");
+        REQUIRE(response.results[1].error().code_name == "BlobNotFound");
+        REQUIRE(response.results[1].error().message == "The specified blob does not exist.");
+        REQUIRE(!response.results[2].success());
+        REQUIRE(response.results[3].success());
+
+        REQUIRE(azure::storage_lite::parse_blob_batch_response("").results.empty());
+    }
+
+    SECTION("A batch holds at most 256 sub-requests")
+    {
+        azure::storage_lite::blob_client client(account, 1);
+        blob_batch_request_base::subrequest subrequest{ blob_batch_request_base::operation::del, "container", "blob", delete_blob_request_base::delete_snapshots::include, access_tier::hot };
+
+        auto outcome = client.submit_batch({}).get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(invalid_parameters));
+
+        outcome = client.submit_batch(std::vector<blob_batch_request_base::subrequest>(257, subrequest)).get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(invalid_parameters));
+
+        outcome = client.submit_batches({}).get();
+        REQUIRE(outcome.success());
+        REQUIRE(outcome.response().results.empty());
+    }
+}
+
+TEST_CASE("Timeout policy", "[timeout]")
+{
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+
+    azure::storage_lite::timeout_policy policy(4.0, 0.25, milliseconds(500), seconds(120));
+
+    SECTION("Fixed timeouts apply until enough requests complete")
+    {
+        REQUIRE(policy.request_timeout("GET comp=blocklist", 30) == seconds(30));
+        REQUIRE(policy.stall_timeout() == seconds(60));
+        REQUIRE(policy.transfer_timeout(1024 * 1024) == milliseconds(0));
+    }
+
+    SECTION("Request timeouts follow the latency of requests of the same kind")
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            policy.record_request("DELETE", milliseconds(200));
+            policy.record_request("PUT comp=blocklist", seconds(40));
+        }
+        REQUIRE(policy.request_timeout("DELETE", 5) == milliseconds(800));
+        REQUIRE(policy.request_timeout("PUT comp=blocklist", 30) == seconds(120));
+        for (int i = 0; i < 256; ++i)
+        {
+            policy.record_request("DELETE", microseconds(10));
+        }
+        REQUIRE(policy.request_timeout("DELETE", 5) == milliseconds(500));
+        // Fast requests of one kind leave the others alone.
+        REQUIRE(policy.request_timeout("PUT comp=blocklist", 30) == seconds(120));
+        REQUIRE(policy.request_timeout("GET restype=container comp=list", 30) == seconds(30));
+    }
+
+    SECTION("Request timeouts allow for the body")
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            policy.record_request("PUT comp=blocklist", milliseconds(200));
+        }
+        REQUIRE(policy.request_timeout("PUT comp=blocklist", 30, 1024) == milliseconds(800));
+        // Without any throughput observed, a large body keeps the fixed timeout.
+        REQUIRE(policy.request_timeout("PUT comp=blocklist", 30, 4 * 1024 * 1024) == seconds(30));
+        for (int i = 0; i < 100; ++i)
+        {
+            policy.record_transfer(8 * 1024 * 1024, milliseconds(100), milliseconds(1100));
+        }
+        // 4MB at a quarter of 8MB/s on top of the latency.
+        REQUIRE(policy.request_timeout("PUT comp=blocklist", 30, 4 * 1024 * 1024) == milliseconds(2800));
+    }
+
+    SECTION("Transfer timeouts follow the size and the observed throughput")
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            // 8MB at 8MB/s after 100ms to the first byte.
+            policy.record_transfer(8 * 1024 * 1024, milliseconds(100), milliseconds(1100));
+        }
+        REQUIRE(policy.stall_timeout() == seconds(2));
+        // 2 seconds of stall allowance and 32MB at a quarter of 8MB/s.
+        REQUIRE(policy.transfer_timeout(32 * 1024 * 1024) == milliseconds(18000));
+        REQUIRE(policy.transfer_timeout(0) == milliseconds(0));
+    }
+}
@@ -1,9 +1,13 @@
 #include "blob_integration_base.h"
 #include "storage_errno.h"
 #include "mstream.h"
+#include "base64.h"
+#include "checksum.h"
 
 #include "catch2/catch.hpp"
 
+#include <fstream>
+
 TEST_CASE("Upload block blob from stream", "[block blob],[blob_service]")
 {
     azure::storage_lite::blob_client client = as_test::base::test_blob_client();
@@ -376,6 +380,272 @@ TEST_CASE("Get block list", "[block blob],[blob_service]")
     client.delete_container(container_name);
 }
 
+TEST_CASE("Sync block blob from buffer", "[block blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+
+    const size_t size = 64 * 1024 * 1024;
+    char* buffer = as_test::get_random_buffer(size);
+    auto sync_outcome = client.sync_block_blob_from_buffer(container_name, blob_name, buffer, std::vector<std::pair<std::string, std::string>>(), size, 4).get();
+    REQUIRE(sync_outcome.success());
+
+    auto first_block_list_outcome = client.get_block_list(container_name, blob_name).get();
+    REQUIRE(first_block_list_outcome.success());
+    auto first_block_list = first_block_list_outcome.response().committed;
+    REQUIRE(first_block_list.size() > 1);
+
+    SECTION("Only blocks around an insertion change")
+    {
+        std::string updated(buffer, size);
+        updated.insert(size / 2, "inserted");
+        sync_outcome = client.sync_block_blob_from_buffer(container_name, blob_name, updated.data(), std::vector<std::pair<std::string, std::string>>(), updated.size(), 4).get();
+        REQUIRE(sync_outcome.success());
+
+        auto second_block_list_outcome = client.get_block_list(container_name, blob_name).get();
+        REQUIRE(second_block_list_outcome.success());
+        auto second_block_list = second_block_list_outcome.response().committed;
+        size_t reused = 0;
+        for (const auto &block : second_block_list)
+        {
+            for (const auto &previous : first_block_list)
+            {
+                if (block.name == previous.name)
+                {
+                    ++reused;
+                    break;
+                }
+            }
+        }
+        REQUIRE(reused + 2 >= first_block_list.size());
+
+        std::string downloaded(updated.size(), '\0');
+        auto download_outcome = client.download_blob_to_buffer(container_name, blob_name, 0, updated.size(), &downloaded[0], 4).get();
+        REQUIRE(download_outcome.success());
+        REQUIRE(downloaded == updated);
+    }
+
+    delete[] buffer;
+    client.delete_container(container_name);
+}
+
+TEST_CASE("Transactional checksums", "[block blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+
+    const size_t size = 20 * 1024 * 1024 + 123;
+    char* buffer = as_test::get_random_buffer(size);
+    std::string downloaded(size, '\0');
+
+    SECTION("Upload and download with CRC64 successfully")
+    {
+        client.set_transfer_checksum(azure::storage_lite::checksum_type::crc64);
+        REQUIRE(client.upload_block_blob_from_buffer(container_name, blob_name, buffer, std::vector<std::pair<std::string, std::string>>(), size, 4).get().success());
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, size, &downloaded[0], 4).get().success());
+        REQUIRE(downloaded == std::string(buffer, size));
+    }
+
+    SECTION("Upload and download with MD5 successfully")
+    {
+        client.set_transfer_checksum(azure::storage_lite::checksum_type::md5);
+        REQUIRE(client.upload_block_blob_from_buffer(container_name, blob_name, buffer, std::vector<std::pair<std::string, std::string>>(), size, 4).get().success());
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, size, &downloaded[0], 4).get().success());
+        REQUIRE(downloaded == std::string(buffer, size));
+
+        std::stringbuf strbuf;
+        std::ostream os(&strbuf);
+        REQUIRE(client.download_blob_to_stream(container_name, blob_name, 1024, 1024 * 1024, os).get().success());
+        REQUIRE(strbuf.str() == std::string(buffer + 1024, 1024 * 1024));
+    }
+
+    SECTION("CRC64 computed in pieces matches")
+    {
+        uint64_t whole = azure::storage_lite::crc64(buffer, size);
+        uint64_t pieces = azure::storage_lite::crc64(buffer, 1000);
+        pieces = azure::storage_lite::crc64(buffer + 1000, size - 1000, pieces);
+        REQUIRE(whole == pieces);
+        REQUIRE(azure::storage_lite::crc64("", 0) == 0);
+    }
+
+    delete[] buffer;
+    client.delete_container(container_name);
+}
+
+TEST_CASE("CRC64", "[checksum]")
+{
+    SECTION("Known answers")
+    {
+        REQUIRE(azure::storage_lite::crc64("123456789", 9) == 0xae8b14860a799888ULL);
+        REQUIRE(azure::storage_lite::crc64_portable("123456789", 9) == 0xae8b14860a799888ULL);
+        REQUIRE(azure::storage_lite::crc64("", 0) == 0);
+        REQUIRE(azure::storage_lite::checksum_calculator::compute(azure::storage_lite::checksum_type::crc64, "123456789", 9) == "iJh5CoYUi64=");
+    }
+
+    SECTION("The accelerated and the portable implementations agree")
+    {
+        const size_t size = 64 * 1024 + 123;
+        char* buffer = as_test::get_random_buffer(size);
+        // Lengths around the 128 byte threshold and the 64 and 16 byte folds, from aligned and unaligned starts.
+        for (size_t length : { size_t(0), size_t(1), size_t(15), size_t(16), size_t(63), size_t(64), size_t(127), size_t(128), size_t(129), size_t(191), size_t(192), size_t(255), size_t(1000), size_t(4096), size - 8 })
+        {
+            for (size_t start = 0; start < 8; ++start)
+            {
+                REQUIRE(azure::storage_lite::crc64(buffer + start, length) == azure::storage_lite::crc64_portable(buffer + start, length));
+                REQUIRE(azure::storage_lite::crc64(buffer + start, length, 0x0123456789abcdefULL) == azure::storage_lite::crc64_portable(buffer + start, length, 0x0123456789abcdefULL));
+            }
+        }
+        delete[] buffer;
+    }
+}
+
+TEST_CASE("Upload block blob from file", "[block blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+
+    const size_t file_size = 3 * 1024 * 1024 + 123;
+    char* buffer = as_test::get_random_buffer(file_size);
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    REQUIRE(file_size == std::fwrite(buffer, 1, file_size, file));
+    std::fflush(file);
+    const int fd = fileno(file);
+
+    SECTION("Upload a range of a file as a blob")
+    {
+        auto outcome = client.upload_block_blob_from_file(container_name, blob_name, fd, 1000, file_size - 1000, {}).get();
+        REQUIRE(outcome.success());
+        std::ostringstream os;
+        REQUIRE(client.download_blob_to_stream(container_name, blob_name, 0, file_size, os).get().success());
+        REQUIRE(os.str() == std::string(buffer + 1000, file_size - 1000));
+    }
+
+    SECTION("Upload a range of a file as a blob with a checksum")
+    {
+        client.set_transfer_checksum(azure::storage_lite::checksum_type::md5);
+        REQUIRE(client.upload_block_blob_from_file(container_name, blob_name, fd, 0, file_size, {}).get().success());
+        client.set_transfer_checksum(azure::storage_lite::checksum_type::crc64);
+        REQUIRE(client.upload_block_blob_from_file(container_name, blob_name, fd, 0, file_size, {}).get().success());
+    }
+
+    SECTION("Ranges too long for one request are rejected")
+    {
+        const uint64_t length = 5ULL * 1024 * 1024 * 1024;
+        auto outcome = client.upload_block_blob_from_file(container_name, blob_name, fd, 0, length, {}).get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(blob_too_big));
+        outcome = client.upload_block_from_file(container_name, blob_name, azure::storage_lite::to_base64(reinterpret_cast<const unsigned char*>("block-1"), 7), fd, 0, length).get();
+        REQUIRE(!outcome.success());
+        REQUIRE(outcome.error().code == std::to_string(blob_too_big));
+    }
+
+    SECTION("Upload blocks from a file")
+    {
+        client.set_transfer_checksum(azure::storage_lite::checksum_type::crc64);
+        const std::string first = azure::storage_lite::to_base64(reinterpret_cast<const unsigned char*>("block-1"), 7);
+        const std::string second = azure::storage_lite::to_base64(reinterpret_cast<const unsigned char*>("block-2"), 7);
+        REQUIRE(client.upload_block_from_file(container_name, blob_name, first, fd, 0, 2 * 1024 * 1024).get().success());
+        REQUIRE(client.upload_block_from_file(container_name, blob_name, second, fd, 2 * 1024 * 1024, file_size - 2 * 1024 * 1024).get().success());
+        std::vector<azure::storage_lite::put_block_list_request_base::block_item> blocks{
+            { first, azure::storage_lite::put_block_list_request_base::block_type::uncommitted },
+            { second, azure::storage_lite::put_block_list_request_base::block_type::uncommitted } };
+        REQUIRE(client.put_block_list(container_name, blob_name, blocks, {}).get().success());
+        std::ostringstream os;
+        REQUIRE(client.download_blob_to_stream(container_name, blob_name, 0, file_size, os).get().success());
+        REQUIRE(os.str() == std::string(buffer, file_size));
+    }
+
+    std::fclose(file);
+    delete[] buffer;
+    client.delete_container(container_name);
+}
+
+TEST_CASE("Resumable file upload", "[block blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+    azure::storage_lite::blob_client_wrapper wrapper(std::make_shared<azure::storage_lite::blob_client>(client));
+
+    // Larger than a single put, so the file goes out in five blocks of 16MB and less.
+    const size_t file_size = 70 * 1024 * 1024;
+    const std::string source_path = blob_name + ".source";
+    const std::string checkpoint_path = blob_name + ".checkpoint";
+    char* buffer = as_test::get_random_buffer(file_size);
+    {
+        std::ofstream source(source_path, std::ios::binary);
+        source.write(buffer, file_size);
+    }
+
+    // A metadata name the service rejects fails the commit after every block is staged, as an interrupted upload would leave it.
+    const std::vector<std::pair<std::string, std::string>> rejected_metadata{ { "1-invalid", "value" } };
+    wrapper.upload_file_to_blob(source_path, container_name, blob_name, rejected_metadata, 8, checkpoint_path);
+    REQUIRE(errno != 0);
+    std::vector<std::string> journal;
+    {
+        std::ifstream checkpoint(checkpoint_path);
+        REQUIRE(checkpoint);
+        for (std::string line; std::getline(checkpoint, line);)
+        {
+            journal.push_back(line);
+        }
+    }
+    REQUIRE(journal.size() == 2 + 5);
+
+    SECTION("A resumed upload only sends the blocks missing from the journal")
+    {
+        // The last two blocks were never recorded, as if the upload was stopped before they were acknowledged.
+        {
+            std::ofstream checkpoint(checkpoint_path, std::ios::trunc);
+            for (size_t i = 0; i < journal.size() - 2; ++i)
+            {
+                checkpoint << journal[i] << '\n';
+            }
+        }
+
+        const auto acquisitions = client.client()->metrics().acquisitions;
+        wrapper.upload_file_to_blob(source_path, container_name, blob_name, {}, 8, checkpoint_path);
+        REQUIRE(errno == 0);
+        // The block list, the two missing blocks and the commit.
+        REQUIRE(client.client()->metrics().acquisitions - acquisitions == 4);
+        REQUIRE(!std::ifstream(checkpoint_path));
+
+        std::string downloaded(file_size, '\0');
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, file_size, &downloaded[0], 8).get().success());
+        REQUIRE(downloaded == std::string(buffer, file_size));
+    }
+
+    SECTION("A file modified between runs is uploaded again")
+    {
+        // Rewritten in place right away, the size and the second of the modification time stay the same.
+        for (size_t i = 0; i < file_size; i += 1024 * 1024)
+        {
+            buffer[i] = static_cast<char>(~buffer[i]);
+        }
+        {
+            std::fstream source(source_path, std::ios::binary | std::ios::in | std::ios::out);
+            source.write(buffer, file_size);
+        }
+
+        wrapper.upload_file_to_blob(source_path, container_name, blob_name, {}, 8, checkpoint_path);
+        REQUIRE(errno == 0);
+        REQUIRE(!std::ifstream(checkpoint_path));
+
+        std::string downloaded(file_size, '\0');
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, file_size, &downloaded[0], 8).get().success());
+        REQUIRE(downloaded == std::string(buffer, file_size));
+    }
+
+    std::remove(source_path.c_str());
+    std::remove(checkpoint_path.c_str());
+    delete[] buffer;
+    client.delete_container(container_name);
+}
+
 TEST_CASE("memory streambuf", "")
 {
     if (sizeof(void*) == 8)
@@ -511,6 +781,69 @@ TEST_CASE("memory stream", "")
     }
 }
 
+TEST_CASE("storage buffers", "")
+{
+    const size_t buffer_size = 20 * 1024;
+    char* buffer = as_test::get_random_buffer(buffer_size);
+    std::vector<char> copy(buffer_size);
+
+    {
+        std::vector<std::pair<const char*, size_t>> segments{ { buffer, 1000 }, { buffer + 1000, 0 }, { buffer + 1000, buffer_size - 1000 } };
+        azure::storage_lite::storage_input_buffer in(segments);
+        CHECK(in.valid());
+        CHECK(buffer_size == in.size());
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            size_t total = 0;
+            size_t copied = 0;
+            while (in.read(copy.data() + total, std::min<size_t>(777, buffer_size - total), copied) && copied > 0)
+            {
+                total += copied;
+            }
+            CHECK(buffer_size == total);
+            CHECK(0 == std::memcmp(buffer, copy.data(), buffer_size));
+            std::fill(copy.begin(), copy.end(), '\0');
+            in.reset();
+        }
+    }
+
+    {
+        std::vector<char> first(buffer_size / 2);
+        std::vector<char> second(buffer_size - first.size());
+        azure::storage_lite::storage_output_buffer out({ { first.data(), first.size() }, { second.data(), second.size() } });
+        CHECK(out.write(buffer, 3000));
+        CHECK(out.write(buffer + 3000, buffer_size - 3000));
+        CHECK(buffer_size == out.written());
+        CHECK(!out.write(buffer, 1));
+        CHECK(0 == std::memcmp(buffer, first.data(), first.size()));
+        CHECK(0 == std::memcmp(buffer + first.size(), second.data(), second.size()));
+        out.reset();
+        CHECK(0 == out.written());
+    }
+
+    {
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        const int fd = fileno(file);
+        const size_t offset = 4096 + 123;
+        auto out = azure::storage_lite::storage_output_buffer::from_file(fd, offset, buffer_size);
+        CHECK(out.write(buffer, 5000));
+        CHECK(out.write(buffer + 5000, buffer_size - 5000));
+        CHECK(!out.write(buffer, 1));
+
+        auto in = azure::storage_lite::storage_input_buffer::from_file(fd, offset + 100, buffer_size - 100);
+        size_t copied = 0;
+        CHECK(in.read(copy.data(), buffer_size, copied));
+        CHECK(buffer_size - 100 == copied);
+        CHECK(0 == std::memcmp(buffer + 100, copy.data(), copied));
+        CHECK(in.read(copy.data(), buffer_size, copied));
+        CHECK(0 == copied);
+        std::fclose(file);
+    }
+
+    delete[] buffer;
+}
+
 TEST_CASE("Parallel upload download", "[block blob],[blob_service]")
 {
     azure::storage_lite::blob_client client = as_test::base::test_blob_client(16);
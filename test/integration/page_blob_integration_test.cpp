@@ -252,3 +252,102 @@ TEST_CASE("Get page ranges", "[page blob],[blob_service]")
 
     client.delete_container(container_name);
 }
+
+TEST_CASE("Get page ranges diff", "[page blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client();
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+    auto create_page_blob_outcome = client.create_page_blob(container_name, blob_name, 1024 * 20).get();
+    REQUIRE(create_page_blob_outcome.success());
+
+    auto iss = as_test::get_istringstream_with_random_buffer(1024 * 4);
+    REQUIRE(client.put_page_from_stream(container_name, blob_name, 0, iss.str().size(), iss).get().success());
+    auto create_snapshot_outcome = client.create_snapshot(container_name, blob_name).get();
+    REQUIRE(create_snapshot_outcome.success());
+    REQUIRE(!create_snapshot_outcome.response().empty());
+
+    SECTION("Get page ranges diff against an unchanged snapshot successfully")
+    {
+        auto get_page_ranges_diff_outcome = client.get_page_ranges_diff(container_name, blob_name, create_snapshot_outcome.response()).get();
+        REQUIRE(get_page_ranges_diff_outcome.success());
+        REQUIRE(get_page_ranges_diff_outcome.response().pagelist.empty());
+        REQUIRE(get_page_ranges_diff_outcome.response().clearlist.empty());
+    }
+
+    SECTION("Get page ranges diff with updated and cleared pages successfully")
+    {
+        auto update_iss = as_test::get_istringstream_with_random_buffer(1024);
+        REQUIRE(client.put_page_from_stream(container_name, blob_name, 1024 * 8, update_iss.str().size(), update_iss).get().success());
+        REQUIRE(client.clear_page(container_name, blob_name, 0, 1024).get().success());
+
+        auto get_page_ranges_diff_outcome = client.get_page_ranges_diff(container_name, blob_name, create_snapshot_outcome.response()).get();
+        REQUIRE(get_page_ranges_diff_outcome.success());
+        auto page_list = get_page_ranges_diff_outcome.response().pagelist;
+        auto clear_list = get_page_ranges_diff_outcome.response().clearlist;
+        REQUIRE(page_list.size() == 1);
+        REQUIRE(page_list[0].start == 1024 * 8);
+        REQUIRE(page_list[0].end == 1024 * 9 - 1);
+        REQUIRE(clear_list.size() == 1);
+        REQUIRE(clear_list[0].start == 0);
+        REQUIRE(clear_list[0].end == 1023);
+    }
+
+    client.delete_container(container_name);
+}
+
+TEST_CASE("Sync page blob from buffer", "[page blob],[blob_service]")
+{
+    azure::storage_lite::blob_client client = as_test::base::test_blob_client(4);
+    std::string container_name = as_test::create_random_container("", client);
+    std::string blob_name = as_test::get_random_string(20);
+    const uint64_t image_size = 12 * 1024 * 1024;
+    auto create_page_blob_outcome = client.create_page_blob(container_name, blob_name, image_size).get();
+    REQUIRE(create_page_blob_outcome.success());
+
+    std::string base_image = as_test::get_random_string(image_size);
+    auto sync_outcome = client.sync_page_blob_from_buffer(container_name, blob_name, base_image.data(), nullptr, image_size, "", 4).get();
+    REQUIRE(sync_outcome.success());
+    auto create_snapshot_outcome = client.create_snapshot(container_name, blob_name).get();
+    REQUIRE(create_snapshot_outcome.success());
+
+    SECTION("Sync changed and zeroed pages successfully")
+    {
+        std::string image = base_image;
+        image.replace(512, 1024, as_test::get_random_string(1024));
+        image.replace(5 * 1024 * 1024, 4096, std::string(4096, '\0'));
+
+        sync_outcome = client.sync_page_blob_from_buffer(container_name, blob_name, image.data(), base_image.data(), image_size, create_snapshot_outcome.response(), 4).get();
+        REQUIRE(sync_outcome.success());
+
+        auto get_page_ranges_diff_outcome = client.get_page_ranges_diff(container_name, blob_name, create_snapshot_outcome.response()).get();
+        REQUIRE(get_page_ranges_diff_outcome.success());
+        REQUIRE(get_page_ranges_diff_outcome.response().pagelist.size() == 1);
+        REQUIRE(get_page_ranges_diff_outcome.response().clearlist.size() == 1);
+
+        std::string downloaded(image_size, '\0');
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, image_size, &downloaded[0], 4).get().success());
+        REQUIRE(downloaded == image);
+    }
+
+    SECTION("Sync restores pages modified remotely since the snapshot successfully")
+    {
+        auto iss = as_test::get_istringstream_with_random_buffer(2048);
+        REQUIRE(client.put_page_from_stream(container_name, blob_name, 8 * 1024 * 1024, iss.str().size(), iss).get().success());
+
+        sync_outcome = client.sync_page_blob_from_buffer(container_name, blob_name, base_image.data(), base_image.data(), image_size, create_snapshot_outcome.response(), 4).get();
+        REQUIRE(sync_outcome.success());
+
+        std::string downloaded(image_size, '\0');
+        REQUIRE(client.download_blob_to_buffer(container_name, blob_name, 0, image_size, &downloaded[0], 4).get().success());
+        REQUIRE(downloaded == base_image);
+    }
+
+    SECTION("Sync image with unaligned size unsuccessfully")
+    {
+        sync_outcome = client.sync_page_blob_from_buffer(container_name, blob_name, base_image.data(), nullptr, image_size - 1, "", 4).get();
+        REQUIRE(!sync_outcome.success());
+    }
+
+    client.delete_container(container_name);
+}
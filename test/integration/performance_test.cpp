@@ -1,5 +1,8 @@
 #include "blob_integration_base.h"
 #include "mstream.h"
+#include "base64.h"
+#include "blob/get_blob_property_request.h"
+#include "blob/put_block_request.h"
 
 #include "catch2/catch.hpp"
 
@@ -7,6 +10,7 @@
 #include <random>
 #include <chrono>
 #include <limits>
+#include <thread>
 
 TEST_CASE("SingleThreadPerformance", "[performance][!hide]")
 {
@@ -119,3 +123,127 @@ TEST_CASE("MultiThreadPerformance", "[performance][!hide]")
         std::cout << concurrency << " thread download speed: " << speed << "MiB/s" << std::endl;
     }
 }
+
+TEST_CASE("Base64Performance", "[performance][!hide]")
+{
+    std::size_t buffer_size = 256 * 1024 * 1024;
+    std::vector<unsigned char> buffer(buffer_size);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint64_t> distrib(0, std::numeric_limits<uint64_t>::max());
+    for (std::size_t i = 0; i < buffer_size; i += sizeof(uint64_t))
+        *(reinterpret_cast<uint64_t*>(&buffer[0] + i)) = distrib(gen);
+
+    auto report = [buffer_size](const std::string &name, std::chrono::system_clock::time_point timer_start, std::chrono::system_clock::time_point timer_end)
+    {
+        double speed = static_cast<double>(buffer_size) / 1024 / 1024
+            / std::chrono::duration_cast<std::chrono::milliseconds>(timer_end - timer_start).count()
+            * 1000;
+        std::cout << name << " speed: " << speed << "MiB/s" << std::endl;
+    };
+
+    auto timer_start = std::chrono::system_clock::now();
+    std::string reference = as_test::to_base64(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    auto timer_end = std::chrono::system_clock::now();
+    report("Reference base64 encode", timer_start, timer_end);
+
+    timer_start = std::chrono::system_clock::now();
+    std::string encoded = azure::storage_lite::to_base64(buffer);
+    timer_end = std::chrono::system_clock::now();
+    report("Base64 encode", timer_start, timer_end);
+
+    timer_start = std::chrono::system_clock::now();
+    auto decoded = azure::storage_lite::from_base64(encoded);
+    timer_end = std::chrono::system_clock::now();
+    report("Base64 decode", timer_start, timer_end);
+
+    REQUIRE(decoded == buffer);
+}
+
+TEST_CASE("SharedKeySigningPerformance", "[performance][!hide]")
+{
+    azure::storage_lite::shared_key_credential credential("account", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+    auto http_client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+    auto http = http_client->get_handle();
+    http->set_method(azure::storage_lite::http_base::http_method::put);
+
+    azure::storage_lite::storage_url url;
+    url.append_path("container").append_path(as_test::get_random_string(20)).add_query("comp", "block").add_query("blockid", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+    azure::storage_lite::storage_headers headers;
+    headers.content_length = "4194304";
+    headers.ms_headers["x-ms-client-request-id"] = "00000000-0000-0000-0000-000000000000";
+    headers.ms_headers["x-ms-date"] = "Mon, 19 Oct 2026 00:00:00 GMT";
+    headers.ms_headers["x-ms-version"] = "2019-02-02";
+    headers.ms_headers["x-ms-content-crc64"] = "AAAAAAAAAAA=";
+
+    int count = 200000;
+    auto timer_start = std::chrono::system_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        credential.sign_request(azure::storage_lite::get_blob_property_request("container", "blob"), *http, url, headers);
+        http->reset();
+    }
+    auto timer_end = std::chrono::system_clock::now();
+
+    double rate = static_cast<double>(count)
+        / std::chrono::duration_cast<std::chrono::milliseconds>(timer_end - timer_start).count()
+        * 1000;
+    std::cout << "Shared key signing: " << rate << " requests/s" << std::endl;
+}
+
+TEST_CASE("RequestBuildPerformance", "[performance][!hide]")
+{
+    auto credential = std::make_shared<azure::storage_lite::shared_key_credential>("account", "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+    azure::storage_lite::storage_account account("account", credential);
+    auto http_client = std::make_shared<azure::storage_lite::CurlEasyClient>(1);
+    auto http = http_client->get_handle();
+
+    std::string blob_name = as_test::get_random_string(20);
+    int count = 200000;
+    auto timer_start = std::chrono::system_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        azure::storage_lite::put_block_request request("container", blob_name, "MDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDA=");
+        request.set_content_length(4 * 1024 * 1024);
+        request.build_request(account, *http);
+        http->reset();
+    }
+    auto timer_end = std::chrono::system_clock::now();
+
+    double rate = static_cast<double>(count)
+        / std::chrono::duration_cast<std::chrono::milliseconds>(timer_end - timer_start).count()
+        * 1000;
+    std::cout << "Request building: " << rate << " requests/s" << std::endl;
+}
+
+TEST_CASE("HandlePoolPerformance", "[performance][!hide]")
+{
+    const int thread_count = std::max(2u, std::thread::hardware_concurrency());
+    auto http_client = std::make_shared<azure::storage_lite::CurlEasyClient>(thread_count);
+
+    int count = 100000;
+    std::vector<std::thread> threads;
+    auto timer_start = std::chrono::system_clock::now();
+    for (int i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back([&http_client, count]()
+        {
+            for (int j = 0; j < count; ++j)
+            {
+                auto http = http_client->get_handle();
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    auto timer_end = std::chrono::system_clock::now();
+
+    double rate = static_cast<double>(count) * thread_count
+        / std::chrono::duration_cast<std::chrono::milliseconds>(timer_end - timer_start).count()
+        * 1000;
+    auto metrics = http_client->metrics();
+    std::cout << "Handle acquisition: " << rate << " handles/s on " << thread_count << " threads, p99 wait " << metrics.wait_percentile(0.99).count()
+        << "us, " << metrics.steals << " steals, " << metrics.waits << " waits" << std::endl;
+}
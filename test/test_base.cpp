@@ -42,9 +42,9 @@ namespace as_test {
     {
         static const char* base64_enctbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
         std::string result;
-        for (int offset = 0; length - offset >= 3; offset += 3)
+        for (size_t offset = 0; length - offset >= 3; offset += 3)
         {
-            const char* ptr = base + offset;
+            const unsigned char* ptr = reinterpret_cast<const unsigned char*>(base) + offset;
             unsigned char idx0 = ptr[0] >> 2;
             unsigned char idx1 = ((ptr[0] & 0x3) << 4) | ptr[1] >> 4;
             unsigned char idx2 = ((ptr[1] & 0xF) << 2) | ptr[2] >> 6;
@@ -59,7 +59,7 @@ namespace as_test {
         case 1:
         {
 
-            const char* ptr = base + length - 1;
+            const unsigned char* ptr = reinterpret_cast<const unsigned char*>(base) + length - 1;
             unsigned char idx0 = ptr[0] >> 2;
             unsigned char idx1 = ((ptr[0] & 0x3) << 4);
             result.push_back(base64_enctbl[idx0]);
@@ -71,7 +71,7 @@ namespace as_test {
         case 2:
         {
 
-            const char* ptr = base + length - 2;
+            const unsigned char* ptr = reinterpret_cast<const unsigned char*>(base) + length - 2;
             unsigned char idx0 = ptr[0] >> 2;
             unsigned char idx1 = ((ptr[0] & 0x3) << 4) | ptr[1] >> 4;
             unsigned char idx2 = ((ptr[1] & 0xF) << 2);